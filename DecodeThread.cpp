@@ -37,7 +37,7 @@ CDecodeThread::CDecodeThread(CLAVVideo *pLAVVideo)
   , m_evDecodeDone(TRUE)
   , m_evEOSDone(TRUE)
   , m_evInput(TRUE)
-  , m_NextSample(NULL)
+  , m_evInputSpace(FALSE)
   , m_FailedSample(NULL)
 {
   WCHAR fileName[1024];
@@ -46,9 +46,6 @@ CDecodeThread::CDecodeThread(CLAVVideo *pLAVVideo)
 
   memset(&m_ThreadCallContext, 0, sizeof(m_ThreadCallContext));
 
-  m_TempSample[0] = NULL;
-  m_TempSample[1] = NULL;
-
   CAMThread::Create();
   m_evInput.Reset();
 }
@@ -124,18 +121,20 @@ STDMETHODIMP CDecodeThread::Close()
   return S_OK;
 }
 
-bool CDecodeThread::HasSample()
+bool CDecodeThread::HasInputSpace(size_t depth)
 {
   CAutoLock lock(&m_SampleCritSec);
-  return m_NextSample != NULL;
+  return m_InputQueue.size() < depth;
 }
 
 void CDecodeThread::PutSample(IMediaSample *pSample)
 {
   CAutoLock lock(&m_SampleCritSec);
-  ASSERT(m_NextSample == NULL);
+
   // Provide Sample to worker thread
-  m_NextSample = pSample;
+  InputSample input = { pSample };
+  QueryPerformanceCounter(&input.tQueued);
+  m_InputQueue.push_back(input);
 
   // Wake worker thread
   m_evInput.Set();
@@ -145,24 +144,58 @@ IMediaSample* CDecodeThread::GetSample()
 {
   CAutoLock lock(&m_SampleCritSec);
 
-  // Take the sample out of the buffer
-  IMediaSample *pSample = m_NextSample;
-  m_NextSample = NULL;
+  if (m_InputQueue.empty()) {
+    // Reset input event (no more input)
+    m_evInput.Reset();
+    return NULL;
+  }
+
+  // Take the oldest sample out of the queue
+  InputSample input = m_InputQueue.front();
+  m_InputQueue.pop_front();
 
-  // Reset input event (no more input)
-  m_evInput.Reset();
+  if (m_InputQueue.empty())
+    m_evInput.Reset();
 
-  return pSample;
+  // Let the main thread know there is room for another sample
+  m_evInputSpace.Set();
+
+#if defined(DEBUG) && DEBUG_INPUT_HANDOFF_TIMINGS
+  LARGE_INTEGER frequency, now;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&now);
+  m_HandoffTimingAvg.Sample((now.QuadPart - input.tQueued.QuadPart) * 1000.0 / frequency.QuadPart);
+
+  DbgLog((LOG_TRACE, 10, L"Input hand-off took %2.3fms in avg, %d samples still queued", m_HandoffTimingAvg.Average(), m_InputQueue.size()));
+#endif
+
+  return input.pSample;
 }
 
-void CDecodeThread::ReleaseSample()
+void CDecodeThread::ReleaseSamples()
 {
   CAutoLock lock(&m_SampleCritSec);
   // Free any sample that was still queued
-  SafeRelease(&m_NextSample);
+  while (!m_InputQueue.empty()) {
+    SafeRelease(&m_InputQueue.front().pSample);
+    m_InputQueue.pop_front();
+  }
 
   // Reset input event (no more input)
   m_evInput.Reset();
+  m_evInputSpace.Set();
+}
+
+STDMETHODIMP CDecodeThread::ReInitDecoder()
+{
+  // Doing this inside the worker thread alone causes problems
+  // when switching from non-sync to sync, so ensure we're in sync.
+  CAMThread::CallWorker(CMD_REINIT);
+  while (!m_evEOSDone.Check()) {
+    m_evSample.Wait();
+    ProcessOutput();
+  }
+  return S_OK;
 }
 
 STDMETHODIMP CDecodeThread::Decode(IMediaSample *pSample)
@@ -172,21 +205,35 @@ STDMETHODIMP CDecodeThread::Decode(IMediaSample *pSample)
   if (!CAMThread::ThreadExists())
     return E_UNEXPECTED;
 
-  // Wait until the queue is empty
-  while(HasSample())
-    Sleep(1);
-
-  // Re-init the decoder, if requested
-  // Doing this inside the worker thread alone causes problems
-  // when switching from non-sync to sync, so ensure we're in sync.
-  if (m_bDecoderNeedsReInit) {
-    CAMThread::CallWorker(CMD_REINIT);
-    while (!m_evEOSDone.Check()) {
-      m_evSample.Wait();
-      ProcessOutput();
-    }
+#if defined(DEBUG) && DEBUG_INPUT_HANDOFF_TIMINGS
+  LARGE_INTEGER frequency, start, end;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+#endif
+
+  // Wait until there is room in the input queue, and deliver decoded frames in the meantime
+  while (1) {
+    // Re-init the decoder, if requested
+    if (m_bDecoderNeedsReInit)
+      ReInitDecoder();
+
+    // In sync mode every sample is decoded before we return, so queueing more than one makes no sense
+    size_t depth = m_bSyncToProcess ? 1 : max(m_pLAVVideo->GetInputQueueDepth(), 1UL);
+    if (HasInputSpace(depth))
+      break;
+
+    HANDLE hWaitEvents[2] = { m_evInputSpace, m_evSample };
+    WaitForMultipleObjects(2, hWaitEvents, FALSE, INFINITE);
+    ProcessOutput();
   }
 
+#if defined(DEBUG) && DEBUG_INPUT_HANDOFF_TIMINGS
+  QueryPerformanceCounter(&end);
+  m_QueueWaitTimingAvg.Sample((end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart);
+
+  DbgLog((LOG_TRACE, 10, L"Waiting for room in the input queue took %2.3fms in avg", m_QueueWaitTimingAvg.Average()));
+#endif
+
   m_evDeliver.Reset();
   m_evSample.Reset();
   m_evDecodeDone.Reset();
@@ -229,13 +276,20 @@ STDMETHODIMP CDecodeThread::EndOfStream()
   if (!CAMThread::ThreadExists())
     return E_UNEXPECTED;
 
+  // A hardware decoder failure needs to be handled before the EOS, so the failed sample is decoded again
+  if (m_bDecoderNeedsReInit)
+    ReInitDecoder();
+
   m_evDeliver.Reset();
   m_evSample.Reset();
 
   CAMThread::CallWorker(CMD_EOS);
 
+  // Samples still in the input queue can fail as well, in which case the re-init also finishes the EOS
   while (!m_evEOSDone.Check()) {
     m_evSample.Wait();
+    if (m_bDecoderNeedsReInit)
+      ReInitDecoder();
     ProcessOutput();
   }
 
@@ -258,15 +312,14 @@ STDMETHODIMP CDecodeThread::ProcessOutput()
 
 STDMETHODIMP CDecodeThread::ClearQueues()
 {
-  // Release input sample
-  ReleaseSample();
+  // Release input samples
+  ReleaseSamples();
 
   // Release output samples
-  {
-    CAutoLock lock(&m_Output);
-    while (LAVFrame *pFrame = m_Output.Pop()) {
-      ReleaseFrame(&pFrame);
-    }
+  // This runs on the worker thread, but the main thread is waiting in CallWorker and does not pop frames meanwhile,
+  // so we can take over as the consumer of the output queue here
+  while (LAVFrame *pFrame = m_Output.Pop()) {
+    ReleaseFrame(&pFrame);
   }
 
   return S_OK;
@@ -284,8 +337,9 @@ DWORD CDecodeThread::ThreadProc()
 
   HANDLE hWaitEvents[2] = { GetRequestHandle(), m_evInput };
   while(1) {
-    if (!bEOS && !bReinit) {
+    if ((!bEOS && !bReinit) || m_bDecoderNeedsReInit) {
       // Wait for either an input sample, or an request
+      // While a re-init is pending, the input event stays reset, so only a request gets us going again
       WaitForMultipleObjects(2, hWaitEvents, FALSE, INFINITE);
     }
 
@@ -349,13 +403,19 @@ DWORD CDecodeThread::ThreadProc()
         {
           CMediaType &mt = m_pLAVVideo->GetInputMediaType();
           CreateDecoderInternal(&mt, m_Codec);
-          m_TempSample[1] = m_NextSample;
-          m_NextSample = m_FailedSample;
+          // Decode the failed sample again, ahead of all samples which were queued after it
+          if (m_FailedSample) {
+            CAutoLock lock(&m_SampleCritSec);
+            InputSample input = { m_FailedSample };
+            QueryPerformanceCounter(&input.tQueued);
+            m_InputQueue.push_front(input);
+            m_evInput.Set();
+          }
           m_FailedSample = NULL;
           bReinit = TRUE;
           m_evEOSDone.Reset();
-          Reply(S_OK);
           m_bDecoderNeedsReInit = FALSE;
+          Reply(S_OK);
         }
         break;
       default:
@@ -365,26 +425,22 @@ DWORD CDecodeThread::ThreadProc()
 
     if (m_bDecoderNeedsReInit) {
       m_evInput.Reset();
+      // Wake the main thread, in case it is waiting for us instead of performing the re-init
+      m_evSample.Set();
       continue;
     }
 
-    if (bReinit && !m_NextSample) {
-      if (m_TempSample[0]) {
-        m_NextSample = m_TempSample[0];
-        m_TempSample[0] = NULL;
-      } else if (m_TempSample[1]) {
-        m_NextSample = m_TempSample[1];
-        m_TempSample[1] = NULL;
-      } else {
-        bReinit = FALSE;
-        m_evEOSDone.Set();
-        m_evSample.Set();
-        continue;
-      }
-    }
-
     IMediaSample *pSample = GetSample();
     if (!pSample) {
+      // All samples queued during the re-init have been decoded
+      // If an EOS is pending as well, the EOS below signals the end of both
+      if (bReinit) {
+        bReinit = FALSE;
+        if (!bEOS) {
+          m_evEOSDone.Set();
+          m_evSample.Set();
+        }
+      }
       // Process the EOS now that the sample queue is empty
       if (bEOS) {
         bEOS = FALSE;
@@ -543,10 +599,8 @@ STDMETHODIMP CDecodeThread::DecodeInternal(IMediaSample *pSample)
     m_FailedSample->AddRef();
 
     // Schedule a re-init when the main thread goes there the next time
+    // Any samples queued after this one stay in the queue until then
     m_bDecoderNeedsReInit = TRUE;
-
-    // Make room in the sample buffer, to ensure the main thread can get in
-    m_TempSample[0] = GetSample();
   }
 
   return S_OK;
@@ -20,7 +20,13 @@
 #pragma once
 
 #include "decoders/ILAVDecoder.h"
-#include "SynchronizedQueue.h"
+#include "SPSCQueue.h"
+#include "FloatingAverage.h"
+
+#include <deque>
+
+// Log the time a sample waits in the input queue before the decode thread picks it up
+#define DEBUG_INPUT_HANDOFF_TIMINGS 0
 
 class CLAVVideo;
 
@@ -78,10 +84,12 @@ private:
   STDMETHODIMP ClearQueues();
   STDMETHODIMP ProcessOutput();
 
-  bool HasSample();
+  bool HasInputSpace(size_t depth);
   void PutSample(IMediaSample *pSample);
   IMediaSample* GetSample();
-  void ReleaseSample();
+  void ReleaseSamples();
+
+  STDMETHODIMP ReInitDecoder();
 
   bool CheckForEndOfSequence(IMediaSample *pSample);
 
@@ -99,6 +107,7 @@ private:
   BOOL         m_bSyncToProcess;
   BOOL         m_bDecoderNeedsReInit;
   CAMEvent     m_evInput;
+  CAMEvent     m_evInputSpace;
   CAMEvent     m_evDeliver;
   CAMEvent     m_evSample;
   CAMEvent     m_evDecodeDone;
@@ -111,13 +120,23 @@ private:
     IMemAllocator **allocator;
     IPin *pin;
   } m_ThreadCallContext;
-  CSynchronizedQueue<LAVFrame *> m_Output;
-
+  // Decoded frames, pushed by the worker thread and popped by ProcessOutput
+  CSPSCQueue<LAVFrame *> m_Output;
+
+  // Samples waiting to be decoded, bounded by the configured input queue depth
+  struct InputSample {
+    IMediaSample *pSample;
+    LARGE_INTEGER tQueued;
+  };
   CCritSec     m_SampleCritSec;
-  IMediaSample *m_NextSample;
+  std::deque<InputSample> m_InputQueue;
 
-  IMediaSample *m_TempSample[2];
   IMediaSample *m_FailedSample;
 
+#if defined(DEBUG) && DEBUG_INPUT_HANDOFF_TIMINGS
+  FloatingAverage<double> m_HandoffTimingAvg;
+  FloatingAverage<double> m_QueueWaitTimingAvg;
+#endif
+
   std::wstring m_processName;
 };
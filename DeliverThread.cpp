@@ -0,0 +1,162 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "stdafx.h"
+#include "DeliverThread.h"
+
+#include "LAVVideo.h"
+
+CDeliverThread::CDeliverThread(CLAVVideo *pLAVVideo)
+  : m_pLAVVideo(pLAVVideo)
+  , m_bDelivering(FALSE)
+  , m_evQueue(TRUE)
+  , m_evSpace(TRUE)
+  , m_evIdle(TRUE)
+{
+  m_evSpace.Set();
+  m_evIdle.Set();
+
+  CAMThread::Create();
+}
+
+CDeliverThread::~CDeliverThread()
+{
+  Flush();
+  CAMThread::CallWorker(CMD_EXIT);
+  CAMThread::Close();
+}
+
+STDMETHODIMP CDeliverThread::Queue(IMediaSample *pSample, BOOL bSizeChanged, LONG width, LONG height)
+{
+  CheckPointer(pSample, E_POINTER);
+
+  if (!CAMThread::ThreadExists())
+    return E_UNEXPECTED;
+
+  DeliverItem item = { pSample, bSizeChanged, width, height };
+  pSample->AddRef();
+
+  // Wait for room in the queue, this is where a slow downstream filter blocks the streaming thread
+  // A flush empties the queue, so this never waits past a flush
+  while (1) {
+    m_evSpace.Wait();
+
+    CAutoLock lock(&m_QueueCritSec);
+    if (m_Queue.size() < QUEUE_DEPTH) {
+      m_Queue.push_back(item);
+      if (m_Queue.size() >= QUEUE_DEPTH)
+        m_evSpace.Reset();
+      m_evIdle.Reset();
+      m_evQueue.Set();
+      break;
+    }
+  }
+
+  return S_OK;
+}
+
+STDMETHODIMP CDeliverThread::WaitForIdle()
+{
+  if (!CAMThread::ThreadExists())
+    return E_UNEXPECTED;
+
+  m_evIdle.Wait();
+  return S_OK;
+}
+
+STDMETHODIMP CDeliverThread::Flush()
+{
+  if (!CAMThread::ThreadExists())
+    return E_UNEXPECTED;
+
+  {
+    CAutoLock lock(&m_QueueCritSec);
+    while (!m_Queue.empty()) {
+      SafeRelease(&m_Queue.front().pSample);
+      m_Queue.pop_front();
+    }
+    m_evQueue.Reset();
+    m_evSpace.Set();
+    if (!m_bDelivering)
+      m_evIdle.Set();
+  }
+
+  // A delivery in progress returns promptly, downstream is either flushing or stopped at this point
+  m_evIdle.Wait();
+
+  return S_OK;
+}
+
+DWORD CDeliverThread::ThreadProc()
+{
+  DWORD cmd;
+
+  SetThreadName(-1, "LAVVideo Deliver Thread");
+
+  HANDLE hWaitEvents[2] = { GetRequestHandle(), m_evQueue };
+  while(1) {
+    // Wait for either a sample to deliver, or an request
+    WaitForMultipleObjects(2, hWaitEvents, FALSE, INFINITE);
+
+    if (CheckRequest(&cmd)) {
+      switch (cmd) {
+      case CMD_EXIT:
+        Reply(S_OK);
+        return 0;
+      default:
+        ASSERT(0);
+      }
+    }
+
+    DeliverItem item;
+    {
+      CAutoLock lock(&m_QueueCritSec);
+      if (m_Queue.empty()) {
+        m_evQueue.Reset();
+        continue;
+      }
+      item = m_Queue.front();
+      m_Queue.pop_front();
+      m_bDelivering = TRUE;
+      m_evSpace.Set();
+    }
+
+    HRESULT hr = m_pLAVVideo->m_pOutput->Deliver(item.pSample);
+    if (FAILED(hr)) {
+      DbgLog((LOG_ERROR, 10, L"CDeliverThread::ThreadProc(): Deliver failed with hr: %x", hr));
+      // Reported to upstream by the next call to Receive, keep the first failure
+      InterlockedCompareExchange(&m_pLAVVideo->m_hrDeliver, hr, S_OK);
+    }
+
+    if (item.bSizeChanged)
+      m_pLAVVideo->NotifyEvent(EC_VIDEO_SIZE_CHANGED, MAKELPARAM(item.width, item.height), 0);
+
+    SafeRelease(&item.pSample);
+
+    {
+      CAutoLock lock(&m_QueueCritSec);
+      m_bDelivering = FALSE;
+      if (m_Queue.empty()) {
+        m_evQueue.Reset();
+        m_evIdle.Set();
+      }
+    }
+  }
+
+  return 1;
+}
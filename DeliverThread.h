@@ -0,0 +1,72 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <deque>
+
+class CLAVVideo;
+
+// Last stage of the decode -> convert -> deliver pipeline
+// The streaming thread converts a frame into an output sample and queues it here, while the worker thread hands
+// the previously queued samples to the downstream filter.
+// The queue is bounded, so a slow renderer still throttles conversion (and through it, decoding) once it is full.
+class CDeliverThread : protected CAMThread
+{
+public:
+  CDeliverThread(CLAVVideo *pLAVVideo);
+  ~CDeliverThread();
+
+  // Number of samples which can wait for delivery, in addition to the one being delivered
+  enum { QUEUE_DEPTH = 2 };
+
+  // Queue a sample for delivery, waits until there is room in the queue
+  // If bSizeChanged is set, EC_VIDEO_SIZE_CHANGED is sent with the given size once the sample was delivered
+  STDMETHODIMP Queue(IMediaSample *pSample, BOOL bSizeChanged, LONG width, LONG height);
+
+  // Wait until all queued samples have been delivered
+  // Anything else sent downstream by the streaming thread (EOS, new segments, reconnects) has to wait for this first
+  STDMETHODIMP WaitForIdle();
+
+  // Release all queued samples without delivering them, and wait for a delivery in progress to return
+  STDMETHODIMP Flush();
+
+protected:
+  DWORD ThreadProc();
+
+private:
+  struct DeliverItem {
+    IMediaSample *pSample;
+    BOOL bSizeChanged;
+    LONG width;
+    LONG height;
+  };
+
+  enum {CMD_EXIT};
+
+  CLAVVideo    *m_pLAVVideo;
+
+  CCritSec     m_QueueCritSec;
+  std::deque<DeliverItem> m_Queue;
+  BOOL         m_bDelivering;
+
+  CAMEvent     m_evQueue;       // samples are waiting for delivery
+  CAMEvent     m_evSpace;       // the queue has room for another sample
+  CAMEvent     m_evIdle;        // the queue is empty, and no delivery is in progress
+};
@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "LAVVideo.h"
+#include "LAVThreadPool.h"
 
 static void lav_free_lavframe(void *opaque, uint8_t *data)
 {
@@ -38,6 +39,18 @@ static void avfilter_free_lav_buffer(LAVFrame *pFrame)
   av_frame_free((AVFrame **)&pFrame->priv_data);
 }
 
+// Run the slices of the filters on the shared thread pool, instead of threads owned by the filter graph
+static int lav_filter_execute(AVFilterContext *ctx, avfilter_action_func *func, void *arg, int *ret, int nb_jobs)
+{
+  CLAVThreadPool *pThreadPool = (CLAVThreadPool *)ctx->graph->opaque;
+  pThreadPool->Execute(nb_jobs, [&](int job) {
+    int r = func(ctx, arg, job, nb_jobs);
+    if (ret)
+      ret[job] = r;
+  });
+  return 0;
+}
+
 HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
 {
   int ret = 0;
@@ -76,8 +89,12 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
 
       m_pFilterGraph = avfilter_graph_alloc();
 
+      // The executor needs to be set before any filter is added
+      m_pFilterGraph->opaque  = m_pThreadPool;
+      m_pFilterGraph->execute = lav_filter_execute;
+
       av_opt_set(m_pFilterGraph, "thread_type", "slice", AV_OPT_SEARCH_CHILDREN);
-      av_opt_set_int(m_pFilterGraph, "threads", FFMAX(1, av_cpu_count() / 2), AV_OPT_SEARCH_CHILDREN);
+      av_opt_set_int(m_pFilterGraph, "threads", m_pThreadPool->GetNumThreads(), AV_OPT_SEARCH_CHILDREN);
 
       _snprintf_s(args, sizeof(args), "video_size=%dx%d:pix_fmt=%s:time_base=1/10000000:pixel_aspect=1/1", pFrame->width, pFrame->height, av_get_pix_fmt_name(ff_pixfmt));
       ret = avfilter_graph_create_filter(&m_pFilterBufferSrc, buffersrc, "in", args, NULL, m_pFilterGraph);
@@ -189,7 +206,7 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
       outFrame->bpp          = pFrame->bpp;
       outFrame->ext_format   = pFrame->ext_format;
       outFrame->avgFrameDuration = pFrame->avgFrameDuration;
-      outFrame->flags        = pFrame->flags;
+      outFrame->flags        = pFrame->flags & ~LAV_FRAME_FLAG_BUFFER_CONTIGUOUS;
 
       outFrame->width        = out_frame->width;
       outFrame->height       = out_frame->height;
@@ -0,0 +1,159 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVFrameAllocator.h"
+
+CLAVFrameSample::CLAVFrameSample(CLAVFrameAllocator *pAlloc, HRESULT *phr, LONG lSize, LONG lAlignment, LONG lPrefix)
+  : CMediaSample(NAME("CLAVFrameSample"), (CBaseAllocator*)pAlloc, phr, NULL, 0)
+  , m_pAllocBuffer(NULL), m_pOwnBuffer(NULL), m_cbOwnBuffer(0)
+  , m_pFrame(NULL)
+{
+  if (phr && FAILED(*phr))
+    return;
+
+  m_pAllocBuffer = (LPBYTE)_aligned_malloc(lSize + lPrefix, max(lAlignment, 16));
+  if (!m_pAllocBuffer) {
+    if (phr) *phr = E_OUTOFMEMORY;
+    return;
+  }
+
+  m_pOwnBuffer = m_pAllocBuffer + lPrefix;
+  m_cbOwnBuffer = lSize;
+  SetPointer(m_pOwnBuffer, m_cbOwnBuffer);
+}
+
+CLAVFrameSample::~CLAVFrameSample()
+{
+  ReleaseLAVFrame();
+  if (m_pAllocBuffer)
+    _aligned_free(m_pAllocBuffer);
+}
+
+//Note: CMediaSample does not derive from CUnknown, so we cannot use the
+//		DECLARE_IUNKNOWN macro that is used by most of the filter classes.
+
+STDMETHODIMP CLAVFrameSample::QueryInterface(REFIID riid, __deref_out void **ppv)
+{
+  CheckPointer(ppv,E_POINTER);
+  ValidateReadWritePtr(ppv,sizeof(PVOID));
+
+  if (riid == __uuidof(ILAVFrameSample)) {
+    return GetInterface((ILAVFrameSample*) this, ppv);
+  } else {
+    return CMediaSample::QueryInterface(riid, ppv);
+  }
+}
+
+STDMETHODIMP CLAVFrameSample::SetLAVFrame(LAVFrame *pFrame, LONG lSize)
+{
+  CheckPointer(pFrame, E_POINTER);
+  CheckPointer(pFrame->data[0], E_POINTER);
+  if (lSize <= 0)
+    return E_INVALIDARG;
+
+  ReleaseLAVFrame();
+
+  m_pFrame = pFrame;
+  return SetPointer(pFrame->data[0], lSize);
+}
+
+void CLAVFrameSample::ReleaseLAVFrame()
+{
+  if (m_pFrame) {
+    FreeLAVFrameBuffers(m_pFrame);
+    SAFE_CO_FREE(m_pFrame);
+    SetPointer(m_pOwnBuffer, m_cbOwnBuffer);
+  }
+}
+
+CLAVFrameAllocator::CLAVFrameAllocator(HRESULT* phr)
+  : CBaseAllocator(NAME("CLAVFrameAllocator"), NULL, phr)
+{
+}
+
+CLAVFrameAllocator::~CLAVFrameAllocator(void)
+{
+  Decommit();
+  Free();
+}
+
+STDMETHODIMP CLAVFrameAllocator::ReleaseBuffer(IMediaSample *pSample)
+{
+  CheckPointer(pSample, E_POINTER);
+
+  // Free the frame as soon as downstream is done with it, and not only when the sample is re-used
+  static_cast<CLAVFrameSample *>(pSample)->ReleaseLAVFrame();
+
+  return __super::ReleaseBuffer(pSample);
+}
+
+HRESULT CLAVFrameAllocator::Alloc()
+{
+  DbgLog((LOG_TRACE, 10, L"CLAVFrameAllocator::Alloc()"));
+  CAutoLock lock(this);
+
+  HRESULT hr = __super::Alloc();
+  if (FAILED(hr))
+    return hr;
+
+  // The properties did not change, keep the existing samples
+  if (hr == S_FALSE)
+    return S_OK;
+
+  Free();
+
+  for (LONG i = 0; i < m_lCount; i++) {
+    CLAVFrameSample *pSample = new CLAVFrameSample(this, &hr, m_lSize, m_lAlignment, m_lPrefix);
+    if (pSample == NULL) {
+      hr = E_OUTOFMEMORY;
+      break;
+    }
+    if (FAILED(hr)) {
+      delete pSample;
+      break;
+    }
+    m_lFree.Add(pSample);
+    m_lAllocated++;
+  }
+
+  if (FAILED(hr)) {
+    Free();
+    return hr;
+  }
+
+  m_bChanged = FALSE;
+  return S_OK;
+}
+
+void CLAVFrameAllocator::Free()
+{
+  CMediaSample *pSample = NULL;
+
+  CAutoLock lock(this);
+
+  do {
+    pSample = m_lFree.RemoveHead();
+    if (pSample) {
+      delete pSample;
+    }
+  } while (pSample);
+
+  m_lAllocated = 0;
+}
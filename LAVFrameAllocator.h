@@ -0,0 +1,74 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "decoders/ILAVDecoder.h"
+
+class CLAVFrameAllocator;
+
+interface __declspec(uuid("2C340C21-F1B4-49EB-A913-65FD0FA120C7"))
+ILAVFrameSample :
+public IUnknown {
+  // Deliver the buffer of the frame instead of the samples own buffer
+  // The sample takes ownership of the frame, and releases it once the sample is returned to the allocator
+  STDMETHOD(SetLAVFrame)(LAVFrame *pFrame, LONG lSize) = 0;
+};
+
+class CLAVFrameSample : public CMediaSample, public ILAVFrameSample
+{
+  friend class CLAVFrameAllocator;
+
+public:
+  CLAVFrameSample(CLAVFrameAllocator *pAlloc, HRESULT *phr, LONG lSize, LONG lAlignment, LONG lPrefix);
+  virtual ~CLAVFrameSample();
+
+  // IUnknown, the reference counting of ILAVFrameSample is the one of the sample
+  STDMETHODIMP          QueryInterface(REFIID riid, __deref_out void **ppv);
+  STDMETHODIMP_(ULONG)  AddRef() { return CMediaSample::AddRef(); }
+  STDMETHODIMP_(ULONG)  Release() { return CMediaSample::Release(); }
+
+  // ILAVFrameSample
+  STDMETHODIMP SetLAVFrame(LAVFrame *pFrame, LONG lSize);
+
+private:
+  // Release the attached frame, and go back to the own buffer
+  void ReleaseLAVFrame();
+
+  LPBYTE    m_pAllocBuffer;
+  LPBYTE    m_pOwnBuffer;
+  LONG      m_cbOwnBuffer;
+
+  LAVFrame *m_pFrame;
+};
+
+// Memory allocator for the output pin, which can deliver decoded frames without copying them
+// Samples behave like the samples of the default allocator, unless a frame is attached with ILAVFrameSample::SetLAVFrame
+class CLAVFrameAllocator : public CBaseAllocator
+{
+public:
+  CLAVFrameAllocator(HRESULT* phr);
+  virtual ~CLAVFrameAllocator(void);
+
+  STDMETHODIMP ReleaseBuffer(IMediaSample *pSample);
+
+protected:
+  HRESULT Alloc();
+  void Free();
+};
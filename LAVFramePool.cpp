@@ -0,0 +1,87 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVFramePool.h"
+
+CLAVFramePool::CLAVFramePool(size_t nMaxFrames)
+  : m_nMaxFrames(nMaxFrames)
+  , m_nHits(0)
+  , m_nMisses(0)
+{
+  m_Frames.reserve(nMaxFrames);
+}
+
+CLAVFramePool::~CLAVFramePool()
+{
+  DbgLog((LOG_TRACE, 10, L"CLAVFramePool::~CLAVFramePool(): %I64u hits, %I64u misses", m_nHits, m_nMisses));
+
+  for (size_t i = 0; i < m_Frames.size(); i++)
+    CoTaskMemFree(m_Frames[i]);
+  m_Frames.clear();
+}
+
+LAVFrame *CLAVFramePool::Acquire()
+{
+  LAVFrame *pFrame = NULL;
+  {
+    CAutoLock lock(&m_csPool);
+    if (!m_Frames.empty()) {
+      pFrame = m_Frames.back();
+      m_Frames.pop_back();
+      m_nHits++;
+    } else {
+      m_nMisses++;
+    }
+  }
+
+  if (!pFrame) {
+    pFrame = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+    if (!pFrame)
+      return NULL;
+  }
+
+  ZeroMemory(pFrame, sizeof(LAVFrame));
+  return pFrame;
+}
+
+void CLAVFramePool::Recycle(LAVFrame *pFrame)
+{
+  if (!pFrame)
+    return;
+
+  {
+    CAutoLock lock(&m_csPool);
+    if (m_Frames.size() < m_nMaxFrames) {
+      m_Frames.push_back(pFrame);
+      return;
+    }
+  }
+
+  CoTaskMemFree(pFrame);
+}
+
+void CLAVFramePool::GetStatistics(ULONGLONG *pHits, ULONGLONG *pMisses)
+{
+  CAutoLock lock(&m_csPool);
+  if (pHits)
+    *pHits = m_nHits;
+  if (pMisses)
+    *pMisses = m_nMisses;
+}
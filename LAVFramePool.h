@@ -0,0 +1,55 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "decoders/ILAVDecoder.h"
+
+// Free list of LAVFrame structures, used by CLAVVideo::AllocateFrame/ReleaseFrame
+//
+// Every frame is still a CoTaskMemAlloc block of its own, so frames which leave the filter and are freed elsewhere
+// (ie. attached to a zero-copy output sample, or to a avfilter buffer) can still be released with CoTaskMemFree.
+// Those frames just never make it back into the pool.
+// Frames are cleared when they are taken from the pool, not when they are returned.
+class CLAVFramePool
+{
+public:
+  CLAVFramePool(size_t nMaxFrames = 32);
+  ~CLAVFramePool();
+
+  // Get a cleared frame, from the pool if possible
+  LAVFrame *Acquire();
+
+  // Put a frame back into the pool, its buffers need to be freed already
+  // The frame is freed if the pool is full
+  void Recycle(LAVFrame *pFrame);
+
+  // Number of frames served from the pool, and the number which had to be allocated
+  void GetStatistics(ULONGLONG *pHits, ULONGLONG *pMisses);
+
+private:
+  CCritSec               m_csPool;
+  std::vector<LAVFrame*> m_Frames;
+  size_t                 m_nMaxFrames;
+
+  ULONGLONG              m_nHits;
+  ULONGLONG              m_nMisses;
+};
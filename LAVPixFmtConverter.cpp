@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "LAVPixFmtConverter.h"
+#include "LAVThreadPool.h"
 #include "Media.h"
 
 #include "decoders/ILAVDecoder.h"
@@ -27,25 +28,30 @@
 #include "moreuuids.h"
 
 #include <time.h>
+#include <map>
+#include <vector>
+#include <thread>
 #include "rand_sse.h"
 
 /*
  * Availability of custom high-quality converters
  * x = formatter available, - = fallback using swscale
  * 1 = up to 14-bit only
- * in/out       YV12    NV12    YV16     YUY2    UYVY    YV24   AYUV    P010    P210    v210    Y410    v410    P016    P216    Y416   RGB24   RGB32
- * YUV420         x       x       -       x       x       -       -       -       -       -       -       -       -       -       -      x       x
- * YUV420bX       x       x       -       x1      x1      -       -       x       -       -       -       -       x       -       -      x       x
- * YUV422         -       -       x       x       x       -       -       -       -       -       -       -       -       -       -      x       x
- * YUV422bX       -       -       x       x       x       -       -       -       x       -       -       -       -       x       -      x       x
- * YUV444         -       -       -       -       -       x       x       -       -       -       -       -       -       -       -      x       x
- * YUV444bX       -       -       -       -       -       x       x       -       -       -       x       -       -       -       x      x       x
- * NV12           x       x       -       x       x       -       -       -       -       -       -       -       -       -       -      x       x
- * YUY2           -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      -       -
- * RGB24          -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      x       -
- * RGB32          -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      -       x
- * ARGB32         -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      -       x
- * RGB48          -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      x       x
+ * 2 = 10-bit only
+ * 3 = up to 10-bit only
+ * in/out       YV12    NV12    YV16     YUY2    UYVY    YV24   AYUV    P010    P210    v210    Y410    v410    P016    P216    Y416   RGB24   RGB32   RGB48
+ * YUV420         x       x       -       x       x       -       -       x       x       x       x       x       x       x       x      x       x       -
+ * YUV420bX       x       x       -       x1      x1      -       -       x       -       -       -       -       x       -       -      x       x       -
+ * YUV422         -       -       x       x       x       -       -       x       x       x       x       x       x       x       x      x       x       -
+ * YUV422bX       -       -       x       x       x       -       -       -       x       x2      -       -       -       x       -      x       x       -
+ * YUV444         -       -       -       -       -       x       x       x       x       x       x       x       x       x       x      x       x       -
+ * YUV444bX       -       -       -       -       -       x       x       -       -       -       x       x3      -       -       x      x       x       -
+ * NV12           x       x       -       x       x       -       -       x       x       x       x       x       x       x       x      x       x       -
+ * YUY2           x       x       x       x       x       -       -       -       x       x       -       -       -       x       -      x       x       -
+ * RGB24          -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      x       x       x
+ * RGB32          -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      x       x       x
+ * ARGB32         -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      x       x       x
+ * RGB48          -       -       -       -       -       -       -       -       -       -       -       -       -       -       -      x       x       x
  *
  * Every processing path has a swscale fallback (even those with a "-" above), every combination of input/output is possible, just not optimized (ugly and/or slow)
  */
@@ -140,21 +146,35 @@ CLAVPixFmtConverter::CLAVPixFmtConverter()
   : m_pSettings(NULL)
   , m_InputPixFmt(LAVPixFmt_None)
   , m_OutputPixFmt(LAVOutPixFmt_YV12)
-  , m_pSwsContext(NULL)
   , swsWidth(0), swsHeight(0)
   , m_RequiredAlignment(0)
   , m_nAlignedBufferSize(0)
   , m_pAlignedBuffer(NULL)
+  , m_nScratchSize(0)
   , m_rgbCoeffs(NULL)
   , m_bRGBConverter(FALSE)
-  , m_pRandomDithers(NULL)
-  , m_ditherWidth(0)
-  , m_ditherHeight(0)
-  , m_ditherBits(0)
+  , m_pDitherTable(NULL)
+  , m_bSliceThreading(FALSE)
+  , m_bNegativeStride(FALSE)
+  , m_bPassthrough(FALSE)
+  , m_NumThreads(0)
+  , m_pThreadPool(NULL)
+  , m_bAdaptiveSlices(TRUE)
+  , m_nMaxSlices(1)
+  , m_AdaptKey(-1)
+  , m_pAdapt(NULL)
+  , m_pDitherLUT(NULL)
+  , m_DitherLUTBpp(0)
+  , m_DitherLUTFallback(NULL)
+  , m_ConverterName(NULL)
+  , m_MaxISA(LAVPixConvISA_AVX2)
+  , m_bStreamingStores(FALSE)
 {
   convert = &CLAVPixFmtConverter::convert_generic;
 
-  m_NumThreads = min(8, max(1, av_cpu_count() / 2));
+  SetNumThreads(0);
+  m_pThreadPool = CLAVThreadPool::GetShared();
+  AcquireDitherTables();
 
   ZeroMemory(&m_ColorProps, sizeof(m_ColorProps));
 }
@@ -163,6 +183,26 @@ CLAVPixFmtConverter::~CLAVPixFmtConverter()
 {
   DestroySWScale();
   av_freep(&m_pAlignedBuffer);
+  for (size_t i = 0; i < m_ScratchBuffers.size(); i++)
+    av_free(m_ScratchBuffers[i]);
+  m_ScratchBuffers.clear();
+  CLAVThreadPool::ReleaseShared();
+  ReleaseDitherTable(m_pDitherTable);
+  ReleaseDitherTables();
+  if (m_pDitherLUT)
+    _aligned_free(m_pDitherLUT);
+}
+
+void CLAVPixFmtConverter::SetNumThreads(int nThreads)
+{
+  // Without an override, this is only where the adaptive slice count starts from
+  m_bAdaptiveSlices = (nThreads <= 0);
+  if (nThreads <= 0)
+    nThreads = min(8, max(1, av_cpu_count() / 2));
+
+  m_NumThreads = nThreads;
+  m_AdaptStates.clear();
+  m_pAdapt = NULL;
 }
 
 LAVOutPixFmts CLAVPixFmtConverter::GetOutputBySubtype(const GUID *guid)
@@ -308,103 +348,552 @@ BOOL CLAVPixFmtConverter::IsAllowedSubtype(const GUID *guid)
 
 #define OUTPUT_RGB (m_OutputPixFmt == LAVOutPixFmt_RGB32 || m_OutputPixFmt == LAVOutPixFmt_RGB24)
 
+#define CONV(in, minBpp, maxBpp, out, isa, fn, flags, align) \
+  { LAVPixFmt_##in, minBpp, maxBpp, LAVOutPixFmt_##out, LAVPixConvISA_##isa, &CLAVPixFmtConverter::fn, NULL, flags, align, TEXT(#fn) TEXT(" (") TEXT(#isa) TEXT(")"), NULL }
+
+#define CONV_LUT(in, minBpp, maxBpp, out, isa, fn, lut) \
+  { LAVPixFmt_##in, minBpp, maxBpp, LAVOutPixFmt_##out, LAVPixConvISA_##isa, &CLAVPixFmtConverter::fn, &CLAVPixFmtConverter::lut, 0, 0, TEXT(#fn) TEXT(" (") TEXT(#isa) TEXT(")"), TEXT(#lut) }
+
+/*
+ * Registry of the custom converters
+ * For every conversion, the first entry that supports the input bit depth and the instruction set is used.
+ * Entries for the same conversion are therefore sorted by descending instruction set.
+ * Conversions without any matching entry use convert_generic (swscale).
+ */
+const CLAVPixFmtConverter::ConverterDesc CLAVPixFmtConverter::s_Converters[] = {
+  // v210/v410
+  CONV(YUV422bX, 10, 10, v210,   AVX2,  convert_yuv422_v210_avx2,                   0, 0),
+  CONV(YUV422bX, 10, 10, v210,   SSSE3, convert_yuv422_v210_ssse3<1>,               0, 0),
+  CONV(YUV422,   0, 16,  v210,   SSSE3, convert_yuv422_v210_ssse3<0>,               0, 0),
+  CONV(YUY2,     0, 16,  v210,   SSSE3, convert_yuy2_v210_ssse3,                    0, 0),
+  CONV(YUV420,   0, 16,  v210,   SSSE3, convert_yuv_hbd_resample,                   0, 0),
+  CONV(NV12,     0, 16,  v210,   SSSE3, convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV444,   0, 16,  v210,   SSSE3, convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV444bX, 0, 10,  v410,   AVX2,  convert_yuv444_v410_avx2,                   0, 0),
+  CONV(YUV444bX, 0, 10,  v410,   SSE2,  convert_yuv444_v410,                        0, 0),
+  CONV(YUV444,   0, 16,  v410,   SSE2,  convert_yuv444_x410<1>,                     0, 0),
+
+  // Copies without format change
+  CONV(RGB32,    0, 16,  RGB32,  C,     plane_copy,                                 CONV_FLAG_NEGATIVE_STRIDE, 0),
+  // Premultiplies ARGB32 with its alpha if enabled, and is a plain copy otherwise
+  CONV(ARGB32,   0, 16,  RGB32,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(ARGB32,   0, 16,  RGB32,  C,     plane_copy,                                 CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB24,    0, 16,  RGB24,  C,     plane_copy,                                 CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB48,    0, 16,  RGB48,  C,     plane_copy,                                 CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(NV12,     0, 16,  NV12,   SSE2,  convert_nv12_nv12,                          CONV_FLAG_PASSTHROUGH, 0),
+  CONV(NV12,     0, 16,  NV12,   C,     plane_copy,                                 CONV_FLAG_PASSTHROUGH, 0),
+  CONV(YUY2,     0, 16,  YUY2,   C,     plane_copy,                                 CONV_FLAG_PASSTHROUGH, 0),
+
+  // RGB to RGB
+  CONV(RGB24,    0, 16,  RGB32,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB24,    0, 16,  RGB48,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB32,    0, 16,  RGB24,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB32,    0, 16,  RGB48,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(ARGB32,   0, 16,  RGB24,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(ARGB32,   0, 16,  RGB48,  SSSE3, convert_rgb8_rgb_ssse3,                     CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB48,    0, 16,  RGB32,  SSSE3, convert_rgb48_rgb_ssse3<1>,                 CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB48,    0, 16,  RGB24,  SSSE3, convert_rgb48_rgb_ssse3<0>,                 CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB48,    0, 16,  RGB32,  SSE2,  convert_rgb48_rgb<1>,                       CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(RGB48,    0, 16,  RGB24,  SSE2,  convert_rgb48_rgb<0>,                       CONV_FLAG_NEGATIVE_STRIDE, 0),
+
+  // AYUV
+  CONV_LUT(YUV444bX, 0, 16,  AYUV,   SSE2,  convert_yuv444_ayuv_dither_le,            convert_yuv444_ayuv_dither_lut),
+  CONV(YUV444,   0, 16,  AYUV,   SSE2,  convert_yuv444_ayuv,                        0, 0),
+
+  // High bit-depth to 8-bit planar
+  CONV_LUT(YUV420bX, 0, 16,  NV12,   AVX2,  convert_yuv_yv_nv12_dither_le_avx2<TRUE>, convert_yuv_yv_nv12_dither_lut<TRUE>),
+  CONV_LUT(YUV420bX, 0, 16,  NV12,   SSE2,  convert_yuv_yv_nv12_dither_le<TRUE>,      convert_yuv_yv_nv12_dither_lut<TRUE>),
+  CONV_LUT(YUV420bX, 0, 16,  YV12,   AVX2,  convert_yuv_yv_nv12_dither_le_avx2<FALSE>, convert_yuv_yv_nv12_dither_lut<FALSE>),
+  CONV_LUT(YUV420bX, 0, 16,  YV12,   SSE2,  convert_yuv_yv_nv12_dither_le<FALSE>,     convert_yuv_yv_nv12_dither_lut<FALSE>),
+  CONV_LUT(YUV422bX, 0, 16,  YV16,   AVX2,  convert_yuv_yv_nv12_dither_le_avx2<FALSE>, convert_yuv_yv_nv12_dither_lut<FALSE>),
+  CONV_LUT(YUV422bX, 0, 16,  YV16,   SSE2,  convert_yuv_yv_nv12_dither_le<FALSE>,     convert_yuv_yv_nv12_dither_lut<FALSE>),
+  CONV_LUT(YUV444bX, 0, 16,  YV24,   AVX2,  convert_yuv_yv_nv12_dither_le_avx2<FALSE>, convert_yuv_yv_nv12_dither_lut<FALSE>),
+  CONV_LUT(YUV444bX, 0, 16,  YV24,   SSE2,  convert_yuv_yv_nv12_dither_le<FALSE>,     convert_yuv_yv_nv12_dither_lut<FALSE>),
+
+  // High bit-depth formats
+  CONV(YUV444bX, 0, 10,  Y410,   SSE2,  convert_yuv444_y410,                        0, 0),
+  CONV(YUV420bX, 0, 16,  P010,   AVX2,  convert_yuv420_px1x_le_avx2,                0, 0),
+  CONV(YUV420bX, 0, 16,  P010,   SSE2,  convert_yuv420_px1x_le,                     0, 0),
+  CONV(YUV420bX, 0, 16,  P016,   AVX2,  convert_yuv420_px1x_le_avx2,                0, 0),
+  CONV(YUV420bX, 0, 16,  P016,   SSE2,  convert_yuv420_px1x_le,                     0, 0),
+  CONV(YUV422bX, 0, 16,  P210,   AVX2,  convert_yuv420_px1x_le_avx2,                0, 0),
+  CONV(YUV422bX, 0, 16,  P210,   SSE2,  convert_yuv420_px1x_le,                     0, 0),
+  CONV(YUV422bX, 0, 16,  P216,   AVX2,  convert_yuv420_px1x_le_avx2,                0, 0),
+  CONV(YUV422bX, 0, 16,  P216,   SSE2,  convert_yuv420_px1x_le,                     0, 0),
+  CONV(YUV420,   0, 16,  P010,   SSE2,  convert_yuv_px1x<0>,                        0, 0),
+  CONV(YUV420,   0, 16,  P016,   SSE2,  convert_yuv_px1x<0>,                        0, 0),
+  CONV(NV12,     0, 16,  P010,   SSE2,  convert_yuv_px1x<1>,                        0, 0),
+  CONV(NV12,     0, 16,  P016,   SSE2,  convert_yuv_px1x<1>,                        0, 0),
+  CONV(YUV422,   0, 16,  P210,   SSE2,  convert_yuv_px1x<0>,                        0, 0),
+  CONV(YUV422,   0, 16,  P216,   SSE2,  convert_yuv_px1x<0>,                        0, 0),
+  CONV(YUV444,   0, 16,  Y410,   SSE2,  convert_yuv444_x410<0>,                     0, 0),
+  CONV(YUV444,   0, 16,  Y416,   SSE2,  convert_yuv444_y416,                        0, 0),
+  // Resampling the chroma to the output subsampling
+  CONV(YUV420,   0, 16,  P210,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV420,   0, 16,  P216,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV420,   0, 16,  Y410,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV420,   0, 16,  v410,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV420,   0, 16,  Y416,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(NV12,     0, 16,  P210,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(NV12,     0, 16,  P216,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(NV12,     0, 16,  Y410,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(NV12,     0, 16,  v410,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(NV12,     0, 16,  Y416,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV422,   0, 16,  P010,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV422,   0, 16,  P016,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV422,   0, 16,  Y410,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV422,   0, 16,  v410,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV422,   0, 16,  Y416,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV444,   0, 16,  P010,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV444,   0, 16,  P016,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV444,   0, 16,  P210,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+  CONV(YUV444,   0, 16,  P216,   SSE2,  convert_yuv_hbd_resample,                   0, 0),
+
+  // 8-bit planar
+  CONV(YUV420,   0, 16,  NV12,   SSE2,  convert_yuv420_nv12,                        0, 0),
+  CONV(NV12,     0, 16,  YV12,   SSE2,  convert_nv12_yv12,                          0, 0),
+  CONV(YUV420,   0, 16,  YV12,   SSE2,  convert_yuv_yv,                             0, 0),
+  CONV(YUV422,   0, 16,  YV16,   SSE2,  convert_yuv_yv,                             0, 0),
+  CONV(YUV444,   0, 16,  YV24,   SSE2,  convert_yuv_yv,                             0, 0),
+
+  // Packed 4:2:2
+  CONV(YUV422,   0, 16,  YUY2,   SSE2,  convert_yuv422_yuy2_uyvy<0>,                0, 0),
+  CONV(YUV422,   0, 16,  UYVY,   SSE2,  convert_yuv422_yuy2_uyvy<1>,                0, 0),
+  CONV(YUV420,   0, 14,  YUY2,   AVX2,  convert_yuv420_yuy2_avx2<0>,                0, 0),
+  CONV(YUV420,   0, 14,  YUY2,   SSE2,  convert_yuv420_yuy2<0>,                     0, 0),
+  CONV(YUV420,   0, 14,  UYVY,   AVX2,  convert_yuv420_yuy2_avx2<1>,                0, 0),
+  CONV(YUV420,   0, 14,  UYVY,   SSE2,  convert_yuv420_yuy2<1>,                     0, 0),
+  CONV(NV12,     0, 14,  YUY2,   AVX2,  convert_yuv420_yuy2_avx2<0>,                0, 0),
+  CONV(NV12,     0, 14,  YUY2,   SSE2,  convert_yuv420_yuy2<0>,                     0, 0),
+  CONV(NV12,     0, 14,  UYVY,   AVX2,  convert_yuv420_yuy2_avx2<1>,                0, 0),
+  CONV(NV12,     0, 14,  UYVY,   SSE2,  convert_yuv420_yuy2<1>,                     0, 0),
+  CONV(YUV420bX, 0, 14,  YUY2,   AVX2,  convert_yuv420_yuy2_avx2<0>,                0, 0),
+  CONV(YUV420bX, 0, 14,  YUY2,   SSE2,  convert_yuv420_yuy2<0>,                     0, 0),
+  CONV(YUV420bX, 0, 14,  UYVY,   AVX2,  convert_yuv420_yuy2_avx2<1>,                0, 0),
+  CONV(YUV420bX, 0, 14,  UYVY,   SSE2,  convert_yuv420_yuy2<1>,                     0, 0),
+  CONV_LUT(YUV422bX, 0, 16,  YUY2,   SSE2,  convert_yuv422_yuy2_uyvy_dither_le<0>,    convert_yuv422_yuy2_uyvy_dither_lut<0>),
+  CONV_LUT(YUV422bX, 0, 16,  UYVY,   SSE2,  convert_yuv422_yuy2_uyvy_dither_le<1>,    convert_yuv422_yuy2_uyvy_dither_lut<1>),
+
+  // YUY2 input
+  CONV(YUY2,     0, 16,  UYVY,   SSE2,  convert_yuy2_uyvy,                          0, 0),
+  CONV(YUY2,     0, 16,  YV16,   SSE2,  convert_yuy2_yv_nv12<0>,                    0, 0),
+  CONV(YUY2,     0, 16,  YV12,   SSE2,  convert_yuy2_yv_nv12<0>,                    0, 0),
+  CONV(YUY2,     0, 16,  NV12,   SSE2,  convert_yuy2_yv_nv12<1>,                    0, 0),
+  CONV(YUY2,     0, 16,  P210,   SSE2,  convert_yuy2_px1x,                          0, 0),
+  CONV(YUY2,     0, 16,  P216,   SSE2,  convert_yuy2_px1x,                          0, 0),
+
+  // YUV to RGB
+  CONV(YUV420,   0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420,   0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420bX, 0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420bX, 0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422,   0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422,   0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422bX, 0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422bX, 0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444,   0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444,   0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444bX, 0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444bX, 0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(NV12,     0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(NV12,     0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUY2,     0, 16,  RGB32,  AVX2,  convert_yuv_rgb_avx2<1>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUY2,     0, 16,  RGB32,  SSE2,  convert_yuv_rgb<1>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420,   0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420,   0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420bX, 0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV420bX, 0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422,   0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422,   0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422bX, 0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV422bX, 0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444,   0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444,   0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444bX, 0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUV444bX, 0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(NV12,     0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(NV12,     0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUY2,     0, 16,  RGB24,  AVX2,  convert_yuv_rgb_avx2<0>,                    CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+  CONV(YUY2,     0, 16,  RGB24,  SSE2,  convert_yuv_rgb<0>,                         CONV_FLAG_RGB|CONV_FLAG_NEGATIVE_STRIDE, 0),
+};
+
+static const LPCWSTR s_ISANames[] = { L"C", L"SSE2", L"SSSE3", L"AVX2" };
+
+LAVPixConvISA CLAVPixFmtConverter::GetMaxISA()
+{
+  int cpu = av_get_cpu_flags();
+  LAVPixConvISA isa = LAVPixConvISA_C;
+  if (cpu & AV_CPU_FLAG_SSE2)
+    isa = LAVPixConvISA_SSE2;
+  if ((cpu & AV_CPU_FLAG_SSSE3) && isa == LAVPixConvISA_SSE2)
+    isa = LAVPixConvISA_SSSE3;
+  if ((cpu & AV_CPU_FLAG_AVX2) && isa == LAVPixConvISA_SSSE3)
+    isa = LAVPixConvISA_AVX2;
+
+  // The instruction set can be limited for testing, or to work around CPU errata
+  WCHAR value[16] = {0};
+  if (GetEnvironmentVariableW(LAV_PIXCONV_ISA_ENV, value, countof(value)) > 0) {
+    for (int i = 0; i < countof(s_ISANames); i++) {
+      if (_wcsicmp(value, s_ISANames[i]) == 0) {
+        if (i < isa) {
+          DbgLog((LOG_TRACE, 10, L"::GetMaxISA(): Limiting converters to %s", s_ISANames[i]));
+          isa = (LAVPixConvISA)i;
+        }
+        break;
+      }
+    }
+  }
+
+  return isa;
+}
+
 void CLAVPixFmtConverter::SelectConvertFunction()
 {
-  m_RequiredAlignment = 16;
+  // The SSE2 converters write into any destination directly, only the swscale paths need an aligned buffer
+  m_RequiredAlignment = 0;
   m_bRGBConverter = FALSE;
+  m_bSliceThreading = TRUE;
+  m_bNegativeStride = FALSE;
+  m_bPassthrough = FALSE;
+  m_DitherLUTFallback = NULL;
+  m_ConverterName = NULL;
   convert = NULL;
 
-  int cpu = av_get_cpu_flags();
-  if (m_OutputPixFmt == LAVOutPixFmt_v210 || m_OutputPixFmt == LAVOutPixFmt_v410) {
-    // We assume that every filter that understands v210 will also properly handle it
-    m_RequiredAlignment = 0;
-  } else if ((m_OutputPixFmt == LAVOutPixFmt_RGB32 && (m_InputPixFmt == LAVPixFmt_RGB32 || m_InputPixFmt == LAVPixFmt_ARGB32))
-    || (m_OutputPixFmt == LAVOutPixFmt_RGB24 && m_InputPixFmt == LAVPixFmt_RGB24) || (m_OutputPixFmt == LAVOutPixFmt_RGB48 && m_InputPixFmt == LAVPixFmt_RGB48)) {
-    convert = &CLAVPixFmtConverter::plane_copy;
-    m_RequiredAlignment = 0;
-  } else if (m_InputPixFmt == LAVPixFmt_RGB48 && m_OutputPixFmt == LAVOutPixFmt_RGB32 && (cpu & AV_CPU_FLAG_SSSE3)) {
-    convert = &CLAVPixFmtConverter::convert_rgb48_rgb32_ssse3;
-  } else if (cpu & AV_CPU_FLAG_SSE2) {
-    if (m_OutputPixFmt == LAVOutPixFmt_AYUV && m_InputPixFmt == LAVPixFmt_YUV444bX) {
-      convert = &CLAVPixFmtConverter::convert_yuv444_ayuv_dither_le;
-    } else if (m_OutputPixFmt == LAVOutPixFmt_AYUV && m_InputPixFmt == LAVPixFmt_YUV444) {
-      convert = &CLAVPixFmtConverter::convert_yuv444_ayuv;
-    } else if (m_OutputPixFmt == LAVOutPixFmt_Y410 && m_InputPixFmt == LAVPixFmt_YUV444bX && m_InBpp <= 10) {
-      convert = &CLAVPixFmtConverter::convert_yuv444_y410;
-    } else if (((m_OutputPixFmt == LAVOutPixFmt_YV12 || m_OutputPixFmt == LAVOutPixFmt_NV12) && m_InputPixFmt == LAVPixFmt_YUV420bX)
-             || (m_OutputPixFmt == LAVOutPixFmt_YV16 && m_InputPixFmt == LAVPixFmt_YUV422bX)
-             || (m_OutputPixFmt == LAVOutPixFmt_YV24 && m_InputPixFmt == LAVPixFmt_YUV444bX)) {
-      if (m_OutputPixFmt == LAVOutPixFmt_NV12) {
-        convert = &CLAVPixFmtConverter::convert_yuv_yv_nv12_dither_le<TRUE>;
-      } else {
-        convert = &CLAVPixFmtConverter::convert_yuv_yv_nv12_dither_le<FALSE>;
-      }
-      m_RequiredAlignment = 32;
-    } else if (((m_OutputPixFmt == LAVOutPixFmt_P010 || m_OutputPixFmt == LAVOutPixFmt_P016) && m_InputPixFmt == LAVPixFmt_YUV420bX)
-            || ((m_OutputPixFmt == LAVOutPixFmt_P210 || m_OutputPixFmt == LAVOutPixFmt_P216) && m_InputPixFmt == LAVPixFmt_YUV422bX)) {
-      convert = &CLAVPixFmtConverter::convert_yuv420_px1x_le;
-    } else if (m_OutputPixFmt == LAVOutPixFmt_NV12 && m_InputPixFmt == LAVPixFmt_YUV420) {
-      convert = &CLAVPixFmtConverter::convert_yuv420_nv12;
-      m_RequiredAlignment = 32;
-    } else if (m_OutputPixFmt == LAVOutPixFmt_YUY2 && m_InputPixFmt == LAVPixFmt_YUV422) {
-      convert = &CLAVPixFmtConverter::convert_yuv422_yuy2_uyvy<0>;
-      m_RequiredAlignment = 32;
-    } else if (m_OutputPixFmt == LAVOutPixFmt_UYVY && m_InputPixFmt == LAVPixFmt_YUV422) {
-      convert = &CLAVPixFmtConverter::convert_yuv422_yuy2_uyvy<1>;
-      m_RequiredAlignment = 32;
-    } else if ((m_OutputPixFmt == LAVOutPixFmt_RGB32 || m_OutputPixFmt == LAVOutPixFmt_RGB24)
-            && (m_InputPixFmt == LAVPixFmt_YUV420 || m_InputPixFmt == LAVPixFmt_YUV420bX
-             || m_InputPixFmt == LAVPixFmt_YUV422 || m_InputPixFmt == LAVPixFmt_YUV422bX
-             || m_InputPixFmt == LAVPixFmt_YUV444 || m_InputPixFmt == LAVPixFmt_YUV444bX
-             || m_InputPixFmt == LAVPixFmt_NV12)) {
-      if (m_OutputPixFmt == LAVOutPixFmt_RGB32) {
-        convert = &CLAVPixFmtConverter::convert_yuv_rgb<1>;
-        m_RequiredAlignment = 4;
-      } else {
-        convert = &CLAVPixFmtConverter::convert_yuv_rgb<0>;
-      }
-      m_bRGBConverter = TRUE;
-    } else if (m_OutputPixFmt == LAVOutPixFmt_YV12 && m_InputPixFmt == LAVPixFmt_NV12) {
-      convert = &CLAVPixFmtConverter::convert_nv12_yv12;
-      m_RequiredAlignment = 32;
-    } else if ((m_OutputPixFmt == LAVOutPixFmt_YUY2 || m_OutputPixFmt == LAVOutPixFmt_UYVY) && (m_InputPixFmt == LAVPixFmt_YUV420 || m_InputPixFmt == LAVPixFmt_NV12 || m_InputPixFmt == LAVPixFmt_YUV420bX) && m_InBpp <= 14) {
-      if (m_OutputPixFmt == LAVOutPixFmt_YUY2) {
-        convert = &CLAVPixFmtConverter::convert_yuv420_yuy2<0>;
-      } else {
-        convert = &CLAVPixFmtConverter::convert_yuv420_yuy2<1>;
-      }
-      m_RequiredAlignment = 8; // Pixel alignment of 8 guarantees a byte alignment of 16
-    } else if ((m_OutputPixFmt == LAVOutPixFmt_YUY2 || m_OutputPixFmt == LAVOutPixFmt_UYVY) && m_InputPixFmt == LAVPixFmt_YUV422bX) {
-      if (m_OutputPixFmt == LAVOutPixFmt_YUY2) {
-        convert = &CLAVPixFmtConverter::convert_yuv422_yuy2_uyvy_dither_le<0>;
-      } else {
-        convert = &CLAVPixFmtConverter::convert_yuv422_yuy2_uyvy_dither_le<1>;
-      }
-
-      m_RequiredAlignment = 8; // Pixel alignment of 8 guarantees a byte alignment of 16
-    } else if ((m_OutputPixFmt == LAVOutPixFmt_NV12 && m_InputPixFmt == LAVPixFmt_NV12)) {
-      convert = &CLAVPixFmtConverter::convert_nv12_nv12;
-      m_RequiredAlignment = 0;
-    } else if ((m_OutputPixFmt == LAVOutPixFmt_YV12 && m_InputPixFmt == LAVPixFmt_YUV420)
-            || (m_OutputPixFmt == LAVOutPixFmt_YV16 && m_InputPixFmt == LAVPixFmt_YUV422)
-            || (m_OutputPixFmt == LAVOutPixFmt_YV24 && m_InputPixFmt == LAVPixFmt_YUV444)) {
-      convert = &CLAVPixFmtConverter::convert_yuv_yv;
-      m_RequiredAlignment = 0;
-    } else if (m_InputPixFmt == LAVPixFmt_RGB48 && (m_OutputPixFmt == LAVOutPixFmt_RGB24 || m_OutputPixFmt == LAVOutPixFmt_RGB32)) {
-      if (m_OutputPixFmt == LAVOutPixFmt_RGB32)
-        convert = &CLAVPixFmtConverter::convert_rgb48_rgb<1>;
-      else
-        convert = &CLAVPixFmtConverter::convert_rgb48_rgb<0>;
-    }
-  // Fallbacks only to be used when SSE2 is not available
-  } else if ((m_OutputPixFmt == LAVOutPixFmt_NV12 && m_InputPixFmt == LAVPixFmt_NV12)) {
-    convert = &CLAVPixFmtConverter::plane_copy;
-    m_RequiredAlignment = 0;
+  const LAVPixConvISA maxISA = min(GetMaxISA(), m_MaxISA);
+  for (int i = 0; i < countof(s_Converters); i++) {
+    const ConverterDesc *desc = &s_Converters[i];
+    if (desc->in != m_InputPixFmt || desc->out != m_OutputPixFmt || m_InBpp < desc->minBpp || m_InBpp > desc->maxBpp || desc->isa > maxISA)
+      continue;
+
+    convert = desc->fn;
+    m_ConverterName = desc->name;
+    m_RequiredAlignment = desc->alignment;
+    m_bRGBConverter = !!(desc->flags & CONV_FLAG_RGB);
+    m_bSliceThreading = !(desc->flags & CONV_FLAG_NO_SLICES);
+    m_bNegativeStride = !!(desc->flags & CONV_FLAG_NEGATIVE_STRIDE);
+    m_bPassthrough = !!(desc->flags & CONV_FLAG_PASSTHROUGH);
+
+    if (desc->ditherLUT && SelectDitherLUT(desc->ditherLUT))
+      m_ConverterName = desc->ditherLUTName;
+    break;
   }
 
   if (convert == NULL) {
     convert = &CLAVPixFmtConverter::convert_generic;
+    m_ConverterName = L"convert_generic (swscale)";
+    m_bSliceThreading = FALSE;
+    // We assume that every filter that understands v210 will also properly handle it, so v210/v410 don't need a bounce buffer
+    if (m_OutputPixFmt != LAVOutPixFmt_v210 && m_OutputPixFmt != LAVOutPixFmt_v410)
+      m_RequiredAlignment = 16;
+  }
+
+  DbgLog((LOG_TRACE, 10, L"::SelectConvertFunction(): Using %s, max. instruction set %s", m_ConverterName, s_ISANames[maxISA]));
+}
+
+// Size of the largest data cache of the CPU, usually the last-level cache shared by all cores
+static size_t GetLastLevelCacheSize()
+{
+  static size_t cacheSize = 0;
+  if (cacheSize)
+    return cacheSize;
+
+  size_t size = 0;
+  DWORD len = 0;
+  GetLogicalProcessorInformation(NULL, &len);
+  SYSTEM_LOGICAL_PROCESSOR_INFORMATION *info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)malloc(len);
+  if (info && GetLogicalProcessorInformation(info, &len)) {
+    for (DWORD i = 0; i < len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); i++) {
+      if (info[i].Relationship == RelationCache && info[i].Cache.Type != CacheInstruction)
+        size = max(size, (size_t)info[i].Cache.Size);
+    }
+  }
+  free(info);
+
+  // Assume a typical desktop CPU if the cache topology is not available
+  if (size == 0)
+    size = 8 << 20;
+
+  DbgLog((LOG_TRACE, 10, L"GetLastLevelCacheSize(): %u KB", (unsigned)(size >> 10)));
+  cacheSize = size;
+  return cacheSize;
+}
+
+BOOL CLAVPixFmtConverter::UseStreamingStores(int stride, int height)
+{
+  // Frames bigger than half the cache would evict the data of the decoder (e.g. reference frames), and are written
+  // past the cache. Smaller frames stay cached, which also helps the subtitle rendering on the output.
+  const size_t outputSize = (size_t)stride * height * lav_pixfmt_desc[m_OutputPixFmt].bpp / 8;
+  return outputSize > GetLastLevelCacheSize() / 2;
+}
+
+// Frames per measurement of a slice count
+#define ADAPT_WINDOW 8
+// Measurements with the best slice count until the neighbouring counts are tried again
+#define ADAPT_REPROBE_WINDOWS 64
+// A higher slice count has to be this much faster to be used
+#define ADAPT_GAIN_UP   0.90
+// A lower slice count may be this much slower, saving a thread is worth it
+#define ADAPT_GAIN_DOWN 1.05
+// The best slice count is measured again if its time changes by more than this, e.g. because of the system load
+#define ADAPT_DRIFT     0.25
+// Conversions and frame sizes to keep the measurements of
+#define ADAPT_MAX_SIZES 8
+
+int CLAVPixFmtConverter::GetAdaptiveSlices(int width, int height, int maxSlices)
+{
+  if (maxSlices != m_nMaxSlices) {
+    // Start over when the thread pool changed size
+    m_AdaptStates.clear();
+    m_pAdapt = NULL;
+    m_nMaxSlices = maxSlices;
+  }
+
+  const LONGLONG key = ((LONGLONG)((m_InputPixFmt << 16) | (m_InBpp << 8) | m_OutputPixFmt) << 32) | ((LONGLONG)width << 16) | height;
+  if (!m_pAdapt || key != m_AdaptKey) {
+    std::map<LONGLONG, AdaptiveSlices>::iterator it = m_AdaptStates.find(key);
+    if (it == m_AdaptStates.end()) {
+      if (m_AdaptStates.size() >= ADAPT_MAX_SIZES)
+        m_AdaptStates.clear();
+
+      // Every new conversion and frame size starts with the default count
+      AdaptiveSlices adapt;
+      adapt.state = ADAPT_MEASURE;
+      adapt.nBestSlices = adapt.nSlices = min(m_NumThreads, maxSlices);
+      adapt.bestTime = 0.0;
+      adapt.bProbeUpWon = FALSE;
+      // The first frame also initializes tables and wakes up the threads
+      adapt.nSkip = 1;
+      adapt.nSamples = 0;
+      adapt.timeSum = 0.0;
+      adapt.nWindows = 0;
+      it = m_AdaptStates.insert(std::make_pair(key, adapt)).first;
+    }
+    m_AdaptKey = key;
+    m_pAdapt = &it->second;
+  }
+  return m_pAdapt->nSlices;
+}
+
+// Try the next slice count in the given direction from the best one, or keep the best one if dir is 0 or there are no more counts to try
+void CLAVPixFmtConverter::ProbeAdaptiveSlices(int dir)
+{
+  AdaptiveSlices &adapt = *m_pAdapt;
+  const int next = (dir > 0) ? min(adapt.nBestSlices * 2, m_nMaxSlices) : max(adapt.nBestSlices / 2, 1);
+  if (dir != 0 && next != adapt.nBestSlices) {
+    adapt.nSlices = next;
+    adapt.state = (dir > 0) ? ADAPT_PROBE_UP : ADAPT_PROBE_DOWN;
+  } else if (dir > 0 && !adapt.bProbeUpWon) {
+    ProbeAdaptiveSlices(-1);
+  } else {
+    DbgLog((LOG_TRACE, 10, L"::ProbeAdaptiveSlices(): Using %d slices for %dx%d", adapt.nBestSlices, (int)((m_AdaptKey >> 16) & 0xFFFF), (int)(m_AdaptKey & 0xFFFF)));
+    adapt.nSlices = adapt.nBestSlices;
+    adapt.state = ADAPT_SETTLED;
+    adapt.nWindows = 0;
+  }
+}
+
+void CLAVPixFmtConverter::UpdateAdaptiveSlices(double time)
+{
+  AdaptiveSlices &adapt = *m_pAdapt;
+  if (adapt.nSkip > 0) {
+    adapt.nSkip--;
+    return;
+  }
+
+  // Every window averages the same number of frames, so that the windows can be compared
+  adapt.timeSum += time;
+  if (++adapt.nSamples < ADAPT_WINDOW)
+    return;
+
+  const double avg = adapt.timeSum / adapt.nSamples;
+  adapt.timeSum = 0.0;
+  adapt.nSamples = 0;
+
+  switch (adapt.state) {
+  case ADAPT_MEASURE:
+    adapt.bestTime = avg;
+    adapt.bProbeUpWon = FALSE;
+    ProbeAdaptiveSlices(1);
+    break;
+  case ADAPT_PROBE_UP:
+    if (avg < adapt.bestTime * ADAPT_GAIN_UP) {
+      adapt.nBestSlices = adapt.nSlices;
+      adapt.bestTime = avg;
+      adapt.bProbeUpWon = TRUE;
+      ProbeAdaptiveSlices(1);
+    } else {
+      // Lower counts only need to be tried if the starting point was the best so far
+      ProbeAdaptiveSlices(adapt.bProbeUpWon ? 0 : -1);
+    }
+    break;
+  case ADAPT_PROBE_DOWN:
+    if (avg < adapt.bestTime * ADAPT_GAIN_DOWN) {
+      // Compared against the fastest time, so that several steps down cannot add up
+      adapt.nBestSlices = adapt.nSlices;
+      adapt.bestTime = min(adapt.bestTime, avg);
+      ProbeAdaptiveSlices(-1);
+    } else {
+      ProbeAdaptiveSlices(0);
+    }
+    break;
+  case ADAPT_SETTLED:
+    if (avg > adapt.bestTime * (1.0 + ADAPT_DRIFT) || avg < adapt.bestTime * (1.0 - ADAPT_DRIFT) || ++adapt.nWindows >= ADAPT_REPROBE_WINDOWS) {
+      adapt.nSlices = adapt.nBestSlices;
+      adapt.state = ADAPT_MEASURE;
+    }
+    break;
+  }
+}
+
+HRESULT CLAVPixFmtConverter::ConvertSlices(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int dstStride, int width, int height)
+{
+  // Don't bother splitting small images, the thread overhead would outweigh the gain
+  // More slices than threads in the pool would only queue up behind each other
+  const int maxSlices = m_bSliceThreading ? min(m_pThreadPool->GetNumThreads(), height / 64) : 1;
+  if (maxSlices <= 1)
+    return (this->*convert)(src, srcStride, dst, dstStride, width, height, 0, height, m_InputPixFmt, m_InBpp, m_OutputPixFmt);
+
+  const int threads = m_bAdaptiveSlices ? GetAdaptiveSlices(width, height, maxSlices) : min(m_NumThreads, maxSlices);
+
+  LARGE_INTEGER start, end;
+  if (m_bAdaptiveSlices)
+    QueryPerformanceCounter(&start);
+
+  volatile LONG hr = S_OK;
+  if (threads <= 1) {
+    hr = (this->*convert)(src, srcStride, dst, dstStride, width, height, 0, height, m_InputPixFmt, m_InBpp, m_OutputPixFmt);
+  } else {
+    // Slices need to start on an even line, so that chroma subsampling and the 4:2:0 line pairs are not split
+    const int linesPerThread = (height / threads) & ~1;
+
+    m_pThreadPool->Execute(threads, [&](int slice) {
+      const int sliceYStart = slice * linesPerThread;
+      const int sliceYEnd   = (slice == threads - 1) ? height : sliceYStart + linesPerThread;
+      HRESULT hrSlice = (this->*convert)(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, m_InputPixFmt, m_InBpp, m_OutputPixFmt);
+      if (FAILED(hrSlice))
+        InterlockedCompareExchange(&hr, hrSlice, S_OK);
+    });
+  }
+
+  if (m_bAdaptiveSlices) {
+    // Only relative times are compared, no need to convert the ticks
+    QueryPerformanceCounter(&end);
+    UpdateAdaptiveSlices((double)(end.QuadPart - start.QuadPart));
   }
+
+  return hr;
+}
+
+// Benchmark results of the dithering LUT, shared by all converter instances
+// Key is the conversion (input/output format and bit depth, and the instruction set of the arithmetic version), value is TRUE if the LUT was faster
+static CCritSec s_csDitherLUTBench;
+static std::map<int, BOOL> s_DitherLUTBench;
+
+BOOL CLAVPixFmtConverter::SelectDitherLUT(ConverterFn lutFn)
+{
+  // The LUT only exists for ordered dithering of 9 to 12 bit input
+  if (GetDitherLUT(m_InBpp) == NULL)
+    return FALSE;
+
+  const int key = (((m_InputPixFmt << 8) | m_OutputPixFmt) << 8 | m_InBpp) << 2 | min(GetMaxISA(), m_MaxISA);
+
+  BOOL bFound = FALSE, bUseLUT = FALSE;
+  {
+    CAutoLock lock(&s_csDitherLUTBench);
+    std::map<int, BOOL>::const_iterator it = s_DitherLUTBench.find(key);
+    if (it != s_DitherLUTBench.end()) {
+      bFound = TRUE;
+      bUseLUT = it->second;
+    }
+  }
+
+  if (!bFound) {
+    // Convert a small synthetic picture with both versions, and keep the best of a few runs
+    // This is done without holding the lock, so that other instances are not blocked by it
+    const int width = 1920, height = 32, runs = 5;
+    const int srcStride[4] = { width * 2, width * 2, width * 2, 0 };
+    uint8_t *planes[3];
+    for (int i = 0; i < 3; i++) {
+      planes[i] = (uint8_t *)av_malloc(srcStride[i] * height);
+      uint16_t *p = (uint16_t *)planes[i];
+      for (int j = 0; j < width * height; j++)
+        p[j] = (j * 37) & ((1 << m_InBpp) - 1);
+    }
+    const uint8_t* const src[4] = { planes[0], planes[1], planes[2], NULL };
+    uint8_t *dst = (uint8_t *)av_malloc(width * height * 4);
+
+    LARGE_INTEGER frequency, start, end;
+    LONGLONG bestLUT = LLONG_MAX, bestArith = LLONG_MAX;
+    QueryPerformanceFrequency(&frequency);
+    m_DitherLUTFallback = convert;
+    for (int i = 0; i < runs; i++) {
+      QueryPerformanceCounter(&start);
+      (this->*convert)(src, srcStride, dst, width, width, height, 0, height, m_InputPixFmt, m_InBpp, m_OutputPixFmt);
+      QueryPerformanceCounter(&end);
+      bestArith = min(bestArith, end.QuadPart - start.QuadPart);
+
+      QueryPerformanceCounter(&start);
+      (this->*lutFn)(src, srcStride, dst, width, width, height, 0, height, m_InputPixFmt, m_InBpp, m_OutputPixFmt);
+      QueryPerformanceCounter(&end);
+      bestLUT = min(bestLUT, end.QuadPart - start.QuadPart);
+    }
+
+    for (int i = 0; i < 3; i++)
+      av_freep(&planes[i]);
+    av_freep(&dst);
+
+    DbgLog((LOG_TRACE, 10, L"::SelectDitherLUT(): Arithmetic: %2.3fms, LUT: %2.3fms", bestArith * 1000.0 / frequency.QuadPart, bestLUT * 1000.0 / frequency.QuadPart));
+
+    // If another instance measured the same conversion in the meantime, its result is used, so that all instances agree
+    CAutoLock lock(&s_csDitherLUTBench);
+    bUseLUT = s_DitherLUTBench.insert(std::make_pair(key, bestLUT < bestArith)).first->second;
+  }
+
+  if (bUseLUT) {
+    // The arithmetic version is still needed for random dithering
+    m_DitherLUTFallback = convert;
+    convert = lutFn;
+    return TRUE;
+  }
+
+  m_DitherLUTFallback = NULL;
+  return FALSE;
+}
+
+BOOL CLAVPixFmtConverter::IsPassthroughPossible(const LAVFrame *pFrame, int height, int *pStride, long *pSize)
+{
+  if (!m_bPassthrough || !(pFrame->flags & LAV_FRAME_FLAG_BUFFER_CONTIGUOUS) || !pFrame->destruct)
+    return FALSE;
+
+  const LAVOutPixFmtDesc &desc = lav_pixfmt_desc[m_OutputPixFmt];
+  const int strideBytes = pFrame->stride[0];
+  if (strideBytes <= 0 || (strideBytes % desc.codedbytes) != 0)
+    return FALSE;
+
+  // Every plane has to start right after the previous one, using the same layout the converter would write
+  // Like in AllocLAVFrameBuffers, subsampled planes of odd heights have a line for the last, incomplete line pair
+  const BYTE *expected = pFrame->data[0];
+  for (int plane = 0; plane < desc.planes; plane++) {
+    if (pFrame->data[plane] != expected || pFrame->stride[plane] != strideBytes / desc.planeWidth[plane])
+      return FALSE;
+    expected += (ptrdiff_t)pFrame->stride[plane] * ((height + desc.planeHeight[plane] - 1) / desc.planeHeight[plane]);
+  }
+
+  *pStride = strideBytes / desc.codedbytes;
+  *pSize = (long)(expected - pFrame->data[0]);
+  return TRUE;
+}
+
+HRESULT CLAVPixFmtConverter::ConvertFlipped(LAVFrame *pFrame, uint8_t *dst, int width, int height, int dstStride)
+{
+  // Convert top-down into the same buffer, and flip it afterwards
+  const int lineSize = -dstStride * lav_pixfmt_desc[m_OutputPixFmt].codedbytes;
+  uint8_t *top = dst - (ptrdiff_t)lineSize * (height - 1);
+
+  HRESULT hr = Convert(pFrame, top, width, height, -dstStride);
+  flip_plane(top, lineSize, height);
+
+  return hr;
 }
 
 DECLARE_CONV_FUNC_IMPL(plane_copy)
@@ -418,15 +907,20 @@ DECLARE_CONV_FUNC_IMPL(plane_copy)
   const int planes = max(desc.planes, 1);
 
   for (plane = 0; plane < planes; plane++) {
-    const int planeWidth     = widthBytes     / desc.planeWidth[plane];
-    const int planeHeight    = height         / desc.planeHeight[plane];
-    const int dstPlaneStride = dstStrideBytes / desc.planeWidth[plane];
-    const uint8_t *srcBuf = src[plane];
-    for (line = 0; line < planeHeight; ++line) {
-      memcpy(dst, srcBuf, planeWidth);
+    // The interleaved chroma of NV12 and the last YUY2 macropixel of odd widths cover one more pixel
+    const int planeWidth      = ((outputFormat == LAVOutPixFmt_NV12 && plane == 1) || outputFormat == LAVOutPixFmt_YUY2) ? ((width + 1) & ~1) * desc.codedbytes : widthBytes / desc.planeWidth[plane];
+    const int planeHeight     = height         / desc.planeHeight[plane];
+    const int dstPlaneStride  = dstStrideBytes / desc.planeWidth[plane];
+    const int planeSliceStart = sliceYStart / desc.planeHeight[plane];
+    const int planeSliceEnd   = (sliceYEnd == height) ? planeHeight : (sliceYEnd / desc.planeHeight[plane]);
+    const uint8_t *srcBuf = src[plane] + srcStride[plane] * planeSliceStart;
+    uint8_t *dstBuf = dst + dstPlaneStride * planeSliceStart;
+    for (line = planeSliceStart; line < planeSliceEnd; ++line) {
+      memcpy(dstBuf, srcBuf, planeWidth);
       srcBuf += srcStride[plane];
-      dst += dstPlaneStride;
+      dstBuf += dstPlaneStride;
     }
+    dst += dstPlaneStride * planeHeight;
   }
 
   return S_OK;
@@ -461,55 +955,221 @@ void CLAVPixFmtConverter::ChangeStride(const uint8_t* src, int srcStride, uint8_
   }
 }
 
-const uint16_t* CLAVPixFmtConverter::GetRandomDitherCoeffs(int height, int coeffs, int bits, int line)
-{
-  if (m_pSettings->GetDitherMode() != LAVDither_Random)
-    return NULL;
+// Random dithering tables, shared read-only by all converter instances
+// A table is a block of random coefficients, which the converters read in lines of the width they need. Any table
+// with enough coefficients for the width and height of a conversion can be used for it, and the tables are sized in
+// width and height classes, so that new tables are rarely needed. Tables are created on a background thread when a
+// conversion first needs them, and freed once no converter uses them anymore and a bigger table replaced them.
+struct RandomDitherTable {
+  int size;           // number of coefficients
+  int bits;
+  uint16_t *data;
+  volatile LONG ready;
+  int refs;           // converters using the table
+  std::thread thread;
+};
 
-  int totalWidth = 8 * coeffs;
-  if (!m_pRandomDithers || totalWidth > m_ditherWidth || height > m_ditherHeight || bits != m_ditherBits) {
-    if (m_pRandomDithers)
-      _aligned_free(m_pRandomDithers);
-    m_pRandomDithers = NULL;
-    m_ditherWidth = totalWidth;
-    m_ditherHeight = height;
-    m_ditherBits = bits;
-    m_pRandomDithers = (uint16_t *)_aligned_malloc(m_ditherWidth * m_ditherHeight * 2, 16);
+static CCritSec s_csDitherTables;
+static std::vector<RandomDitherTable *> s_DitherTables;
+static int s_nDitherTableUsers = 0;
+// The random number generator is not thread-safe
+static CCritSec s_csDitherGenerate;
 
+static void GenerateDitherTable(RandomDitherTable *table)
+{
 #ifdef DEBUG
-    LARGE_INTEGER frequency, start, end;
-    QueryPerformanceFrequency(&frequency);
-    QueryPerformanceCounter(&start);
-    DbgLog((LOG_TRACE, 10, L"Creating dither matrix"));
+  LARGE_INTEGER frequency, start, end;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+  DbgLog((LOG_TRACE, 10, L"Creating dither matrix (%d coefficients, %d bits)", table->size, table->bits));
 #endif
 
-    // Seed random number generator
-    time_t seed = time(NULL);
-    seed >>= 1;
-    srand_sse((unsigned int)seed);
-
-    bits = (1 << bits);
-    for (int i = 0; i < m_ditherHeight; i++) {
-      uint16_t *ditherline = m_pRandomDithers + (m_ditherWidth * i);
-      for (int j = 0; j < m_ditherWidth; j += 4) {
-        int rnds[4];
-        rand_sse(rnds);
-        ditherline[j+0] = rnds[0] % bits;
-        ditherline[j+1] = rnds[1] % bits;
-        ditherline[j+2] = rnds[2] % bits;
-        ditherline[j+3] = rnds[3] % bits;
-      }
-    }
+  CAutoLock lock(&s_csDitherGenerate);
+
+  // Seed random number generator
+  time_t seed = time(NULL);
+  seed >>= 1;
+  srand_sse((unsigned int)seed);
+
+  const int bits = (1 << table->bits);
+  for (int i = 0; i < table->size; i += 4) {
+    int rnds[4];
+    rand_sse(rnds);
+    table->data[i+0] = rnds[0] % bits;
+    table->data[i+1] = rnds[1] % bits;
+    table->data[i+2] = rnds[2] % bits;
+    table->data[i+3] = rnds[3] % bits;
+  }
+
+  // Publish the table only after all coefficients are written
+  InterlockedExchange(&table->ready, TRUE);
+
 #ifdef DEBUG
-    QueryPerformanceCounter(&end);
-    double diff = (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
-    DbgLog((LOG_TRACE, 10, L"Finished creating dither matrix (took %2.3fms)", diff));
+  QueryPerformanceCounter(&end);
+  double diff = (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+  DbgLog((LOG_TRACE, 10, L"Finished creating dither matrix (took %2.3fms)", diff));
 #endif
+}
+
+static void FreeDitherTable(RandomDitherTable *table)
+{
+  // Tables still being generated are finished first, nobody can wait for them anymore
+  if (table->thread.joinable())
+    table->thread.join();
+  _aligned_free(table->data);
+  delete table;
+}
+
+// Free the finished tables which are not used, and which a bigger table with the same bit depth replaces
+// Needs to be called with s_csDitherTables held
+static void PurgeDitherTables()
+{
+  for (size_t i = 0; i < s_DitherTables.size(); ) {
+    RandomDitherTable *table = s_DitherTables[i];
+    BOOL bReplaced = FALSE;
+    for (size_t j = 0; j < s_DitherTables.size() && !bReplaced; j++) {
+      const RandomDitherTable *other = s_DitherTables[j];
+      bReplaced = (other != table && other->ready && other->bits == table->bits && other->size >= table->size);
+    }
+    if (table->refs == 0 && table->ready && bReplaced) {
+      FreeDitherTable(table);
+      s_DitherTables.erase(s_DitherTables.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void CLAVPixFmtConverter::AcquireDitherTables()
+{
+  CAutoLock lock(&s_csDitherTables);
+  s_nDitherTableUsers++;
+}
+
+void CLAVPixFmtConverter::ReleaseDitherTables()
+{
+  std::vector<RandomDitherTable *> tables;
+  {
+    CAutoLock lock(&s_csDitherTables);
+    if (--s_nDitherTableUsers > 0)
+      return;
+    tables.swap(s_DitherTables);
+  }
+
+  for (size_t i = 0; i < tables.size(); i++)
+    FreeDitherTable(tables[i]);
+}
+
+void CLAVPixFmtConverter::ReleaseDitherTable(RandomDitherTable *table)
+{
+  if (!table)
+    return;
+
+  CAutoLock lock(&s_csDitherTables);
+  table->refs--;
+  PurgeDitherTables();
+}
+
+// Find a finished table for the given bit depth, with enough coefficients for lines of the given width
+// If there is none, the table is generated in the background, and NULL is returned until then
+// The returned table needs to be released with ReleaseDitherTable
+static RandomDitherTable *FindDitherTable(int width, int height, int bits)
+{
+  CAutoLock lock(&s_csDitherTables);
+
+  BOOL bPending = FALSE;
+  for (size_t i = 0; i < s_DitherTables.size(); i++) {
+    RandomDitherTable *table = s_DitherTables[i];
+    if (table->bits != bits || table->size < width * height)
+      continue;
+    if (table->ready) {
+      // The thread is done, or about to return
+      if (table->thread.joinable())
+        table->thread.join();
+      table->refs++;
+      // Smaller tables are not needed anymore once their users switched to this one
+      PurgeDitherTables();
+      return table;
+    }
+    bPending = TRUE;
+  }
+
+  if (!bPending) {
+    RandomDitherTable *table = new RandomDitherTable();
+    // Width classes of 32 coefficients cover all converters, height classes in steps of 512 lines cover SD,
+    // 1080p, 2160p and 4320p with few tables
+    table->size = FFALIGN(width, 32) * FFALIGN(height, 512);
+    table->bits = bits;
+    table->ready = FALSE;
+    table->refs = 0;
+    table->data = (uint16_t *)_aligned_malloc(table->size * 2, 16);
+    if (!table->data) {
+      delete table;
+      return NULL;
+    }
+    table->thread = std::thread(GenerateDitherTable, table);
+    s_DitherTables.push_back(table);
+  }
+
+  return NULL;
+}
+
+uint8_t* CLAVPixFmtConverter::AcquireScratchBuffer(size_t size)
+{
+  {
+    CAutoLock lock(&m_csScratch);
+    if (size != m_nScratchSize) {
+      // Buffers of the old size which are still in use are freed when they are released
+      for (size_t i = 0; i < m_ScratchBuffers.size(); i++)
+        av_free(m_ScratchBuffers[i]);
+      m_ScratchBuffers.clear();
+      m_nScratchSize = size;
+    }
+    if (!m_ScratchBuffers.empty()) {
+      uint8_t *buffer = m_ScratchBuffers.back();
+      m_ScratchBuffers.pop_back();
+      return buffer;
+    }
+  }
+
+  // Only happens for the first frames, or when more slices run at the same time than before
+  return (uint8_t *)av_mallocz(size);
+}
+
+void CLAVPixFmtConverter::ReleaseScratchBuffer(uint8_t *buffer, size_t size)
+{
+  if (!buffer)
+    return;
+
+  CAutoLock lock(&m_csScratch);
+  if (size == m_nScratchSize)
+    m_ScratchBuffers.push_back(buffer);
+  else
+    av_free(buffer);
+}
+
+const uint16_t* CLAVPixFmtConverter::GetRandomDitherCoeffs(int height, int coeffs, int bits, int line)
+{
+  if (m_pSettings->GetDitherMode() != LAVDither_Random)
+    return NULL;
 
+  CAutoLock lock(&m_csTables);
+
+  // The table is kept as long as this converter uses it, so it can be used again without looking it up
+  const int totalWidth = 8 * coeffs;
+  if (!m_pDitherTable || totalWidth * height > m_pDitherTable->size || bits != m_pDitherTable->bits) {
+    RandomDitherTable *table = FindDitherTable(totalWidth, height, bits);
+    // The converters fall back to ordered dithering until the table is ready
+    if (!table)
+      return NULL;
+    ReleaseDitherTable(m_pDitherTable);
+    m_pDitherTable = table;
   }
 
-  if (line < 0 || line >= m_ditherHeight)
-    line = rand() % m_ditherHeight;
+  // The lines have the width of this converter, independent of the width the table was created for
+  const int lines = m_pDitherTable->size / totalWidth;
+  if (line < 0 || line >= lines)
+    line = rand() % lines;
 
-  return &m_pRandomDithers[line * m_ditherWidth];
+  return &m_pDitherTable->data[line * totalWidth];
 }
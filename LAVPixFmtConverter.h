@@ -21,8 +21,17 @@
 
 #include "LAVVideoSettings.h"
 #include "decoders/ILAVDecoder.h"
+#include "LAVSwsCache.h"
 
-#define CONV_FUNC_PARAMS (const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int dstStride, int width, int height, LAVPixelFormat inputFormat, int bpp, LAVOutPixFmts outputFormat)
+#include <map>
+#include <vector>
+
+class CLAVThreadPool;
+struct RandomDitherTable;
+
+// Converters process the lines [sliceYStart, sliceYEnd) of the image
+// src and dst always point to the start of the full image, slice boundaries are a multiple of two lines
+#define CONV_FUNC_PARAMS (const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int dstStride, int width, int height, int sliceYStart, int sliceYEnd, LAVPixelFormat inputFormat, int bpp, LAVOutPixFmts outputFormat)
 
 #define DECLARE_CONV_FUNC(name) \
   HRESULT name CONV_FUNC_PARAMS
@@ -52,6 +61,17 @@ typedef struct _RGBCoeffs {
 
 extern LAVOutPixFmtDesc lav_pixfmt_desc[];
 
+// Instruction sets of the conversion functions, in ascending order
+typedef enum LAVPixConvISA {
+  LAVPixConvISA_C,
+  LAVPixConvISA_SSE2,
+  LAVPixConvISA_SSSE3,
+  LAVPixConvISA_AVX2,
+} LAVPixConvISA;
+
+// Environment variable to limit the instruction set of the converters, one of C, SSE2, SSSE3 or AVX2
+#define LAV_PIXCONV_ISA_ENV L"LAVVIDEO_PIXCONV_ISA"
+
 class CLAVPixFmtConverter
 {
 public:
@@ -59,6 +79,14 @@ public:
   ~CLAVPixFmtConverter();
 
   void SetSettings(ILAVVideoSettings *pSettings) { m_pSettings = pSettings; }
+  // Override the number of slices each frame is split into, 0 restores the default
+  // By default, the number of slices is chosen from the measured conversion time, separately for every format and resolution
+  // The slices run on the shared thread pool, so the size of the pool also limits the number of slices
+  void SetNumThreads(int nThreads);
+  // Limit the instruction set of the conversion functions, in addition to the CPU and LAV_PIXCONV_ISA_ENV
+  void SetMaxISA(LAVPixConvISA isa) { m_MaxISA = isa; DestroySWScale(); SelectConvertFunction(); }
+  // Best instruction set supported by the CPU, limited by LAV_PIXCONV_ISA_ENV
+  static LAVPixConvISA GetMaxISA();
 
   BOOL SetInputFmt(enum LAVPixelFormat pixfmt, int bpp) { if (m_InputPixFmt != pixfmt || m_InBpp != bpp) { m_InputPixFmt = pixfmt; m_InBpp = bpp; DestroySWScale(); SelectConvertFunction(); return TRUE; } return FALSE; }
   HRESULT SetOutputPixFmt(enum LAVOutPixFmts pix_fmt) { m_OutputPixFmt = pix_fmt; DestroySWScale(); SelectConvertFunction(); return S_OK; }
@@ -73,12 +101,18 @@ public:
   void GetMediaType(CMediaType *mt, int index, LONG biWidth, LONG biHeight, DWORD dwAspectX, DWORD dwAspectY, REFERENCE_TIME rtAvgTime, BOOL bInterlaced = TRUE, BOOL bVIH1 = FALSE);
   BOOL IsAllowedSubtype(const GUID *guid);
 
+  // A negative dstStride requests bottom-up output (packed formats only), dst then points to the first line of the image, which is the last line in memory
   inline HRESULT Convert(LAVFrame *pFrame, uint8_t *dst, int width, int height, int dstStride) {
+    ASSERT(dstStride > 0 || lav_pixfmt_desc[m_OutputPixFmt].planes == 0);
+    if (dstStride < 0 && !m_bNegativeStride)
+      return ConvertFlipped(pFrame, dst, width, height, dstStride);
+
     uint8_t *out = dst;
     int outStride = dstStride;
-    // Check if we have proper pixel alignment and the dst memory is actually aligned
-    if (m_RequiredAlignment && (FFALIGN(dstStride, m_RequiredAlignment) != dstStride || ((uintptr_t)dst % 16u))) {
-      outStride = FFALIGN(dstStride, m_RequiredAlignment);
+    const int absStride = abs(dstStride);
+    // Converters that cannot deal with arbitrary strides and pointers (only the swscale fallbacks) write into an aligned buffer first
+    if (m_RequiredAlignment && (FFALIGN(absStride, m_RequiredAlignment) != absStride || ((uintptr_t)dst % 16u))) {
+      outStride = FFALIGN(absStride, m_RequiredAlignment);
       size_t requiredSize = (outStride * height * lav_pixfmt_desc[m_OutputPixFmt].bpp) << 3;
       if (requiredSize > m_nAlignedBufferSize) {
         DbgLog((LOG_TRACE, 10, L"::Convert(): Conversion requires a bigger stride (need: %d, have: %d), allocating buffer...", outStride, dstStride));
@@ -88,7 +122,9 @@ public:
       }
       out = m_pAlignedBuffer;
     }
-    HRESULT hr = (this->*convert)(pFrame->data, pFrame->stride, out, outStride, width, height, m_InputPixFmt, m_InBpp, m_OutputPixFmt);
+    // Bounce buffers are read again right away, only the final output may bypass the cache
+    m_bStreamingStores = (out == dst) && UseStreamingStores(absStride, height);
+    HRESULT hr = ConvertSlices(pFrame->data, pFrame->stride, out, outStride, width, height);
     if (out != dst) {
       ChangeStride(out, outStride, dst, dstStride, width, height, m_OutputPixFmt);
     }
@@ -96,6 +132,13 @@ public:
   }
 
   BOOL IsRGBConverterActive() { return m_bRGBConverter; }
+  // Name and instruction set of the active conversion function
+  LPCWSTR GetConverterName() { return m_ConverterName; }
+
+  // Check if the frame can be delivered as-is instead of being converted
+  // The converter has to be a plain copy, and the frame buffer laid out exactly like the output (see LAV_FRAME_FLAG_BUFFER_CONTIGUOUS)
+  // pStride receives the stride of the output in pixels, pSize the size of the image in bytes
+  BOOL IsPassthroughPossible(const LAVFrame *pFrame, int height, int *pStride, long *pSize);
 
 private:
   AVPixelFormat GetFFInput() {
@@ -107,6 +150,18 @@ private:
 
   void SelectConvertFunction();
 
+  // Run the conversion function, split into horizontal bands on multiple threads if possible
+  HRESULT ConvertSlices(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int dstStride, int width, int height);
+  // Bottom-up output for conversion functions that can only write top-down
+  HRESULT ConvertFlipped(LAVFrame *pFrame, uint8_t *dst, int width, int height, int dstStride);
+  // Check if the output of a frame is too big for the cache, and should be written with non-temporal stores
+  BOOL UseStreamingStores(int stride, int height);
+  // Number of slices for the next frame, when the number of slices is chosen adaptively
+  int GetAdaptiveSlices(int width, int height, int maxSlices);
+  // Account the time the last frame took with the slice count returned by GetAdaptiveSlices
+  void UpdateAdaptiveSlices(double time);
+  void ProbeAdaptiveSlices(int dir);
+
   // Helper functions for convert_generic
   HRESULT swscale_scale(enum AVPixelFormat srcPix, enum AVPixelFormat dstPix, const uint8_t* const src[], const int srcStride[], BYTE *pOut, int width, int height, int stride, LAVOutPixFmtDesc pixFmtDesc, bool swapPlanes12 = false);
   HRESULT ConvertTo422Packed(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int width, int height, int dstStride);
@@ -117,7 +172,7 @@ private:
   HRESULT ConvertTov210(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int width, int height, int dstStride);
   HRESULT ConvertTov410(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int width, int height, int dstStride);
 
-  void DestroySWScale() { if (m_pSwsContext) sws_freeContext(m_pSwsContext); m_pSwsContext = NULL; if (m_rgbCoeffs) _aligned_free(m_rgbCoeffs); m_rgbCoeffs = NULL; if (m_pRandomDithers) _aligned_free(m_pRandomDithers); m_pRandomDithers = NULL; };
+  void DestroySWScale() { m_SwsContext.Release(); if (m_rgbCoeffs) _aligned_free(m_rgbCoeffs); m_rgbCoeffs = NULL; };
   SwsContext *GetSWSContext(int width, int height, enum AVPixelFormat srcPix, enum AVPixelFormat dstPix, int flags);
 
   void ChangeStride(const uint8_t* src, int srcStride, uint8_t *dst, int dstStride, int width, int height, LAVOutPixFmts format);
@@ -126,6 +181,32 @@ private:
 
   // Conversion function pointer
   ConverterFn convert;
+  // Conversion function can process individual slices
+  BOOL m_bSliceThreading;
+  // Conversion function can write with a negative stride
+  BOOL m_bNegativeStride;
+  // Conversion function only copies the planes, without changing their layout
+  BOOL m_bPassthrough;
+
+#define CONV_FLAG_RGB             0x1   ///< YUV to RGB conversion, which depends on the color properties
+#define CONV_FLAG_NEGATIVE_STRIDE 0x2   ///< Can write with a negative stride
+#define CONV_FLAG_NO_SLICES       0x4   ///< Can only process the whole image at once
+#define CONV_FLAG_PASSTHROUGH     0x8   ///< Only copies the planes, without changing their layout
+
+  // Entry in the registry of conversion functions
+  typedef struct {
+    LAVPixelFormat in;
+    int minBpp, maxBpp;
+    LAVOutPixFmts out;
+    LAVPixConvISA isa;
+    ConverterFn fn;
+    ConverterFn ditherLUT;    ///< table-driven version of the conversion, used if it is faster
+    DWORD flags;
+    unsigned alignment;       ///< required alignment of the output stride, 0 for none
+    LPCWSTR name;
+    LPCWSTR ditherLUTName;
+  } ConverterDesc;
+  static const ConverterDesc s_Converters[];
 
   // Pixel Implementations
   DECLARE_CONV_FUNC(convert_generic);
@@ -139,16 +220,57 @@ private:
   DECLARE_CONV_FUNC(convert_nv12_yv12);
   DECLARE_CONV_FUNC(convert_nv12_nv12);
   template <int uyvy> DECLARE_CONV_FUNC(convert_yuv420_yuy2);
+  template <int uyvy, int avx2> DECLARE_CONV_FUNC(convert_yuv420_yuy2_impl);
   template <int uyvy> DECLARE_CONV_FUNC(convert_yuv422_yuy2_uyvy);
   template <int uyvy> DECLARE_CONV_FUNC(convert_yuv422_yuy2_uyvy_dither_le);
   template <int nv12> DECLARE_CONV_FUNC(convert_yuv_yv_nv12_dither_le);
-
-  DECLARE_CONV_FUNC(convert_rgb48_rgb32_ssse3);
+  template <int nv12> DECLARE_CONV_FUNC(convert_yuv_px1x);
+  template <int v410> DECLARE_CONV_FUNC(convert_yuv444_x410);
+  DECLARE_CONV_FUNC(convert_yuv444_y416);
+  DECLARE_CONV_FUNC(convert_yuv_hbd_resample);
+
+  // LUT Implementations
+  DECLARE_CONV_FUNC(convert_yuv444_ayuv_dither_lut);
+  template <int uyvy> DECLARE_CONV_FUNC(convert_yuv422_yuy2_uyvy_dither_lut);
+  template <int nv12> DECLARE_CONV_FUNC(convert_yuv_yv_nv12_dither_lut);
+
+  // AVX2 Implementations
+  DECLARE_CONV_FUNC(convert_yuv420_px1x_le_avx2);
+  template <int nv12> DECLARE_CONV_FUNC(convert_yuv_yv_nv12_dither_le_avx2);
+  template <int out32> DECLARE_CONV_FUNC(convert_yuv_rgb_avx2);
+  template <int uyvy> DECLARE_CONV_FUNC(convert_yuv420_yuy2_avx2);
+
+  DECLARE_CONV_FUNC(convert_rgb8_rgb_ssse3);
+  template <int out32> DECLARE_CONV_FUNC(convert_rgb48_rgb_ssse3);
+
+  template <int nv12> DECLARE_CONV_FUNC(convert_yuy2_yv_nv12);
+  DECLARE_CONV_FUNC(convert_yuy2_uyvy);
+  DECLARE_CONV_FUNC(convert_yuy2_px1x);
+  DECLARE_CONV_FUNC(convert_yuy2_v210_ssse3);
+
+  template <int hbd> DECLARE_CONV_FUNC(convert_yuv422_v210_ssse3);
+  DECLARE_CONV_FUNC(convert_yuv422_v210_avx2);
+  DECLARE_CONV_FUNC(convert_yuv444_v410);
+  DECLARE_CONV_FUNC(convert_yuv444_v410_avx2);
   template <int out32> DECLARE_CONV_FUNC(convert_rgb48_rgb);
 
   template <int out32> DECLARE_CONV_FUNC(convert_yuv_rgb);
+  template <int out32, int avx2> DECLARE_CONV_FUNC(convert_yuv_rgb_impl);
   RGBCoeffs* getRGBCoeffs(int width, int height);
+  // Random dithering coefficients, NULL if random dithering is not active or the shared table is not ready yet
   const uint16_t* GetRandomDitherCoeffs(int height, int coeffs, int bits, int line);
+  static void AcquireDitherTables();
+  static void ReleaseDitherTables();
+  // Stop using a table returned by FindDitherTable
+  static void ReleaseDitherTable(RandomDitherTable *table);
+  // Scratch memory for a conversion function, every slice running at the same time gets its own buffer
+  // Buffers are zeroed when allocated, and kept for the next frame as long as the requested size stays the same
+  uint8_t* AcquireScratchBuffer(size_t size);
+  void ReleaseScratchBuffer(uint8_t *buffer, size_t size);
+  // Table for ordered dithering of bpp-bit samples to 8-bit, NULL if random dithering is active or bpp is not supported
+  const uint8_t* GetDitherLUT(int bpp);
+  // Use the table-driven version of the current dithering converter instead, if it is faster on this machine
+  BOOL SelectDitherLUT(ConverterFn lutFn);
 
 private:
   LAVPixelFormat  m_InputPixFmt;
@@ -162,20 +284,62 @@ private:
 
   unsigned m_RequiredAlignment;
 
-  SwsContext *m_pSwsContext;
+  // Taken from the shared cache, and put back by DestroySWScale
+  CLAVSwsContext m_SwsContext;
 
   size_t   m_nAlignedBufferSize;
   uint8_t *m_pAlignedBuffer;
 
+  // Scratch buffers which are not in use, all of m_nScratchSize bytes
+  CCritSec m_csScratch;
+  size_t   m_nScratchSize;
+  std::vector<uint8_t *> m_ScratchBuffers;
+
   int m_NumThreads;
+  CLAVThreadPool *m_pThreadPool;
+
+  // Adaptive number of slices, see GetAdaptiveSlices
+  // Slice counts are tried in steps of two around the best known count, and only replace it if they are clearly faster,
+  // or not noticeably slower with fewer threads.
+  enum AdaptState { ADAPT_MEASURE, ADAPT_PROBE_UP, ADAPT_PROBE_DOWN, ADAPT_SETTLED };
+  // Measurements of one conversion and frame size
+  typedef struct {
+    AdaptState state;
+    int nSlices;            // slice count currently measured
+    int nBestSlices;        // best known slice count
+    double bestTime;        // average time of a frame with nBestSlices
+    BOOL bProbeUpWon;       // a higher slice count was better, no need to try lower ones
+    int nSkip;              // frames to leave out of the measurement
+    int nSamples;           // frames in the current measurement window
+    double timeSum;         // total time of the frames in the current measurement window
+    int nWindows;           // measurement windows since the last probing
+  } AdaptiveSlices;
+  BOOL m_bAdaptiveSlices;
+  int m_nMaxSlices;
+  // Measurements of the recently used conversions and frame sizes, so that streams switching between them keep their results
+  std::map<LONGLONG, AdaptiveSlices> m_AdaptStates;
+  LONGLONG m_AdaptKey;      // conversion and frame size of m_pAdapt
+  AdaptiveSlices *m_pAdapt; // measurements of the current frame, NULL if none
+
+  // Protects the lazily initialized coefficient tables, which are shared by all slices
+  CCritSec m_csTables;
 
   ILAVVideoSettings *m_pSettings;
 
   RGBCoeffs *m_rgbCoeffs;
   BOOL m_bRGBConverter;
 
-  uint16_t *m_pRandomDithers;
-  int m_ditherWidth;
-  int m_ditherHeight;
-  int m_ditherBits;
+  // Shared random dithering table last used by this converter
+  RandomDitherTable *m_pDitherTable;
+
+  uint8_t *m_pDitherLUT;
+  int m_DitherLUTBpp;
+  // Arithmetic converter used by the LUT converters for random dithering
+  ConverterFn m_DitherLUTFallback;
+
+  LPCWSTR m_ConverterName;
+  LAVPixConvISA m_MaxISA;
+
+  // Write the output with non-temporal stores, selected for every frame
+  BOOL m_bStreamingStores;
 };
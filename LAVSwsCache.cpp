@@ -0,0 +1,167 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVSwsCache.h"
+#include "LAVPixFmtConverter.h"
+
+#include <list>
+
+// Number of swscale contexts kept around, not counting the ones in use
+#define SWS_CACHE_SIZE 8
+// Number of coefficient sets kept around
+#define RGB_CACHE_SIZE 16
+
+struct SwsCacheEntry {
+  LAVSwsKey key;
+  SwsContext *pContext;
+};
+
+struct RGBCacheEntry {
+  int matrix;
+  BOOL inFullRange;
+  BOOL outFullRange;
+  // List nodes are not guaranteed to be aligned for SSE
+  BYTE coeffs[sizeof(RGBCoeffs)];
+};
+
+// Most recently used entries first
+static CCritSec s_csSwsCache;
+static std::list<SwsCacheEntry> s_SwsCache;
+static std::list<RGBCacheEntry> s_RGBCache;
+static int s_nSwsCacheRefs = 0;
+
+void CLAVSwsCache::AcquireShared()
+{
+  CAutoLock lock(&s_csSwsCache);
+  s_nSwsCacheRefs++;
+}
+
+void CLAVSwsCache::ReleaseShared()
+{
+  std::list<SwsCacheEntry> contexts;
+  {
+    CAutoLock lock(&s_csSwsCache);
+    ASSERT(s_nSwsCacheRefs > 0);
+    if (--s_nSwsCacheRefs > 0)
+      return;
+    contexts.swap(s_SwsCache);
+    s_RGBCache.clear();
+  }
+
+  // Contexts still in use are freed when they are returned
+  for (std::list<SwsCacheEntry>::iterator it = contexts.begin(); it != contexts.end(); it++)
+    sws_freeContext(it->pContext);
+}
+
+SwsContext *CLAVSwsCache::Acquire(const LAVSwsKey &key, BOOL *pbNew)
+{
+  {
+    CAutoLock lock(&s_csSwsCache);
+    for (std::list<SwsCacheEntry>::iterator it = s_SwsCache.begin(); it != s_SwsCache.end(); it++) {
+      if (it->key == key) {
+        SwsContext *pContext = it->pContext;
+        s_SwsCache.erase(it);
+        if (pbNew)
+          *pbNew = FALSE;
+        return pContext;
+      }
+    }
+  }
+
+  // Creating a context takes a while, don't block the other users of the cache
+  DbgLog((LOG_TRACE, 10, L"CLAVSwsCache::Acquire(): Creating context for %dx%d (%d) -> %dx%d (%d)", key.srcWidth, key.srcHeight, key.srcPix, key.dstWidth, key.dstHeight, key.dstPix));
+  if (pbNew)
+    *pbNew = TRUE;
+  return sws_getContext(key.srcWidth, key.srcHeight, key.srcPix, key.dstWidth, key.dstHeight, key.dstPix, key.flags, NULL, NULL, NULL);
+}
+
+void CLAVSwsCache::Return(SwsContext *pContext, const LAVSwsKey &key)
+{
+  if (!pContext)
+    return;
+
+  SwsContext *pEvicted = NULL;
+  {
+    CAutoLock lock(&s_csSwsCache);
+    if (s_nSwsCacheRefs > 0) {
+      SwsCacheEntry entry = { key, pContext };
+      s_SwsCache.push_front(entry);
+      if (s_SwsCache.size() > SWS_CACHE_SIZE) {
+        pEvicted = s_SwsCache.back().pContext;
+        s_SwsCache.pop_back();
+      }
+    } else {
+      pEvicted = pContext;
+    }
+  }
+
+  if (pEvicted)
+    sws_freeContext(pEvicted);
+}
+
+BOOL CLAVSwsCache::FindRGBCoeffs(int matrix, BOOL inFullRange, BOOL outFullRange, RGBCoeffs *pCoeffs)
+{
+  CAutoLock lock(&s_csSwsCache);
+  for (std::list<RGBCacheEntry>::iterator it = s_RGBCache.begin(); it != s_RGBCache.end(); it++) {
+    if (it->matrix == matrix && it->inFullRange == inFullRange && it->outFullRange == outFullRange) {
+      memcpy(pCoeffs, it->coeffs, sizeof(RGBCoeffs));
+      s_RGBCache.splice(s_RGBCache.begin(), s_RGBCache, it);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+void CLAVSwsCache::StoreRGBCoeffs(int matrix, BOOL inFullRange, BOOL outFullRange, const RGBCoeffs *pCoeffs)
+{
+  CAutoLock lock(&s_csSwsCache);
+  if (s_nSwsCacheRefs == 0)
+    return;
+
+  RGBCacheEntry entry;
+  entry.matrix = matrix;
+  entry.inFullRange = inFullRange;
+  entry.outFullRange = outFullRange;
+  memcpy(entry.coeffs, pCoeffs, sizeof(RGBCoeffs));
+  s_RGBCache.push_front(entry);
+  if (s_RGBCache.size() > RGB_CACHE_SIZE)
+    s_RGBCache.pop_back();
+}
+
+SwsContext *CLAVSwsContext::Get(const LAVSwsKey &key, BOOL *pbNew)
+{
+  if (m_pContext && m_Key == key) {
+    if (pbNew)
+      *pbNew = FALSE;
+    return m_pContext;
+  }
+
+  Release();
+  m_pContext = CLAVSwsCache::Acquire(key, pbNew);
+  if (m_pContext)
+    m_Key = key;
+  return m_pContext;
+}
+
+void CLAVSwsContext::Release()
+{
+  CLAVSwsCache::Return(m_pContext, m_Key);
+  m_pContext = NULL;
+}
@@ -0,0 +1,89 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+struct _RGBCoeffs;
+
+// Parameters of a swscale context
+// matrix and range describe the color space details the owner sets up with sws_setColorspaceDetails, -1 if it keeps the defaults
+struct LAVSwsKey {
+  LAVSwsKey(int srcW, int srcH, AVPixelFormat srcFmt, int dstW, int dstH, AVPixelFormat dstFmt, int swsFlags, int colorMatrix = -1, int colorRange = -1)
+    : srcWidth(srcW), srcHeight(srcH), srcPix(srcFmt), dstWidth(dstW), dstHeight(dstH), dstPix(dstFmt), flags(swsFlags), matrix(colorMatrix), range(colorRange) {}
+
+  bool operator==(const LAVSwsKey &o) const {
+    return srcWidth == o.srcWidth && srcHeight == o.srcHeight && srcPix == o.srcPix && dstWidth == o.dstWidth && dstHeight == o.dstHeight
+        && dstPix == o.dstPix && flags == o.flags && matrix == o.matrix && range == o.range;
+  }
+
+  int srcWidth, srcHeight;
+  AVPixelFormat srcPix;
+  int dstWidth, dstHeight;
+  AVPixelFormat dstPix;
+  int flags;
+  int matrix;
+  int range;
+};
+
+// Cache of swscale contexts and YUV->RGB coefficients, shared by all converters in the process
+// Streams that switch back and forth between formats (e.g. at ad-insertion splices) find their contexts again
+// instead of creating them from scratch. The least recently used entries are dropped when the cache is full.
+//
+// swscale contexts cannot be used by two threads at once, so a context is taken out of the cache while it is in use,
+// see CLAVSwsContext.
+//
+// The cache exists as long as a filter instance holds a reference, without one every context is freed as soon as it
+// is returned, and no coefficients are kept.
+class CLAVSwsCache
+{
+public:
+  // Every call needs to be matched with a ReleaseShared() call, the cache is emptied with the last reference
+  static void AcquireShared();
+  static void ReleaseShared();
+
+  // Take a context out of the cache, or create a new one
+  // pbNew is set if the context was just created, and the color space details still need to be set up
+  static SwsContext *Acquire(const LAVSwsKey &key, BOOL *pbNew);
+  // Put a context back into the cache
+  static void Return(SwsContext *pContext, const LAVSwsKey &key);
+
+  // Coefficients of the YUV->RGB converters, by matrix and input/output range
+  static BOOL FindRGBCoeffs(int matrix, BOOL inFullRange, BOOL outFullRange, struct _RGBCoeffs *pCoeffs);
+  static void StoreRGBCoeffs(int matrix, BOOL inFullRange, BOOL outFullRange, const struct _RGBCoeffs *pCoeffs);
+};
+
+// A swscale context from the shared cache, owned exclusively until it is released or another one is requested
+class CLAVSwsContext
+{
+public:
+  CLAVSwsContext() : m_pContext(NULL), m_Key(0, 0, AV_PIX_FMT_NONE, 0, 0, AV_PIX_FMT_NONE, 0) {}
+  ~CLAVSwsContext() { Release(); }
+
+  // Get a context for the parameters, like sws_getCachedContext
+  // The context held so far goes back into the cache if it does not match
+  SwsContext *Get(const LAVSwsKey &key, BOOL *pbNew = NULL);
+  // Give the context back to the cache
+  void Release();
+
+  operator SwsContext *() const { return m_pContext; }
+
+private:
+  SwsContext *m_pContext;
+  LAVSwsKey m_Key;
+};
@@ -0,0 +1,152 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVThreadPool.h"
+
+#include <algorithm>
+
+static std::mutex s_SharedMutex;
+static CLAVThreadPool *s_pSharedPool = NULL;
+static int s_nSharedRefs = 0;
+static int s_nSharedSize = 0;
+
+CLAVThreadPool *CLAVThreadPool::GetShared()
+{
+  std::lock_guard<std::mutex> lock(s_SharedMutex);
+  if (!s_pSharedPool)
+    s_pSharedPool = new CLAVThreadPool(s_nSharedSize);
+  s_nSharedRefs++;
+  return s_pSharedPool;
+}
+
+void CLAVThreadPool::ReleaseShared()
+{
+  std::lock_guard<std::mutex> lock(s_SharedMutex);
+  ASSERT(s_nSharedRefs > 0);
+  // The threads are stopped with the last user, and not when the DLL is unloaded, where they could not be joined
+  if (--s_nSharedRefs == 0)
+    SAFE_DELETE(s_pSharedPool);
+}
+
+void CLAVThreadPool::SetSharedSize(int nThreads)
+{
+  std::lock_guard<std::mutex> lock(s_SharedMutex);
+  s_nSharedSize = nThreads;
+  if (s_pSharedPool)
+    s_pSharedPool->SetNumThreads(nThreads);
+}
+
+CLAVThreadPool::CLAVThreadPool(int nThreads)
+  : m_nActiveWorkers(0)
+  , m_nNextBatch(0)
+  , m_bExit(false)
+{
+  SetNumThreads(nThreads);
+}
+
+CLAVThreadPool::~CLAVThreadPool()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    ASSERT(m_Batches.empty());
+    m_bExit = true;
+  }
+  m_cvWork.notify_all();
+
+  for (size_t i = 0; i < m_Threads.size(); i++) {
+    m_Threads[i].join();
+  }
+}
+
+int CLAVThreadPool::GetNumThreads()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  return m_nActiveWorkers + 1;
+}
+
+void CLAVThreadPool::SetNumThreads(int nThreads)
+{
+  if (nThreads <= 0)
+    nThreads = av_cpu_count();
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  // The calling thread of Execute always participates, so use one worker less
+  m_nActiveWorkers = max(nThreads - 1, 0);
+  for (int i = (int)m_Threads.size(); i < m_nActiveWorkers; i++) {
+    m_Threads.push_back(std::thread(&CLAVThreadPool::WorkerProc, this, i));
+  }
+  m_cvWork.notify_all();
+
+  DbgLog((LOG_TRACE, 10, L"CLAVThreadPool::SetNumThreads(): Using %d threads", m_nActiveWorkers + 1));
+}
+
+void CLAVThreadPool::RunJob(std::unique_lock<std::mutex> &lock, Batch *pBatch)
+{
+  int job = pBatch->nNextJob++;
+
+  // Once all jobs are claimed, only the owner still needs the batch, to wait for it
+  if (pBatch->nNextJob == pBatch->nJobs)
+    m_Batches.erase(std::find(m_Batches.begin(), m_Batches.end(), pBatch));
+
+  lock.unlock();
+  (*pBatch->pJob)(job);
+  lock.lock();
+
+  if (--pBatch->nPending == 0)
+    m_cvDone.notify_all();
+}
+
+void CLAVThreadPool::WorkerProc(int index)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  for (;;) {
+    m_cvWork.wait(lock, [this, index]() { return m_bExit || (index < m_nActiveWorkers && !m_Batches.empty()); });
+    if (m_bExit)
+      break;
+    // Take turns between the batches of different callers
+    Batch *pBatch = m_Batches[m_nNextBatch++ % m_Batches.size()];
+    RunJob(lock, pBatch);
+  }
+}
+
+void CLAVThreadPool::Execute(int nJobs, const JobFn &fn)
+{
+  if (nJobs <= 0)
+    return;
+
+  // No point in waking up the workers for a single job
+  if (nJobs == 1) {
+    fn(0);
+    return;
+  }
+
+  Batch batch = { &fn, nJobs, 0, nJobs };
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_Batches.push_back(&batch);
+  m_cvWork.notify_all();
+
+  // Help out until all jobs are claimed
+  while (batch.nNextJob < batch.nJobs)
+    RunJob(lock, &batch);
+
+  m_cvDone.wait(lock, [&batch]() { return batch.nPending == 0; });
+}
@@ -0,0 +1,87 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fork/join thread pool
+// Execute() runs a number of independent jobs on the worker threads and the calling thread,
+// and only returns once all of them are finished.
+//
+// One pool is shared by all filter instances in the process (see GetShared), so that many instances do not each
+// spawn their own threads. Batches from concurrent callers are interleaved: the idle workers take one job from
+// each pending batch in turn, while every caller works on its own batch.
+class CLAVThreadPool
+{
+public:
+  typedef std::function<void(int)> JobFn;
+
+  CLAVThreadPool(int nThreads);
+  ~CLAVThreadPool();
+
+  // Get a reference to the shared pool, which is created on first use
+  // Every call needs to be matched with a ReleaseShared() call
+  static CLAVThreadPool *GetShared();
+  static void ReleaseShared();
+
+  // Set the number of threads of the shared pool, including the calling thread
+  // 0 = one thread per CPU core
+  static void SetSharedSize(int nThreads);
+
+  // Number of threads working on a batch, including the calling thread
+  int GetNumThreads();
+
+  // Change the number of threads, including the calling thread
+  // 0 = one thread per CPU core
+  void SetNumThreads(int nThreads);
+
+  // Run fn(0) .. fn(nJobs-1), and wait for all of them to finish
+  void Execute(int nJobs, const JobFn &fn);
+
+private:
+  struct Batch {
+    const JobFn *pJob;
+    int nJobs;
+    int nNextJob;
+    int nPending;
+  };
+
+  void WorkerProc(int index);
+  void RunJob(std::unique_lock<std::mutex> &lock, Batch *pBatch);
+
+private:
+  std::vector<std::thread> m_Threads;
+
+  // Workers with a higher index wait until the pool is enlarged again
+  int m_nActiveWorkers;
+
+  std::mutex m_Mutex;
+  std::condition_variable m_cvWork;
+  std::condition_variable m_cvDone;
+
+  // Batches with jobs which are not claimed yet, in the order of submission
+  std::vector<Batch *> m_Batches;
+  size_t m_nNextBatch;
+  bool m_bExit;
+};
@@ -25,6 +25,8 @@
 
 #include "VideoInputPin.h"
 #include "VideoOutputPin.h"
+#include "LAVFrameAllocator.h"
+#include "LAVThreadPool.h"
 
 #include "moreuuids.h"
 #include "registry.h"
@@ -71,13 +73,16 @@ const int MAX_SUP_PLAYERS	= 10;
 CLAVVideo::CLAVVideo(LPUNKNOWN pUnk, HRESULT* phr)
   : CTransformFilter(NAME("LAV Video Decoder"), 0, __uuidof(CLAVVideo))
   , m_Decoder(this)
+  , m_Deliver(this)
   , m_rtPrevStart(0)
   , m_rtPrevStop(0)
   , m_bRuntimeConfig(/*FALSE*/TRUE)
   , m_bForceInputAR(FALSE)
   , m_bSendMediaType(FALSE)
+  , m_ZeroCopyRejectedStride(0)
   , m_bDXVAExtFormatSupport(-1)
   , m_dwDecodeFlags(0)
+  , m_pThreadPool(NULL)
   , m_pFilterGraph(NULL)
   , m_pFilterBufferSrc(NULL)
   , m_pFilterBufferSink(NULL)
@@ -113,6 +118,13 @@ CLAVVideo::CLAVVideo(LPUNKNOWN pUnk, HRESULT* phr)
 
   LoadSettings();
 
+  // The size of the shared thread pool is only changed when configured, so instances with the default settings keep the size set through another instance
+  if (m_settings.ThreadPoolSize)
+    CLAVThreadPool::SetSharedSize(m_settings.ThreadPoolSize);
+  m_pThreadPool = CLAVThreadPool::GetShared();
+  AcquireLAVFrameBufferPools();
+  CLAVSwsCache::AcquireShared();
+
   m_PixFmtConverter.SetSettings(this);
 
   m_ControlThread = new CLAVControlThread(this);
@@ -191,6 +203,10 @@ CLAVVideo::~CLAVVideo()
   SafeRelease(&m_SubtitleConsumer);
 
   SAFE_DELETE(m_pSubtitleInput);
+
+  CLAVThreadPool::ReleaseShared();
+  ReleaseLAVFrameBufferPools();
+  CLAVSwsCache::ReleaseShared();
 }
 
 HRESULT CLAVVideo::CreateTrayIcon()
@@ -237,6 +253,10 @@ HRESULT CLAVVideo::LoadDefaults()
 
   m_settings.bDVDVideo  = TRUE;
   m_settings.bMSWMV9DMO = TRUE;
+  m_settings.bZeroCopyOutput = FALSE;
+  m_settings.ThreadPoolSize = 0;
+  m_settings.bRGBPremultiplyAlpha = FALSE;
+  m_settings.InputQueueDepth = 4;
 
   // Raw formats, off by default
   m_settings.bFormats[Codec_v210]     = FALSE;
@@ -332,6 +352,18 @@ HRESULT CLAVVideo::ReadSettings(HKEY rootKey)
 
     bFlag = reg.ReadBOOL(L"MSWMV9DMO", hr);
     if (SUCCEEDED(hr)) m_settings.bMSWMV9DMO = bFlag;
+
+    bFlag = reg.ReadBOOL(L"ZeroCopyOutput", hr);
+    if (SUCCEEDED(hr)) m_settings.bZeroCopyOutput = bFlag;
+
+    dwVal = reg.ReadDWORD(L"ThreadPoolSize", hr);
+    if (SUCCEEDED(hr)) m_settings.ThreadPoolSize = dwVal;
+
+    bFlag = reg.ReadBOOL(L"RGBPremultiplyAlpha", hr);
+    if (SUCCEEDED(hr)) m_settings.bRGBPremultiplyAlpha = bFlag;
+
+    dwVal = reg.ReadDWORD(L"InputQueueDepth", hr);
+    if (SUCCEEDED(hr) && dwVal >= 1 && dwVal <= 64) m_settings.InputQueueDepth = dwVal;
   }
 
   CRegistry regF = CRegistry(rootKey, LAVC_VIDEO_REGISTRY_KEY_FORMATS, hr, TRUE);
@@ -416,6 +448,10 @@ HRESULT CLAVVideo::SaveSettings()
 
     reg.WriteBOOL(L"DVDVideo", m_settings.bDVDVideo);
     reg.WriteBOOL(L"MSWMV9DMO", m_settings.bMSWMV9DMO);
+    reg.WriteBOOL(L"ZeroCopyOutput", m_settings.bZeroCopyOutput);
+    reg.WriteDWORD(L"ThreadPoolSize", m_settings.ThreadPoolSize);
+    reg.WriteBOOL(L"RGBPremultiplyAlpha", m_settings.bRGBPremultiplyAlpha);
+    reg.WriteDWORD(L"InputQueueDepth", m_settings.InputQueueDepth);
 
     CreateRegistryKey(HKEY_CURRENT_USER, LAVC_VIDEO_REGISTRY_KEY_OUTPUT);
     CRegistry regP = CRegistry(HKEY_CURRENT_USER, LAVC_VIDEO_REGISTRY_KEY_OUTPUT, hr);
@@ -579,12 +615,16 @@ HRESULT CLAVVideo::DecideBufferSize(IMemAllocator* pAllocator, ALLOCATOR_PROPERT
   videoFormatTypeHandler(mtOut, &pBIH);
 
   long downstreamBuffers = pProperties->cBuffers;
-  pProperties->cBuffers = max(pProperties->cBuffers, 2) + m_Decoder.GetBufferCount();
+  // Samples waiting in the delivery queue are not available for the next frame
+  pProperties->cBuffers = max(pProperties->cBuffers, 2) + m_Decoder.GetBufferCount() + CDeliverThread::QUEUE_DEPTH;
   pProperties->cbBuffer = pBIH ? pBIH->biSizeImage : 3110400;
+  // Leave room for wider strides, so frames with the usual decoder or surface alignment can be passed through (see AttachFrameToSample)
+  if (m_settings.bZeroCopyOutput && pBIH)
+    pProperties->cbBuffer = max(pProperties->cbBuffer, (long)(FFALIGN(pBIH->biWidth, 256) * abs(pBIH->biHeight) * pBIH->biBitCount >> 3));
   pProperties->cbAlign  = 1;
   pProperties->cbPrefix = 0;
 
-  DbgLog((LOG_TRACE, 10, L" -> Downstream wants %d buffers, decoder wants %d, for a total of: %d", downstreamBuffers, m_Decoder.GetBufferCount(), pProperties->cBuffers));
+  DbgLog((LOG_TRACE, 10, L" -> Downstream wants %d buffers, decoder wants %d, delivery queue holds %d, for a total of: %d", downstreamBuffers, m_Decoder.GetBufferCount(), CDeliverThread::QUEUE_DEPTH, pProperties->cBuffers));
 
   HRESULT hr;
   ALLOCATOR_PROPERTIES Actual;
@@ -779,6 +819,9 @@ HRESULT CLAVVideo::EndOfStream()
   m_Decoder.EndOfStream();
   Filter(GetFlushFrame());
 
+  // Deliver all queued frames before the EOS
+  m_Deliver.WaitForIdle();
+
   DbgLog((LOG_TRACE, 1, L"EndOfStream finished, decoder flushed"));
   return __super::EndOfStream();
 }
@@ -787,7 +830,12 @@ HRESULT CLAVVideo::BeginFlush()
 {
   DbgLog((LOG_TRACE, 1, L"::BeginFlush"));
   m_bFlushing = TRUE;
-  return __super::BeginFlush();
+  HRESULT hr = __super::BeginFlush();
+
+  // Downstream is flushing now, so any delivery in progress returns, and the queued samples can be dropped
+  m_Deliver.Flush();
+
+  return hr;
 }
 
 HRESULT CLAVVideo::EndFlush()
@@ -797,6 +845,10 @@ HRESULT CLAVVideo::EndFlush()
 
   ReleaseLastSequenceFrame();
 
+  // Drop samples which were queued while BeginFlush was running
+  m_Deliver.Flush();
+  InterlockedExchange(&m_hrDeliver, S_OK);
+
   if (m_dwDecodeFlags & LAV_VIDEO_DEC_FLAG_DVD) {
     PerformFlush();
   }
@@ -844,9 +896,23 @@ HRESULT CLAVVideo::NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, doubl
 
   PerformFlush();
 
+  // Samples of the old segment need to be delivered first
+  m_Deliver.WaitForIdle();
+
   return __super::NewSegment(tStart, tStop, dRate);
 }
 
+HRESULT CLAVVideo::StopStreaming()
+{
+  DbgLog((LOG_TRACE, 1, L"::StopStreaming"));
+
+  // Downstream is already stopped, drop anything that is still queued
+  m_Deliver.Flush();
+  InterlockedExchange(&m_hrDeliver, S_OK);
+
+  return __super::StopStreaming();
+}
+
 HRESULT CLAVVideo::CheckConnect(PIN_DIRECTION dir, IPin *pPin)
 {
   if (dir == PINDIR_INPUT) {
@@ -1035,6 +1101,9 @@ HRESULT CLAVVideo::ReconnectOutput(int width, int height, AVRational ar, DXVA2_E
 
   if (bNeedReconnect) {
     DbgLog((LOG_TRACE, 10, L"::ReconnectOutput(): Performing reconnect"));
+    // Queued samples still carry the old format
+    m_Deliver.WaitForIdle();
+    m_ZeroCopyRejectedStride = 0;
     BITMAPINFOHEADER *pBIH = NULL;
     if (mt.formattype == FORMAT_VideoInfo) {
       VIDEOINFOHEADER *vih = (VIDEOINFOHEADER *)mt.Format();
@@ -1183,6 +1252,9 @@ HRESULT CLAVVideo::NegotiatePixelFormat(CMediaType &outMt, int width, int height
 {
   DbgLog((LOG_TRACE, 10, L"::NegotiatePixelFormat()"));
 
+  // Queued samples still carry the old format
+  m_Deliver.WaitForIdle();
+
   HRESULT hr = S_OK;
   int i = 0;
   int timeout = 100;
@@ -1233,6 +1305,7 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
 
   AM_SAMPLE2_PROPERTIES const *pProps = m_pInput->SampleProps();
   if(pProps->dwStreamId != AM_STREAM_MEDIA) {
+    m_Deliver.WaitForIdle();
     return m_pOutput->Deliver(pIn);
   }
 
@@ -1251,8 +1324,6 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
     }
   }
 
-  m_hrDeliver = S_OK;
-
   // Skip over empty packets
   if (pIn->GetActualDataLength() == 0) {
     return S_OK;
@@ -1262,8 +1333,10 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
   if (FAILED(hr))
     return hr;
 
-  if (FAILED(m_hrDeliver))
-    return m_hrDeliver;
+  // Delivery failures are reported by the delivery thread, and stay until the next flush or stop
+  HRESULT hrDeliver = m_hrDeliver;
+  if (FAILED(hrDeliver))
+    return hrDeliver;
 
   return S_OK;
 }
@@ -1273,14 +1346,12 @@ STDMETHODIMP CLAVVideo::AllocateFrame(LAVFrame **ppFrame)
 {
   CheckPointer(ppFrame, E_POINTER);
 
-  *ppFrame = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+  // Frames from the pool are already cleared
+  *ppFrame = m_FramePool.Acquire();
   if (!*ppFrame) {
     return E_OUTOFMEMORY;
   }
 
-  // Initialize with zero
-  ZeroMemory(*ppFrame, sizeof(LAVFrame));
-
   // Set some defaults
   (*ppFrame)->bpp = 8;
   (*ppFrame)->rtStart = AV_NOPTS_VALUE;
@@ -1298,7 +1369,8 @@ STDMETHODIMP CLAVVideo::ReleaseFrame(LAVFrame **ppFrame)
   // Allow *ppFrame to be NULL already
   if (*ppFrame) {
     FreeLAVFrameBuffers(*ppFrame);
-    SAFE_CO_FREE(*ppFrame);
+    m_FramePool.Recycle(*ppFrame);
+    *ppFrame = NULL;
   }
   return S_OK;
 }
@@ -1477,6 +1549,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
   // Grab a media sample, and start assembling the data for it.
   IMediaSample *pSampleOut = NULL;
   BYTE         *pDataOut   = NULL;
+  BOOL          bZeroCopy  = FALSE;
 
   REFERENCE_TIME avgDuration = pFrame->avgFrameDuration;
   if (avgDuration == 0)
@@ -1495,13 +1568,17 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
       ReleaseFrame(&pFrame);
       return hr;
     }
+
+    // Hand the frame buffer to the renderer instead of copying it, if it is already in the output format
+    if (m_settings.bZeroCopyOutput)
+      bZeroCopy = (AttachFrameToSample(pSampleOut, pFrame, height) == S_OK);
   }
 
   CMediaType& mt = m_pOutput->CurrentMediaType();
   BITMAPINFOHEADER *pBIH = NULL;
   videoFormatTypeHandler(mt.Format(), mt.FormatType(), &pBIH);
 
-  if (pFrame->format != LAVPixFmt_DXVA2) {
+  if (pFrame->format != LAVPixFmt_DXVA2 && !bZeroCopy) {
     long required = pBIH->biSizeImage;
 
     long lSampleSize = pSampleOut->GetSize();
@@ -1512,12 +1589,21 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
       return E_FAIL;
     }
 
+    // Bottom-up RGB is written in its final order directly by the converter, using a negative stride
+    BYTE *pConvertOut = pDataOut;
+    int convertStride = pBIH->biWidth;
+    if ((mt.subtype == MEDIASUBTYPE_RGB32 || mt.subtype == MEDIASUBTYPE_RGB24) && pBIH->biHeight > 0) {
+      int bpp = (mt.subtype == MEDIASUBTYPE_RGB32) ? 4 : 3;
+      pConvertOut += (ptrdiff_t)pBIH->biWidth * bpp * (height - 1);
+      convertStride = -convertStride;
+    }
+
   #if defined(DEBUG) && DEBUG_PIXELCONV_TIMINGS
     LARGE_INTEGER frequency, start, end;
     QueryPerformanceFrequency(&frequency);
     QueryPerformanceCounter(&start);
   #endif
-    m_PixFmtConverter.Convert(pFrame, pDataOut, width, height, pBIH->biWidth);
+    m_PixFmtConverter.Convert(pFrame, pConvertOut, width, height, convertStride);
   #if defined(DEBUG) && DEBUG_PIXELCONV_TIMINGS
     QueryPerformanceCounter(&end);
     double diff = (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
@@ -1532,7 +1618,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
 
     // .. and if we do RGB conversion, blend after the conversion, for improved quality
     if (bRGBOut && m_SubtitleConsumer && m_SubtitleConsumer->HasProvider()) {
-      int strideBytes = pBIH->biWidth;
+      int strideBytes = convertStride;
       LAVPixelFormat pixFmt;
       if (m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB32) {
         pixFmt = LAVPixFmt_RGB32;
@@ -1544,18 +1630,13 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
 
       // We need to supply a LAV Frame to the subtitle API
       // So update it with the appropriate settings
-      pFrame->data[0]   = pDataOut;
+      pFrame->data[0]   = pConvertOut;
       pFrame->stride[0] = strideBytes;
       pFrame->format    = pixFmt;
       pFrame->bpp       = 8;
       pFrame->flags    |= LAV_FRAME_FLAG_BUFFER_MODIFY;
       m_SubtitleConsumer->ProcessFrame(pFrame);
     }
-
-    if ((mt.subtype == MEDIASUBTYPE_RGB32 || mt.subtype == MEDIASUBTYPE_RGB24) && pBIH->biHeight > 0) {
-      int bpp = (mt.subtype == MEDIASUBTYPE_RGB32) ? 4 : 3;
-      flip_plane(pDataOut, pBIH->biWidth * bpp, height);
-    }
   }
 
   BOOL bSizeChanged = FALSE;
@@ -1591,23 +1672,70 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
   // And frame flags..
   SetFrameFlags(pSampleOut, pFrame);
 
-  // Release frame before delivery, so it can be re-used by the decoder (if required)
+  // Release frame before queueing the sample, so it can be re-used by the decoder (if required)
+  // With zero-copy output the sample owns the frame now, and releases it once downstream is done with it
+  if (bZeroCopy)
+    pFrame = NULL;
   ReleaseFrame(&pFrame);
 
-  hr = m_pOutput->Deliver(pSampleOut);
-  if (FAILED(hr)) {
-    DbgLog((LOG_ERROR, 10, L"::Decode(): Deliver failed with hr: %x", hr));
-    m_hrDeliver = hr;
-  }
-
-  if (bSizeChanged)
-    NotifyEvent(EC_VIDEO_SIZE_CHANGED, MAKELPARAM(pBIH->biWidth, abs(pBIH->biHeight)), 0);
+  // Hand the sample to the delivery thread, and go on with the next frame while it is delivered
+  hr = m_Deliver.Queue(pSampleOut, bSizeChanged, pBIH->biWidth, abs(pBIH->biHeight));
 
   SafeRelease(&pSampleOut);
 
   return hr;
 }
 
+HRESULT CLAVVideo::AttachFrameToSample(IMediaSample *pSample, LAVFrame *pFrame, int height)
+{
+  int stride = 0;
+  long size = 0;
+  if (!m_PixFmtConverter.IsPassthroughPossible(pFrame, height, &stride, &size))
+    return S_FALSE;
+
+  // Only samples from our own allocator can hold a frame
+  ILAVFrameSample *pFrameSample = NULL;
+  if (FAILED(pSample->QueryInterface(&pFrameSample)))
+    return S_FALSE;
+
+  HRESULT hr = S_OK;
+
+  CMediaType &mt = m_pOutput->CurrentMediaType();
+  BITMAPINFOHEADER *pBIH = NULL;
+  videoFormatTypeHandler(mt.Format(), mt.FormatType(), &pBIH);
+
+  // The renderer has to accept the stride of the frame
+  if (pBIH->biWidth != stride) {
+    long sizeImage = stride * abs(pBIH->biHeight) * pBIH->biBitCount >> 3;
+    // The samples own buffer is still used for frames that cannot be passed through, so it needs to fit the new stride as well
+    if (stride == m_ZeroCopyRejectedStride || sizeImage > pSample->GetSize()) {
+      hr = S_FALSE;
+    } else {
+      CMediaType newmt = mt;
+      BITMAPINFOHEADER *pNewBIH = NULL;
+      videoFormatTypeHandler(newmt.Format(), newmt.FormatType(), &pNewBIH);
+      pNewBIH->biWidth = stride;
+      pNewBIH->biSizeImage = sizeImage;
+
+      if (m_pOutput->GetConnected()->QueryAccept(&newmt) == S_OK) {
+        DbgLog((LOG_TRACE, 10, L"::AttachFrameToSample(): Changing stride from %d to %d for zero-copy output", pBIH->biWidth, stride));
+        m_pOutput->SetMediaType(&newmt);
+        m_bSendMediaType = TRUE;
+      } else {
+        DbgLog((LOG_TRACE, 10, L"::AttachFrameToSample(): Downstream rejected stride %d, copying frames instead", stride));
+        m_ZeroCopyRejectedStride = stride;
+        hr = S_FALSE;
+      }
+    }
+  }
+
+  if (hr == S_OK)
+    hr = pFrameSample->SetLAVFrame(pFrame, size);
+
+  SafeRelease(&pFrameSample);
+  return hr;
+}
+
 HRESULT CLAVVideo::GetD3DBuffer(LAVFrame *pFrame)
 {
   CheckPointer(pFrame, E_POINTER);
@@ -2028,6 +2156,54 @@ STDMETHODIMP CLAVVideo::SetGPUDeviceIndex(DWORD dwDevice)
   return S_OK;
 }
 
+STDMETHODIMP CLAVVideo::SetZeroCopyOutput(BOOL bEnabled)
+{
+  m_settings.bZeroCopyOutput = bEnabled;
+  return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVVideo::GetZeroCopyOutput()
+{
+  return m_settings.bZeroCopyOutput;
+}
+
+STDMETHODIMP CLAVVideo::SetThreadPoolSize(DWORD dwThreads)
+{
+  m_settings.ThreadPoolSize = dwThreads;
+  CLAVThreadPool::SetSharedSize(dwThreads);
+  return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVVideo::GetThreadPoolSize()
+{
+  return m_settings.ThreadPoolSize;
+}
+
+STDMETHODIMP CLAVVideo::SetRGBPremultiplyAlpha(BOOL bEnabled)
+{
+  m_settings.bRGBPremultiplyAlpha = bEnabled;
+  return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVVideo::GetRGBPremultiplyAlpha()
+{
+  return m_settings.bRGBPremultiplyAlpha;
+}
+
+STDMETHODIMP CLAVVideo::SetInputQueueDepth(DWORD dwDepth)
+{
+  if (dwDepth < 1 || dwDepth > 64)
+    return E_INVALIDARG;
+
+  m_settings.InputQueueDepth = dwDepth;
+  return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVVideo::GetInputQueueDepth()
+{
+  return m_settings.InputQueueDepth;
+}
+
 CLAVControlThread::CLAVControlThread(CLAVVideo *pLAVVideo)
   : CAMThread()
   , m_pLAVVideo(pLAVVideo)
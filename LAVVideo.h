@@ -21,6 +21,8 @@
 
 #include "decoders/ILAVDecoder.h"
 #include "DecodeThread.h"
+#include "DeliverThread.h"
+#include "LAVFramePool.h"
 #include "ILAVPinInfo.h"
 
 #include "LAVPixFmtConverter.h"
@@ -36,6 +38,8 @@
 
 #include "BaseTrayIcon.h"
 
+class CLAVThreadPool;
+
 #define LAVC_VIDEO_REGISTRY_KEY L"Software\\LAV\\Video"
 #define LAVC_VIDEO_REGISTRY_KEY_FORMATS L"Software\\LAV\\Video\\Formats"
 #define LAVC_VIDEO_REGISTRY_KEY_OUTPUT L"Software\\LAV\\Video\\Output"
@@ -130,8 +134,19 @@ public:
 
   STDMETHODIMP SetGPUDeviceIndex(DWORD dwDevice);
 
+  STDMETHODIMP SetZeroCopyOutput(BOOL bEnabled);
+  STDMETHODIMP_(BOOL) GetZeroCopyOutput();
+  STDMETHODIMP SetThreadPoolSize(DWORD dwThreads);
+  STDMETHODIMP_(DWORD) GetThreadPoolSize();
+  STDMETHODIMP SetRGBPremultiplyAlpha(BOOL bEnabled);
+  STDMETHODIMP_(BOOL) GetRGBPremultiplyAlpha();
+  STDMETHODIMP SetInputQueueDepth(DWORD dwDepth);
+  STDMETHODIMP_(DWORD) GetInputQueueDepth();
+
   // ILAVVideoStatus
   STDMETHODIMP_(const WCHAR *) GetActiveDecoderName() { return m_Decoder.GetDecoderName(); }
+  STDMETHODIMP_(const WCHAR *) GetActiveConverterName() { return m_PixFmtConverter.GetConverterName(); }
+  STDMETHODIMP GetFramePoolStatistics(ULONGLONG *pHits, ULONGLONG *pMisses) { m_FramePool.GetStatistics(pHits, pMisses); return S_OK; }
 
   // CTransformFilter
   HRESULT CheckInputType(const CMediaType* mtIn);
@@ -145,6 +160,7 @@ public:
   HRESULT EndFlush();
   HRESULT NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, double dRate);
   HRESULT Receive(IMediaSample *pIn);
+  HRESULT StopStreaming();
 
   HRESULT CheckConnect(PIN_DIRECTION dir, IPin *pPin);
   HRESULT BreakConnect(PIN_DIRECTION dir);
@@ -199,6 +215,7 @@ private:
 
   HRESULT Filter(LAVFrame *pFrame);
   HRESULT DeliverToRenderer(LAVFrame *pFrame);
+  HRESULT AttachFrameToSample(IMediaSample *pSample, LAVFrame *pFrame, int height);
 
   HRESULT PerformFlush();
   HRESULT ReleaseLastSequenceFrame();
@@ -215,11 +232,15 @@ private:
 private:
   friend class CVideoOutputPin;
   friend class CDecodeThread;
+  friend class CDeliverThread;
   friend class CLAVControlThread;
   friend class CLAVSubtitleProvider;
   friend class CLAVSubtitleConsumer;
 
+  // Declared before the threads, so it outlives any frames they release on destruction
+  CLAVFramePool        m_FramePool;
   CDecodeThread        m_Decoder;
+  CDeliverThread       m_Deliver;
   CAMThread            *m_ControlThread;
 
   REFERENCE_TIME       m_rtPrevStart;
@@ -227,9 +248,11 @@ private:
 
   BOOL                 m_bForceInputAR;
   BOOL                 m_bSendMediaType;
+  int                  m_ZeroCopyRejectedStride;
   BOOL                 m_bFlushing;
 
-  HRESULT              m_hrDeliver;
+  // First failure of the delivery thread since the last flush or stop
+  volatile LONG        m_hrDeliver;
 
   CLAVPixFmtConverter  m_PixFmtConverter;
   std::wstring         m_strExtension;
@@ -241,6 +264,8 @@ private:
 
   BOOL                 m_bInDVDMenu;
 
+  CLAVThreadPool       *m_pThreadPool;
+
   AVFilterGraph        *m_pFilterGraph;
   AVFilterContext      *m_pFilterBufferSrc;
   AVFilterContext      *m_pFilterBufferSink;
@@ -281,6 +306,10 @@ private:
     DWORD SWDeintOutput;
     DWORD DitherMode;
     BOOL bDVDVideo;
+    BOOL bZeroCopyOutput;
+    DWORD ThreadPoolSize;
+    BOOL bRGBPremultiplyAlpha;
+    DWORD InputQueueDepth;
   } m_settings;
 
   DWORD m_dwGPUDeviceIndex;
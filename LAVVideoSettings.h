@@ -359,6 +359,37 @@ interface ILAVVideoSettings : public IUnknown
   // Must be called before an input is connected to LAV Video, and the setting is non-persistent
   // NOTE: For CUVID, the index defines the index of the CUDA capable device, while for DXVA2, the list includes all D3D9 devices
   STDMETHOD(SetGPUDeviceIndex)(DWORD dwDevice) = 0;
+
+  // Set if decoded frames should be passed to the renderer without copying them, when they are already in the output format
+  // This requires the renderer to accept LAV Video's own allocator, and only applies to frames that own their buffers
+  // (ie. software decoding and DXVA2 copy-back, but not CUVID or QuickSync, which re-use their buffers)
+  STDMETHOD(SetZeroCopyOutput)(BOOL bEnabled) = 0;
+
+  // Get if zero-copy output is enabled
+  STDMETHOD_(BOOL,GetZeroCopyOutput)() = 0;
+
+  // Set the number of threads used for the pixel format conversion, software deinterlacing and subtitle blending
+  // The threads are shared by all LAV Video instances in the process, and the setting applies to all of them
+  // 0 = one thread per CPU core (default)
+  STDMETHOD(SetThreadPoolSize)(DWORD dwThreads) = 0;
+
+  // Get the number of threads shared by all LAV Video instances
+  STDMETHOD_(DWORD,GetThreadPoolSize)() = 0;
+
+  // Set if RGB output of sources with an alpha channel (ARGB32) should be premultiplied with the alpha
+  // Without an alpha channel in the output, this blends the image onto black; otherwise the alpha is dropped as-is
+  STDMETHOD(SetRGBPremultiplyAlpha)(BOOL bEnabled) = 0;
+
+  // Get if RGB output is premultiplied with the alpha channel
+  STDMETHOD_(BOOL,GetRGBPremultiplyAlpha)() = 0;
+
+  // Set the number of input samples which can be queued for the decoder, so the upstream filter can run ahead of decoding
+  // 1 hands over one sample at a time. Decoders which need to be in sync with the output always use 1.
+  // Valid values are 1 to 64, the default is 4
+  STDMETHOD(SetInputQueueDepth)(DWORD dwDepth) = 0;
+
+  // Get the number of input samples which can be queued for the decoder
+  STDMETHOD_(DWORD,GetInputQueueDepth)() = 0;
 };
 
 // LAV Video status interface
@@ -367,4 +398,10 @@ interface ILAVVideoStatus : public IUnknown
 {
   // Get the name of the active decoder (can return NULL if none is active)
   STDMETHOD_(LPCWSTR, GetActiveDecoderName)() = 0;
+
+  // Get the name and instruction set of the active pixel format conversion function (can return NULL if none is active)
+  STDMETHOD_(LPCWSTR, GetActiveConverterName)() = 0;
+
+  // Get the number of LAVFrame structures which were taken from the frame pool (hits), and which had to be allocated (misses)
+  STDMETHOD(GetFramePoolStatistics)(ULONGLONG *pHits, ULONGLONG *pMisses) = 0;
 };
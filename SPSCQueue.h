@@ -0,0 +1,107 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+
+#define SPSC_CACHE_LINE_SIZE 64
+
+// Single-producer/single-consumer queue, a drop-in for CSynchronizedQueue where only one thread pushes and one pops
+//
+// Items are passed through a lock-free ring buffer. The read and write positions live on their own cache lines,
+// so the producer and the consumer do not steal the line from each other on every operation.
+// When the ring is full, items go into an overflow list behind a lock instead, so Push never blocks and the queue
+// is unbounded, just like CSynchronizedQueue. The producer keeps using the overflow list until the consumer emptied
+// it, which keeps the items in order.
+//
+// The consumer role can move to another thread, as long as the hand-over is synchronized (ie. through an event),
+// and the previous consumer does not call Pop anymore.
+// Pop returns a default constructed item (ie. NULL) if the queue is empty, waiting for new items is up to the caller.
+template <class T, size_t Capacity = 64>
+class CSPSCQueue
+{
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity needs to be a power of two");
+
+public:
+  CSPSCQueue() : m_nReadPos(0), m_nWritePos(0), m_nOverflow(0) {}
+
+  // Producer
+  void Push(T item)
+  {
+    if (m_nOverflow.load(std::memory_order_acquire) == 0) {
+      const size_t pos = m_nWritePos.load(std::memory_order_relaxed);
+      if (pos - m_nReadPos.load(std::memory_order_acquire) < Capacity) {
+        m_Ring[pos & (Capacity - 1)] = item;
+        m_nWritePos.store(pos + 1, std::memory_order_release);
+        return;
+      }
+    }
+
+    CAutoLock lock(&m_OverflowLock);
+    m_Overflow.push_back(item);
+    m_nOverflow.fetch_add(1, std::memory_order_release);
+  }
+
+  // Consumer
+  T Pop()
+  {
+    const size_t pos = m_nReadPos.load(std::memory_order_relaxed);
+    if (pos != m_nWritePos.load(std::memory_order_acquire)) {
+      T item = m_Ring[pos & (Capacity - 1)];
+      m_nReadPos.store(pos + 1, std::memory_order_release);
+      return item;
+    }
+
+    // Overflow items are always newer than anything in the ring, so they are only taken once the ring is empty
+    if (m_nOverflow.load(std::memory_order_acquire) == 0)
+      return T();
+
+    CAutoLock lock(&m_OverflowLock);
+    if (m_Overflow.empty())
+      return T();
+    T item = m_Overflow.front();
+    m_Overflow.pop_front();
+    m_nOverflow.fetch_sub(1, std::memory_order_release);
+    return item;
+  }
+
+  // Consumer
+  bool Empty()
+  {
+    return m_nReadPos.load(std::memory_order_relaxed) == m_nWritePos.load(std::memory_order_acquire)
+        && m_nOverflow.load(std::memory_order_acquire) == 0;
+  }
+
+private:
+  // Keep the positions away from each other, and from whatever is placed around the queue
+  char                m_Pad0[SPSC_CACHE_LINE_SIZE];
+  std::atomic<size_t> m_nReadPos;
+  char                m_Pad1[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> m_nWritePos;
+  char                m_Pad2[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+  T                   m_Ring[Capacity];
+
+  // Only touched once the ring ran full
+  std::atomic<size_t> m_nOverflow;
+  CCritSec            m_OverflowLock;
+  std::deque<T>       m_Overflow;
+};
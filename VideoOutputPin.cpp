@@ -20,6 +20,7 @@
 #include "stdafx.h"
 #include "LAVVideo.h"
 #include "VideoOutputPin.h"
+#include "LAVFrameAllocator.h"
 
 CVideoOutputPin::CVideoOutputPin(LPCTSTR pObjectName, CLAVVideo *pFilter, HRESULT * phr, LPCWSTR pName)
   : CTransformOutputPin(pObjectName, (CTransformFilter *)pFilter, phr, pName)
@@ -36,8 +37,48 @@ HRESULT CVideoOutputPin::InitAllocator(IMemAllocator **ppAlloc)
   HRESULT hr = S_FALSE;
   hr = m_pFilter->m_Decoder.InitAllocator(ppAlloc);
 
+  if (hr != S_OK && m_pFilter->m_settings.bZeroCopyOutput) {
+    CLAVFrameAllocator *pAlloc = new CLAVFrameAllocator(&hr);
+    if (!pAlloc)
+      return E_OUTOFMEMORY;
+    if (FAILED(hr)) {
+      delete pAlloc;
+      return hr;
+    }
+    return pAlloc->QueryInterface(__uuidof(IMemAllocator), (void **)ppAlloc);
+  }
+
   if (hr != S_OK)
     hr = __super::InitAllocator(ppAlloc);
 
   return hr;
 }
+
+HRESULT CVideoOutputPin::DecideAllocator(IMemInputPin *pPin, IMemAllocator **ppAlloc)
+{
+  // For zero-copy output our own allocator needs to be used, so try it before the one offered by the downstream pin
+  if (m_pFilter->m_settings.bZeroCopyOutput) {
+    ALLOCATOR_PROPERTIES prop;
+    ZeroMemory(&prop, sizeof(prop));
+
+    pPin->GetAllocatorRequirements(&prop);
+    if (prop.cbAlign == 0)
+      prop.cbAlign = 1;
+
+    HRESULT hr = InitAllocator(ppAlloc);
+    if (SUCCEEDED(hr)) {
+      hr = DecideBufferSize(*ppAlloc, &prop);
+      if (SUCCEEDED(hr)) {
+        hr = pPin->NotifyAllocator(*ppAlloc, FALSE);
+        if (SUCCEEDED(hr)) {
+          DbgLog((LOG_TRACE, 10, L"CVideoOutputPin::DecideAllocator(): Downstream accepted our allocator"));
+          return S_OK;
+        }
+      }
+    }
+    SafeRelease(ppAlloc);
+    DbgLog((LOG_TRACE, 10, L"CVideoOutputPin::DecideAllocator(): Downstream rejected our allocator (hr: 0x%x)", hr));
+  }
+
+  return __super::DecideAllocator(pPin, ppAlloc);
+}
@@ -26,6 +26,7 @@ public:
   virtual ~CVideoOutputPin();
 
   HRESULT InitAllocator(IMemAllocator **ppAlloc);
+  HRESULT DecideAllocator(IMemInputPin *pPin, IMemAllocator **ppAlloc);
 
 private:
   CLAVVideo *m_pFilter;
@@ -0,0 +1,235 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Micro-benchmark for the pixel format converters
+//
+// Converts synthetic frames for every input format and bit depth into every output format,
+// at several resolutions, thread counts and output strides, and writes the throughput as JSON.
+//
+// Usage: pixconv_bench [-o <file.json>] [-t <ms per cell>] [-in <input>] [-out <output>] [-verify] [-queue]
+//   -o    write the results to a file instead of stdout
+//   -t    minimum time to spend converting each cell, default 100ms
+//   -in   only benchmark this input format (e.g. YUV420bX)
+//   -out  only benchmark this output format (e.g. NV12)
+//   -verify  instead of benchmarking, check every converter against the reference converters, and the AVX2
+//            converters against the SSE2/SSSE3 ones (see pixconv_verify.cpp)
+//   -queue   instead of the converters, benchmark the decoder output queue (see queue_bench.cpp)
+
+#include "stdafx.h"
+#include <stdio.h>
+
+#include "pixconv_bench.h"
+
+const BenchInput bench_inputs[] = {
+  { LAVPixFmt_YUV420,   "YUV420",   { 8 } },
+  { LAVPixFmt_YUV420bX, "YUV420bX", { 9, 10, 12, 14, 16 } },
+  { LAVPixFmt_YUV422,   "YUV422",   { 8 } },
+  { LAVPixFmt_YUV422bX, "YUV422bX", { 9, 10, 12, 14, 16 } },
+  { LAVPixFmt_YUV444,   "YUV444",   { 8 } },
+  { LAVPixFmt_YUV444bX, "YUV444bX", { 9, 10, 12, 14, 16 } },
+  { LAVPixFmt_NV12,     "NV12",     { 8 } },
+  { LAVPixFmt_YUY2,     "YUY2",     { 8 } },
+  { LAVPixFmt_RGB24,    "RGB24",    { 8 } },
+  { LAVPixFmt_RGB32,    "RGB32",    { 8 } },
+  { LAVPixFmt_ARGB32,   "ARGB32",   { 8 } },
+  { LAVPixFmt_RGB48,    "RGB48",    { 16 } },
+};
+const int bench_input_count = countof(bench_inputs);
+
+const char *bench_output_names[LAVOutPixFmt_NB] = {
+  "YV12", "NV12", "YUY2", "UYVY", "AYUV", "P010", "P210", "Y410", "P016", "P216", "Y416", "RGB32", "RGB24", "v210", "v410", "YV16", "YV24", "RGB48"
+};
+
+static const struct {
+  int width, height;
+} bench_sizes[] = {
+  { 1280,  720 },
+  { 1920, 1080 },
+  { 3840, 2160 },
+};
+
+void FillFrame(LAVFrame *pFrame)
+{
+  LAVPixFmtDesc desc = getPixelFormatDesc(pFrame->format);
+  const BOOL bHighBitdepth = (pFrame->format == LAVPixFmt_YUV420bX || pFrame->format == LAVPixFmt_YUV422bX || pFrame->format == LAVPixFmt_YUV444bX || pFrame->format == LAVPixFmt_RGB48);
+  const int bits = bHighBitdepth ? pFrame->bpp : 8;
+
+  for (int plane = 0; plane < desc.planes; plane++) {
+    const int lines = (pFrame->height + desc.planeHeight[plane] - 1) / desc.planeHeight[plane];
+    for (int line = 0; line < lines; line++) {
+      BYTE *p = pFrame->data[plane] + line * pFrame->stride[plane];
+      const int samples = pFrame->stride[plane] / (bHighBitdepth ? 2 : 1);
+      for (int i = 0; i < samples; i++) {
+        // A triangle wave keeps neighbouring samples close, so different chroma filters stay comparable
+        int value = (i * 3 + line * 2 + plane * 85) % 510;
+        if (value > 255)
+          value = 510 - value;
+        // The bits below 8-bit precision vary from sample to sample, to exercise rounding and dithering
+        value = (value << (bits - 8)) | ((i * 7 + line * 5) & ((1 << (bits - 8)) - 1));
+        if (bHighBitdepth)
+          ((uint16_t *)p)[i] = (uint16_t)value;
+        else
+          p[i] = (BYTE)value;
+      }
+    }
+  }
+}
+
+// Bytes read per pixel from the input frame
+static double InputBytesPerPixel(LAVPixelFormat format)
+{
+  LAVPixFmtDesc desc = getPixelFormatDesc(format);
+  double bytes = 0.0;
+  for (int plane = 0; plane < desc.planes; plane++)
+    bytes += (double)desc.codedbytes / (desc.planeWidth[plane] * desc.planeHeight[plane]);
+  return bytes;
+}
+
+static int BenchmarkCell(FILE *out, BOOL bFirst, CLAVPixFmtConverter &conv, LAVFrame *pFrame, const char *inName, LAVOutPixFmts outFmt, int threads, BOOL bAlignedStride, LONGLONG minTime)
+{
+  // Unaligned strides are still a multiple of 8 pixels, so chroma planes with half the stride stay consistent
+  const int dstStride = FFALIGN(pFrame->width, 64) + (bAlignedStride ? 0 : 8);
+  const size_t bufferSize = (size_t)dstStride * pFrame->height * 8 + 4096;
+  uint8_t *dst = (uint8_t *)av_malloc(bufferSize);
+  if (!dst)
+    return 0;
+
+  LARGE_INTEGER frequency, start, now;
+  QueryPerformanceFrequency(&frequency);
+
+  // Warm up caches, thread pool and lazily initialized tables
+  conv.Convert(pFrame, dst, pFrame->width, pFrame->height, dstStride);
+
+  int frames = 0;
+  QueryPerformanceCounter(&start);
+  do {
+    conv.Convert(pFrame, dst, pFrame->width, pFrame->height, dstStride);
+    frames++;
+    QueryPerformanceCounter(&now);
+  } while ((now.QuadPart - start.QuadPart) * 1000 < minTime * frequency.QuadPart || frames < 3);
+
+  av_freep(&dst);
+
+  const double seconds = (double)(now.QuadPart - start.QuadPart) / frequency.QuadPart;
+  const double mpixels = (double)pFrame->width * pFrame->height * frames / 1000000.0;
+  const double bytesPerPixel = InputBytesPerPixel(pFrame->format) + lav_pixfmt_desc[outFmt].bpp / 8.0;
+
+  fprintf(out, "%s    { \"input\": \"%s\", \"bpp\": %d, \"output\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, \"stride\": \"%s\", "
+               "\"kernel\": \"%S\", \"frames\": %d, \"mpixel_per_sec\": %.2f, \"bytes_per_pixel\": %.3f }",
+          bFirst ? "" : ",\n", inName, pFrame->bpp, bench_output_names[outFmt], pFrame->width, pFrame->height, threads, bAlignedStride ? "aligned" : "unaligned",
+          conv.GetConverterName(), frames, mpixels / seconds, bytesPerPixel);
+  fflush(out);
+
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *out = stdout;
+  LONGLONG minTime = 100;
+  const char *inFilter = NULL, *outFilter = NULL;
+  BOOL bVerify = FALSE;
+  BOOL bQueue = FALSE;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      out = fopen(argv[++i], "w");
+      if (!out) {
+        fprintf(stderr, "Cannot open %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      minTime = _atoi64(argv[++i]);
+    } else if (strcmp(argv[i], "-in") == 0 && i + 1 < argc) {
+      inFilter = argv[++i];
+    } else if (strcmp(argv[i], "-out") == 0 && i + 1 < argc) {
+      outFilter = argv[++i];
+    } else if (strcmp(argv[i], "-verify") == 0) {
+      bVerify = TRUE;
+    } else if (strcmp(argv[i], "-queue") == 0) {
+      bQueue = TRUE;
+    } else {
+      fprintf(stderr, "Usage: %s [-o <file.json>] [-t <ms per cell>] [-in <input>] [-out <output>] [-verify] [-queue]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (bVerify) {
+    int failures = RunVerify(out, inFilter, outFilter);
+    if (out != stdout)
+      fclose(out);
+    return failures ? 1 : 0;
+  }
+
+  if (bQueue) {
+    int cells = RunQueueBench(out, minTime);
+    if (out != stdout)
+      fclose(out);
+    fprintf(stderr, "%d cells benchmarked\n", cells);
+    return 0;
+  }
+
+  CBenchSettings settings;
+  CLAVPixFmtConverter conv;
+  conv.SetSettings(&settings);
+
+  const int maxThreads = av_cpu_count();
+  int cells = 0;
+
+  fprintf(out, "{\n  \"cpu_count\": %d,\n  \"results\": [\n", maxThreads);
+
+  for (int in = 0; in < bench_input_count; in++) {
+    if (inFilter && _stricmp(inFilter, bench_inputs[in].name) != 0)
+      continue;
+    for (int b = 0; b < countof(bench_inputs[in].bpp) && bench_inputs[in].bpp[b]; b++) {
+      for (int s = 0; s < countof(bench_sizes); s++) {
+        LAVFrame frame;
+        ZeroMemory(&frame, sizeof(frame));
+        frame.width  = bench_sizes[s].width;
+        frame.height = bench_sizes[s].height;
+        frame.format = bench_inputs[in].format;
+        frame.bpp    = bench_inputs[in].bpp[b];
+        if (FAILED(AllocLAVFrameBuffers(&frame)))
+          continue;
+        FillFrame(&frame);
+
+        conv.SetInputFmt(frame.format, frame.bpp);
+        for (int o = 0; o < LAVOutPixFmt_NB; o++) {
+          if (outFilter && _stricmp(outFilter, bench_output_names[o]) != 0)
+            continue;
+          conv.SetOutputPixFmt((LAVOutPixFmts)o);
+          for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            conv.SetNumThreads(threads);
+            cells += BenchmarkCell(out, cells == 0, conv, &frame, bench_inputs[in].name, (LAVOutPixFmts)o, threads, TRUE, minTime);
+            cells += BenchmarkCell(out, cells == 0, conv, &frame, bench_inputs[in].name, (LAVOutPixFmts)o, threads, FALSE, minTime);
+          }
+        }
+
+        FreeLAVFrameBuffers(&frame);
+      }
+    }
+  }
+
+  fprintf(out, "\n  ]\n}\n");
+  if (out != stdout)
+    fclose(out);
+
+  fprintf(stderr, "%d cells benchmarked\n", cells);
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVPixFmtConverter.h"
+
+// Settings for the converter, only the conversion related settings are used
+class CBenchSettings : public ILAVVideoSettings
+{
+public:
+  CBenchSettings() : m_DitherMode(LAVDither_Ordered) {}
+
+  // IUnknown
+  STDMETHODIMP QueryInterface(REFIID riid, void **ppv) { return E_NOINTERFACE; }
+  STDMETHODIMP_(ULONG) AddRef() { return 1; }
+  STDMETHODIMP_(ULONG) Release() { return 1; }
+
+  // ILAVVideoSettings
+  STDMETHODIMP SetRuntimeConfig(BOOL bRuntimeConfig) { return S_OK; }
+  STDMETHODIMP_(BOOL) GetFormatConfiguration(LAVVideoCodec vCodec) { return TRUE; }
+  STDMETHODIMP SetFormatConfiguration(LAVVideoCodec vCodec, BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP SetNumThreads(DWORD dwNum) { return E_NOTIMPL; }
+  STDMETHODIMP_(DWORD) GetNumThreads() { return 0; }
+  STDMETHODIMP SetStreamAR(DWORD bStreamAR) { return E_NOTIMPL; }
+  STDMETHODIMP_(DWORD) GetStreamAR() { return 2; }
+  STDMETHODIMP_(BOOL) GetPixelFormat(LAVOutPixFmts pixFmt) { return TRUE; }
+  STDMETHODIMP SetPixelFormat(LAVOutPixFmts pixFmt, BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP SetRGBOutputRange(DWORD dwRange) { return E_NOTIMPL; }
+  STDMETHODIMP_(DWORD) GetRGBOutputRange() { return 0; }
+  STDMETHODIMP SetDeintFieldOrder(LAVDeintFieldOrder fieldOrder) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVDeintFieldOrder) GetDeintFieldOrder() { return DeintFieldOrder_Auto; }
+  STDMETHODIMP SetDeintAggressive(BOOL bAggressive) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetDeintAggressive() { return FALSE; }
+  STDMETHODIMP SetDeintForce(BOOL bForce) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetDeintForce() { return FALSE; }
+  STDMETHODIMP_(DWORD) CheckHWAccelSupport(LAVHWAccel hwAccel) { return 0; }
+  STDMETHODIMP SetHWAccel(LAVHWAccel hwAccel) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVHWAccel) GetHWAccel() { return HWAccel_None; }
+  STDMETHODIMP SetHWAccelCodec(LAVVideoHWCodec hwAccelCodec, BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetHWAccelCodec(LAVVideoHWCodec hwAccelCodec) { return FALSE; }
+  STDMETHODIMP SetHWAccelDeintMode(LAVHWDeintModes deintMode) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVHWDeintModes) GetHWAccelDeintMode() { return HWDeintMode_Weave; }
+  STDMETHODIMP SetHWAccelDeintOutput(LAVDeintOutput deintOutput) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVDeintOutput) GetHWAccelDeintOutput() { return DeintOutput_FramePerField; }
+  STDMETHODIMP SetHWAccelDeintHQ(BOOL bHQ) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetHWAccelDeintHQ() { return FALSE; }
+  STDMETHODIMP SetSWDeintMode(LAVSWDeintModes deintMode) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVSWDeintModes) GetSWDeintMode() { return SWDeintMode_None; }
+  STDMETHODIMP SetSWDeintOutput(LAVDeintOutput deintOutput) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVDeintOutput) GetSWDeintOutput() { return DeintOutput_FramePerField; }
+  STDMETHODIMP SetDeintTreatAsProgressive(BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetDeintTreatAsProgressive() { return FALSE; }
+  STDMETHODIMP SetDitherMode(LAVDitherMode ditherMode) { m_DitherMode = ditherMode; return S_OK; }
+  STDMETHODIMP_(LAVDitherMode) GetDitherMode() { return m_DitherMode; }
+  STDMETHODIMP SetUseMSWMV9Decoder(BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetUseMSWMV9Decoder() { return FALSE; }
+  STDMETHODIMP SetDVDVideoSupport(BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetDVDVideoSupport() { return FALSE; }
+  STDMETHODIMP SetHWAccelResolutionFlags(DWORD dwResFlags) { return E_NOTIMPL; }
+  STDMETHODIMP_(DWORD) GetHWAccelResolutionFlags() { return 0; }
+  STDMETHODIMP SetTrayIcon(BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetTrayIcon() { return FALSE; }
+  STDMETHODIMP SetDeinterlacingMode(LAVDeintMode deintMode) { return E_NOTIMPL; }
+  STDMETHODIMP_(LAVDeintMode) GetDeinterlacingMode() { return DeintMode_Auto; }
+  STDMETHODIMP SetGPUDeviceIndex(DWORD dwDevice) { return E_NOTIMPL; }
+  STDMETHODIMP SetZeroCopyOutput(BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetZeroCopyOutput() { return FALSE; }
+  STDMETHODIMP SetThreadPoolSize(DWORD dwThreads) { return E_NOTIMPL; }
+  STDMETHODIMP_(DWORD) GetThreadPoolSize() { return 0; }
+  STDMETHODIMP SetRGBPremultiplyAlpha(BOOL bEnabled) { return E_NOTIMPL; }
+  STDMETHODIMP_(BOOL) GetRGBPremultiplyAlpha() { return FALSE; }
+  STDMETHODIMP SetInputQueueDepth(DWORD dwDepth) { return E_NOTIMPL; }
+  STDMETHODIMP_(DWORD) GetInputQueueDepth() { return 1; }
+
+private:
+  LAVDitherMode m_DitherMode;
+};
+
+struct BenchInput {
+  LAVPixelFormat format;
+  const char *name;
+  int bpp[5];
+};
+
+extern const BenchInput bench_inputs[];
+extern const int bench_input_count;
+extern const char *bench_output_names[LAVOutPixFmt_NB];
+
+// Fill the planes of the frame with smooth gradients of valid samples
+void FillFrame(LAVFrame *pFrame);
+
+// Compare every converter against the reference converters, returns the number of failed checks
+int RunVerify(FILE *out, const char *inFilter, const char *outFilter);
+
+// Benchmark the decoder output queue implementations, returns the number of cells benchmarked (see queue_bench.cpp)
+int RunQueueBench(FILE *out, LONGLONG minTime);
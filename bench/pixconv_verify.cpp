@@ -0,0 +1,483 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Conformance check of the pixel format converters
+//
+// The reference for every (input, bpp, output) cell is the converter selected with the instruction set limited to C,
+// which is the swscale based convert_generic (or a plain copy). Every converter the registry selects at a higher
+// instruction set is compared against it, for both dither modes, at sizes with odd widths and heights to exercise
+// the edge handling of the kernels. The last chroma sample of an odd width is complete, the 4:2:0 output formats
+// only have chroma lines for complete line pairs, and the padding luma of the last YUY2/UYVY macropixel is ignored.
+//
+// Tolerance, in LSB of the output format:
+// - 1 for rounding differences, 2 if the output has less bits than the input and is dithered
+// - additionally, in LSB of the lower of the input and output precision, VERIFY_TOL_RESAMPLE for chroma that is
+//   resampled (e.g. 4:2:0 to 4:2:2), and VERIFY_TOL_RGB for all samples when converting between YUV and RGB.
+//   The kernels use other chroma filters and fixed-point coefficients than swscale, the values are the largest
+//   differences measured on the synthetic gradients with a small margin.
+//
+// Independent of the reference, the output of a converter has to be bit-identical with any number of threads
+// and with an unaligned output stride, and it may not write past the end of the output image. Frames that the
+// converter allows to pass through have to be identical to its output, and be passed with all of their lines.
+//
+// The AVX2 kernels compute the same as the SSE2/SSSE3 kernels they replace, so with ordered dithering, their output
+// also has to be bit-identical to the converter selected one instruction set lower.
+
+#include "stdafx.h"
+#include <stdio.h>
+
+#include "pixconv_bench.h"
+
+static const struct {
+  int width, height;
+} verify_sizes[] = {
+  {    2,    2 },
+  {   18,   10 },
+  {   33,   18 },
+  {   33,   17 },
+  {  130,  130 },
+  {  721,  242 },
+  {  721,  243 },
+  { 1920, 1080 },
+};
+
+#define VERIFY_TOL_RESAMPLE 6
+#define VERIFY_TOL_RGB      28
+
+#define VERIFY_GUARD_SIZE 4096
+#define VERIFY_GUARD_BYTE 0xA5
+
+// Layout of the samples of an output format, to compare them one by one
+enum VerifySampleType {
+  Sample8,
+  Sample16,
+  Sample10x3,         // three 10-bit samples in a 32-bit word
+};
+
+static const struct {
+  VerifySampleType type;
+  int bits;           // significant bits of a sample
+  int shift;          // position of the significant bits (Sample16), or of the first sample in the word (Sample10x3)
+  int period;         // packed formats: the order of the components repeats every period samples
+  unsigned lumaMask;  // packed formats: bit n is set if sample n of a period is luma, planar formats use plane 0 as luma
+  BOOL bRGB;
+} verify_layouts[LAVOutPixFmt_NB] = {
+  { Sample8,    8,  0, 1,  0,    FALSE }, // YV12
+  { Sample8,    8,  0, 1,  0,    FALSE }, // NV12
+  { Sample8,    8,  0, 2,  0x1,  FALSE }, // YUY2
+  { Sample8,    8,  0, 2,  0x2,  FALSE }, // UYVY
+  { Sample8,    8,  0, 4,  0x4,  FALSE }, // AYUV
+  { Sample16,  10,  6, 1,  0,    FALSE }, // P010
+  { Sample16,  10,  6, 1,  0,    FALSE }, // P210
+  { Sample10x3,10,  0, 3,  0x2,  FALSE }, // Y410
+  { Sample16,  16,  0, 1,  0,    FALSE }, // P016
+  { Sample16,  16,  0, 1,  0,    FALSE }, // P216
+  { Sample16,  16,  0, 4,  0x4,  FALSE }, // Y416
+  { Sample8,    8,  0, 1,  0,    TRUE  }, // RGB32
+  { Sample8,    8,  0, 1,  0,    TRUE  }, // RGB24
+  { Sample10x3,10,  0, 2,  0x2,  FALSE }, // v210
+  { Sample10x3,10,  2, 3,  0x2,  FALSE }, // v410
+  { Sample8,    8,  0, 1,  0,    FALSE }, // YV16
+  { Sample8,    8,  0, 1,  0,    FALSE }, // YV24
+  { Sample16,  16,  0, 1,  0,    TRUE  }, // RGB48
+};
+
+struct VerifyMismatch {
+  int plane, x, y;
+  int got, expected;
+};
+
+// Geometry of one plane of an output image
+struct VerifyPlane {
+  size_t offset;
+  int strideBytes;
+  int lineBytes;
+  int lines;
+};
+
+static int GetOutputPlanes(LAVOutPixFmts format, int width, int height, int stride, VerifyPlane planes[4], size_t *pImageSize)
+{
+  const LAVOutPixFmtDesc &desc = lav_pixfmt_desc[format];
+  size_t offset = 0;
+  int count = max(desc.planes, 1);
+
+  for (int plane = 0; plane < count; plane++) {
+    VerifyPlane &p = planes[plane];
+    if (format == LAVOutPixFmt_v210) {
+      p.strideBytes = ((stride + 47) / 48) * 128;
+      p.lineBytes   = ((width + 5) / 6) * 16;
+    } else if (format == LAVOutPixFmt_YUY2 || format == LAVOutPixFmt_UYVY) {
+      // Two pixels share one macropixel
+      p.strideBytes = stride * desc.codedbytes;
+      p.lineBytes   = ((width + 1) >> 1) * 4;
+    } else if (desc.planes == 2 && plane == 1) {
+      // Interleaved chroma, which is subsampled horizontally in all semi-planar formats
+      p.strideBytes = stride * desc.codedbytes;
+      p.lineBytes   = ((width + 1) >> 1) * 2 * desc.codedbytes;
+    } else {
+      p.strideBytes = stride * desc.codedbytes / desc.planeWidth[plane];
+      p.lineBytes   = (width + desc.planeWidth[plane] - 1) / desc.planeWidth[plane] * desc.codedbytes;
+    }
+    // The 4:2:0 formats only have a chroma line for every complete line pair, the converters and
+    // swscale_scale place the planes accordingly, so the lines of a vertically subsampled plane round down
+    p.lines  = height / desc.planeHeight[plane];
+    p.offset = offset;
+    offset += (size_t)p.strideBytes * p.lines;
+  }
+
+  *pImageSize = offset;
+  return count;
+}
+
+static inline int GetSample(LAVOutPixFmts format, const BYTE *line, int index)
+{
+  switch (verify_layouts[format].type) {
+  case Sample8:
+    return line[index];
+  case Sample16:
+    return ((const uint16_t *)line)[index] >> verify_layouts[format].shift;
+  default:
+    return (((const uint32_t *)line)[index / 3] >> (verify_layouts[format].shift + (index % 3) * 10)) & 0x3FF;
+  }
+}
+
+static inline int GetSampleCount(LAVOutPixFmts format, int lineBytes)
+{
+  switch (verify_layouts[format].type) {
+  case Sample8:
+    return lineBytes;
+  case Sample16:
+    return lineBytes / 2;
+  default:
+    return lineBytes / 4 * 3;
+  }
+}
+
+// Compare two images sample by sample, returns FALSE and the first offending sample if a difference exceeds the tolerance
+static BOOL CompareImages(LAVOutPixFmts format, int width, int height, const BYTE *ref, int refStride, const BYTE *test, int testStride, int tolLuma, int tolChroma, VerifyMismatch *pMismatch)
+{
+  VerifyPlane refPlanes[4], testPlanes[4];
+  size_t refSize, testSize;
+  const int planes = GetOutputPlanes(format, width, height, refStride, refPlanes, &refSize);
+  GetOutputPlanes(format, width, height, testStride, testPlanes, &testSize);
+
+  const BOOL bPlanar = lav_pixfmt_desc[format].planes > 0;
+  const BOOL bPacked422 = (format == LAVOutPixFmt_YUY2 || format == LAVOutPixFmt_UYVY);
+  const int period = verify_layouts[format].period;
+  const unsigned lumaMask = verify_layouts[format].lumaMask;
+
+  for (int plane = 0; plane < planes; plane++) {
+    const int samples = GetSampleCount(format, refPlanes[plane].lineBytes);
+    for (int y = 0; y < refPlanes[plane].lines; y++) {
+      const BYTE *r = ref  + refPlanes[plane].offset  + (size_t)y * refPlanes[plane].strideBytes;
+      const BYTE *t = test + testPlanes[plane].offset + (size_t)y * testPlanes[plane].strideBytes;
+      for (int x = 0; x < samples; x++) {
+        const BOOL bLuma = !verify_layouts[format].bRGB && (bPlanar ? plane == 0 : !!((lumaMask >> (x % period)) & 1));
+        // The second luma sample of the last macropixel is padding if the width is odd
+        if (bPacked422 && bLuma && (x >> 1) >= width)
+          continue;
+        const int expected = GetSample(format, r, x);
+        const int got = GetSample(format, t, x);
+        if (abs(got - expected) > (bLuma ? tolLuma : tolChroma)) {
+          VerifyMismatch m = { plane, x, y, got, expected };
+          *pMismatch = m;
+          return FALSE;
+        }
+      }
+    }
+  }
+  return TRUE;
+}
+
+static BOOL CheckGuard(const BYTE *buffer, size_t imageSize)
+{
+  for (size_t i = 0; i < VERIFY_GUARD_SIZE; i++) {
+    if (buffer[imageSize + i] != VERIFY_GUARD_BYTE)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+// Output buffer with a guard area behind the image, to detect converters writing out of bounds
+static BYTE *AllocOutput(LAVOutPixFmts format, int width, int height, int stride, size_t *pImageSize)
+{
+  VerifyPlane planes[4];
+  GetOutputPlanes(format, width, height, stride, planes, pImageSize);
+  BYTE *buffer = (BYTE *)av_malloc(*pImageSize + VERIFY_GUARD_SIZE);
+  if (buffer) {
+    memset(buffer, 0, *pImageSize);
+    memset(buffer + *pImageSize, VERIFY_GUARD_BYTE, VERIFY_GUARD_SIZE);
+  }
+  return buffer;
+}
+
+static int GetInputBits(const LAVFrame *pFrame)
+{
+  switch (pFrame->format) {
+  case LAVPixFmt_YUV420bX:
+  case LAVPixFmt_YUV422bX:
+  case LAVPixFmt_YUV444bX:
+    return pFrame->bpp;
+  case LAVPixFmt_RGB48:
+    return 16;
+  default:
+    return 8;
+  }
+}
+
+static BOOL IsRGBInput(LAVPixelFormat format)
+{
+  return format == LAVPixFmt_RGB24 || format == LAVPixFmt_RGB32 || format == LAVPixFmt_ARGB32 || format == LAVPixFmt_RGB48;
+}
+
+// Chroma subsampling of the formats as (horizontal << 4 | vertical), RGB formats have none
+static int GetInputSubsampling(LAVPixelFormat format)
+{
+  switch (format) {
+  case LAVPixFmt_YUV420:
+  case LAVPixFmt_YUV420bX:
+  case LAVPixFmt_NV12:
+    return 0x22;
+  case LAVPixFmt_YUV422:
+  case LAVPixFmt_YUV422bX:
+  case LAVPixFmt_YUY2:
+    return 0x21;
+  default:
+    return 0x11;
+  }
+}
+
+static int GetOutputSubsampling(LAVOutPixFmts format)
+{
+  switch (format) {
+  case LAVOutPixFmt_YV12:
+  case LAVOutPixFmt_NV12:
+  case LAVOutPixFmt_P010:
+  case LAVOutPixFmt_P016:
+    return 0x22;
+  case LAVOutPixFmt_YUY2:
+  case LAVOutPixFmt_UYVY:
+  case LAVOutPixFmt_P210:
+  case LAVOutPixFmt_P216:
+  case LAVOutPixFmt_v210:
+  case LAVOutPixFmt_YV16:
+    return 0x21;
+  default:
+    return 0x11;
+  }
+}
+
+struct VerifyCell {
+  const char *inName;
+  LAVFrame *pFrame;
+  LAVOutPixFmts outFmt;
+  LAVDitherMode dither;
+};
+
+static void ReportFailure(FILE *out, const VerifyCell &cell, LPCWSTR kernel, const char *check, const VerifyMismatch *pMismatch)
+{
+  fprintf(out, "FAIL %s/%d -> %s, %dx%d, %s dither, %S: %s", cell.inName, cell.pFrame->bpp, bench_output_names[cell.outFmt],
+          cell.pFrame->width, cell.pFrame->height, cell.dither == LAVDither_Random ? "random" : "ordered", kernel, check);
+  if (pMismatch)
+    fprintf(out, " (plane %d, sample %d, line %d: got %d, expected %d)", pMismatch->plane, pMismatch->x, pMismatch->y, pMismatch->got, pMismatch->expected);
+  fprintf(out, "\n");
+  fflush(out);
+}
+
+// Run all checks of one cell against every instruction set, returns the number of failed checks
+static int CheckCell(FILE *out, const VerifyCell &cell, CLAVPixFmtConverter &ref, CLAVPixFmtConverter &conv, LAVPixConvISA maxISA, int *pChecks)
+{
+  LAVFrame *pFrame = cell.pFrame;
+  const int width = pFrame->width, height = pFrame->height;
+  const int stride = FFALIGN(width, 64);
+  const int unalignedStride = stride + 8;
+  const LAVOutPixFmts outFmt = cell.outFmt;
+  int failures = 0;
+
+  ref.SetMaxISA(LAVPixConvISA_C);
+  ref.SetInputFmt(pFrame->format, pFrame->bpp);
+  ref.SetOutputPixFmt(outFmt);
+  ref.SetNumThreads(1);
+
+  size_t imageSize, unalignedImageSize;
+  BYTE *refBuf = AllocOutput(outFmt, width, height, stride, &imageSize);
+  BYTE *testBuf = AllocOutput(outFmt, width, height, stride, &imageSize);
+  BYTE *threadBuf = AllocOutput(outFmt, width, height, stride, &imageSize);
+  BYTE *unalignedBuf = AllocOutput(outFmt, width, height, unalignedStride, &unalignedImageSize);
+  BYTE *lowerBuf = AllocOutput(outFmt, width, height, stride, &imageSize);
+  if (!refBuf || !testBuf || !threadBuf || !unalignedBuf || !lowerBuf) {
+    fprintf(out, "FAIL out of memory\n");
+    av_freep(&refBuf);
+    av_freep(&testBuf);
+    av_freep(&threadBuf);
+    av_freep(&unalignedBuf);
+    av_freep(&lowerBuf);
+    return 1;
+  }
+
+  ref.Convert(pFrame, refBuf, width, height, stride);
+
+  // Tolerances, see the top of the file
+  const int inBits = GetInputBits(pFrame);
+  const int outBits = verify_layouts[outFmt].bits;
+  const int tolBase = (outBits < inBits) ? 2 : 1;
+  const int tolShift = outBits - min(inBits, outBits);
+  const BOOL bColorConversion = IsRGBInput(pFrame->format) != verify_layouts[outFmt].bRGB;
+  const BOOL bResampled = !IsRGBInput(pFrame->format) && !verify_layouts[outFmt].bRGB && GetInputSubsampling(pFrame->format) != GetOutputSubsampling(outFmt);
+  const int tolLuma = bColorConversion ? tolBase + (VERIFY_TOL_RGB << tolShift) : tolBase;
+  const int tolChroma = bColorConversion ? tolLuma : (bResampled ? tolBase + (VERIFY_TOL_RESAMPLE << tolShift) : tolBase);
+
+  LPCWSTR lastKernel = ref.GetConverterName();
+  // Converter below AVX2 whose output is kept in lowerBuf, NULL if there is none
+  LPCWSTR lowerKernel = NULL;
+  for (int isa = LAVPixConvISA_SSE2; isa <= maxISA; isa++) {
+    conv.SetMaxISA((LAVPixConvISA)isa);
+    conv.SetInputFmt(pFrame->format, pFrame->bpp);
+    conv.SetOutputPixFmt(outFmt);
+
+    // Only check each converter once
+    LPCWSTR kernel = conv.GetConverterName();
+    if (wcscmp(kernel, lastKernel) == 0)
+      continue;
+    lastKernel = kernel;
+
+    VerifyMismatch mismatch;
+
+    conv.SetNumThreads(1);
+    memset(testBuf, 0, imageSize);
+    conv.Convert(pFrame, testBuf, width, height, stride);
+    (*pChecks)++;
+    if (!CompareImages(outFmt, width, height, refBuf, stride, testBuf, stride, tolLuma, tolChroma, &mismatch)) {
+      ReportFailure(out, cell, kernel, "differs from the reference", &mismatch);
+      failures++;
+    }
+    (*pChecks)++;
+    if (!CheckGuard(testBuf, imageSize)) {
+      ReportFailure(out, cell, kernel, "writes past the end of the image", NULL);
+      failures++;
+    }
+
+    if (isa < LAVPixConvISA_AVX2) {
+      memcpy(lowerBuf, testBuf, imageSize);
+      lowerKernel = kernel;
+    } else if (lowerKernel && cell.dither == LAVDither_Ordered) {
+      char check[256];
+      _snprintf_s(check, sizeof(check), "differs from %S", lowerKernel);
+      (*pChecks)++;
+      if (!CompareImages(outFmt, width, height, lowerBuf, stride, testBuf, stride, 0, 0, &mismatch)) {
+        ReportFailure(out, cell, kernel, check, &mismatch);
+        failures++;
+      }
+    }
+
+    // A frame that can be delivered as-is has to look like the output of the converter, including the last chroma line of odd heights
+    int passStride;
+    long passSize;
+    if (conv.IsPassthroughPossible(pFrame, height, &passStride, &passSize)) {
+      const LAVPixFmtDesc desc = getPixelFormatDesc(pFrame->format);
+      const int last = desc.planes - 1;
+      const long frameSize = (long)(pFrame->data[last] - pFrame->data[0]) + pFrame->stride[last] * ((height + desc.planeHeight[last] - 1) / desc.planeHeight[last]);
+      (*pChecks)++;
+      if (!CompareImages(outFmt, width, height, testBuf, stride, pFrame->data[0], passStride, 0, 0, &mismatch)) {
+        ReportFailure(out, cell, kernel, "differs when passed through", &mismatch);
+        failures++;
+      }
+      (*pChecks)++;
+      if (passSize != frameSize) {
+        ReportFailure(out, cell, kernel, "passes through an incomplete frame", NULL);
+        failures++;
+      }
+    }
+
+    conv.SetNumThreads(av_cpu_count());
+    memset(threadBuf, 0, imageSize);
+    conv.Convert(pFrame, threadBuf, width, height, stride);
+    (*pChecks)++;
+    if (!CompareImages(outFmt, width, height, testBuf, stride, threadBuf, stride, 0, 0, &mismatch)) {
+      ReportFailure(out, cell, kernel, "differs when using multiple threads", &mismatch);
+      failures++;
+    }
+
+    conv.SetNumThreads(1);
+    memset(unalignedBuf, 0, unalignedImageSize);
+    conv.Convert(pFrame, unalignedBuf, width, height, unalignedStride);
+    (*pChecks)++;
+    if (!CompareImages(outFmt, width, height, testBuf, stride, unalignedBuf, unalignedStride, 0, 0, &mismatch)) {
+      ReportFailure(out, cell, kernel, "differs with an unaligned stride", &mismatch);
+      failures++;
+    }
+    (*pChecks)++;
+    if (!CheckGuard(unalignedBuf, unalignedImageSize)) {
+      ReportFailure(out, cell, kernel, "writes past the end of the image with an unaligned stride", NULL);
+      failures++;
+    }
+  }
+
+  av_freep(&refBuf);
+  av_freep(&testBuf);
+  av_freep(&threadBuf);
+  av_freep(&unalignedBuf);
+  av_freep(&lowerBuf);
+  return failures;
+}
+
+int RunVerify(FILE *out, const char *inFilter, const char *outFilter)
+{
+  CBenchSettings settings;
+  CLAVPixFmtConverter ref, conv;
+  ref.SetSettings(&settings);
+  conv.SetSettings(&settings);
+
+  const LAVPixConvISA maxISA = CLAVPixFmtConverter::GetMaxISA();
+
+  int checks = 0, failures = 0;
+
+  for (int in = 0; in < bench_input_count; in++) {
+    if (inFilter && _stricmp(inFilter, bench_inputs[in].name) != 0)
+      continue;
+    for (int b = 0; b < countof(bench_inputs[in].bpp) && bench_inputs[in].bpp[b]; b++) {
+      for (int s = 0; s < countof(verify_sizes); s++) {
+        LAVFrame frame;
+        ZeroMemory(&frame, sizeof(frame));
+        frame.width  = verify_sizes[s].width;
+        frame.height = verify_sizes[s].height;
+        frame.format = bench_inputs[in].format;
+        frame.bpp    = bench_inputs[in].bpp[b];
+        if (FAILED(AllocLAVFrameBuffers(&frame)))
+          continue;
+        FillFrame(&frame);
+
+        for (int o = 0; o < LAVOutPixFmt_NB; o++) {
+          if (outFilter && _stricmp(outFilter, bench_output_names[o]) != 0)
+            continue;
+          for (int dither = LAVDither_Ordered; dither <= LAVDither_Random; dither++) {
+            settings.SetDitherMode((LAVDitherMode)dither);
+            VerifyCell cell = { bench_inputs[in].name, &frame, (LAVOutPixFmts)o, (LAVDitherMode)dither };
+            failures += CheckCell(out, cell, ref, conv, maxISA, &checks);
+          }
+        }
+
+        FreeLAVFrameBuffers(&frame);
+      }
+    }
+  }
+
+  fprintf(out, "%d of %d checks failed\n", failures, checks);
+  return failures;
+}
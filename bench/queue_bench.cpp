@@ -0,0 +1,139 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Micro-benchmark for the decoder output queue (CDecodeThread::m_Output)
+//
+// A producer thread pushes frames like the decode thread does in CDecodeThread::Deliver, and signals an event after
+// every frame. The consumer drains the queue like ProcessOutput, and only waits on the event when it is empty.
+// Every queue type is measured with the producer running flat out, which is where contention on the queue shows,
+// and paced to 120 and 240 fps (gaming and screen capture content), where the latency from Push to Pop matters.
+
+#include "stdafx.h"
+#include <stdio.h>
+#include <limits.h>
+#include <thread>
+#include <atomic>
+
+#include "pixconv_bench.h"
+#include "SynchronizedQueue.h"
+#include "SPSCQueue.h"
+
+// Number of frames in flight before the producer waits for the consumer, like the buffers of a decoder
+#define QUEUE_BENCH_FRAMES 64
+
+template <class Queue>
+static int QueueBenchCell(FILE *out, BOOL bFirst, const char *name, int fps, LONGLONG minTime)
+{
+  Queue queue;
+  CAMEvent evSample;
+  LAVFrame frames[QUEUE_BENCH_FRAMES];
+  ZeroMemory(frames, sizeof(frames));
+
+  LARGE_INTEGER frequency, start, end;
+  QueryPerformanceFrequency(&frequency);
+
+  // Paced runs need enough frames for a meaningful latency figure
+  const LONGLONG duration = fps ? max(minTime, 1000LL) : minTime;
+  const LONGLONG total = fps ? duration * fps / 1000 : LLONG_MAX;
+  const LONGLONG frameTicks = fps ? frequency.QuadPart / fps : 0;
+
+  std::atomic<LONGLONG> received(0);
+  std::atomic<LONGLONG> sent(0);
+  std::atomic<bool> bStop(false);
+
+  QueryPerformanceCounter(&start);
+
+  std::thread producer([&]() {
+    LARGE_INTEGER now;
+    while (sent < total && !bStop.load()) {
+      // Wait for a free frame
+      while (sent - received.load() >= QUEUE_BENCH_FRAMES && !bStop.load())
+        SwitchToThread();
+
+      // Wait for the next frame to be due, Sleep is too coarse for this
+      if (fps) {
+        do {
+          SwitchToThread();
+          QueryPerformanceCounter(&now);
+        } while (now.QuadPart - start.QuadPart < sent.load() * frameTicks);
+      }
+
+      LAVFrame *pFrame = &frames[sent.load() % QUEUE_BENCH_FRAMES];
+      QueryPerformanceCounter(&now);
+      pFrame->rtStart = now.QuadPart;
+      queue.Push(pFrame);
+      evSample.Set();
+      sent++;
+
+      if (!fps && (now.QuadPart - start.QuadPart) * 1000 >= duration * frequency.QuadPart)
+        break;
+    }
+    bStop = true;
+    evSample.Set();
+  });
+
+  LONGLONG count = 0, maxLatency = 0;
+  double sumLatency = 0.0;
+  while (1) {
+    LAVFrame *pFrame = queue.Pop();
+    if (!pFrame) {
+      // The producer sets bStop after its last frame, so the frame count is final here
+      if (bStop.load() && count == sent.load())
+        break;
+      evSample.Wait(10);
+      continue;
+    }
+
+    QueryPerformanceCounter(&end);
+    const LONGLONG latency = end.QuadPart - pFrame->rtStart;
+    sumLatency += latency;
+    maxLatency = max(maxLatency, latency);
+    count++;
+    received = count;
+  }
+
+  producer.join();
+  QueryPerformanceCounter(&end);
+
+  const double seconds = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+  const double usPerTick = 1000000.0 / frequency.QuadPart;
+
+  fprintf(out, "%s    { \"queue\": \"%s\", \"fps\": %d, \"frames\": %I64d, \"frames_per_sec\": %.0f, \"avg_latency_us\": %.2f, \"max_latency_us\": %.2f }",
+          bFirst ? "" : ",\n", name, fps, count, count / seconds, count ? sumLatency * usPerTick / count : 0.0, maxLatency * usPerTick);
+  fflush(out);
+
+  return 1;
+}
+
+int RunQueueBench(FILE *out, LONGLONG minTime)
+{
+  static const int rates[] = { 0, 120, 240 };
+  int cells = 0;
+
+  fprintf(out, "{\n  \"cpu_count\": %d,\n  \"results\": [\n", av_cpu_count());
+
+  for (int i = 0; i < countof(rates); i++) {
+    cells += QueueBenchCell<CSynchronizedQueue<LAVFrame *> >(out, cells == 0, "CSynchronizedQueue", rates[i], minTime);
+    cells += QueueBenchCell<CSPSCQueue<LAVFrame *> >(out, cells == 0, "CSPSCQueue", rates[i], minTime);
+  }
+
+  fprintf(out, "\n  ]\n}\n");
+
+  return cells;
+}
@@ -118,6 +118,7 @@ typedef struct LAVFrame {
 #define LAV_FRAME_FLAG_FLUSH                0x00000004
 #define LAV_FRAME_FLAG_REDRAW               0x00000008
 #define LAV_FRAME_FLAG_DXVA_NOADDREF        0x00000010
+#define LAV_FRAME_FLAG_BUFFER_CONTIGUOUS    0x00000020  ///< all planes are in one buffer owned by the frame, which stays valid until destruct is called, even after the decoder is gone
 
   /* destruct function to free any buffers being held by this frame (may be null) */
   void  (*destruct)(struct LAVFrame *);
@@ -129,6 +130,8 @@ typedef struct LAVFrame {
  *
  * This method also fills the stride argument in the LAVFrame properly.
  * Its required that width/height and format are already set on the frame.
+ * All planes are allocated in one buffer, directly following each other, and the frame is flagged with LAV_FRAME_FLAG_BUFFER_CONTIGUOUS.
+ * The buffer is taken from a pool of buffers with the same layout, and returned to it by the destruct function (see AcquireLAVFrameBufferPools).
  *
  * @param pFrame Frame to fill
  * @param stride stride to use (in pixel). If 0, a stride will be computed to fill usual alignment rules
@@ -136,6 +139,15 @@ typedef struct LAVFrame {
  */
 HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, int stride = 0);
 
+/**
+ * Keep the buffer pools used by AllocLAVFrameBuffers alive
+ *
+ * The pools are shared by all users in the process. Every call needs to be matched with a ReleaseLAVFrameBufferPools() call,
+ * the pools are freed with the last reference. Without any reference, AllocLAVFrameBuffers allocates every buffer on its own.
+ */
+void AcquireLAVFrameBufferPools();
+void ReleaseLAVFrameBufferPools();
+
 /**
  * Destruct a LAV Frame, freeing its data pointers
  */
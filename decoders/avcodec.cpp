@@ -107,6 +107,11 @@ static DXVA2_ExtendedFormat GetDXVA2ExtendedFlags(AVCodecContext *ctx, AVFrame *
   case AVCHROMA_LOC_TOPLEFT:
     fmt.VideoChromaSubsampling = DXVA2_VideoChromaSubsampling_DV_PAL;
     break;
+  case AVCHROMA_LOC_UNSPECIFIED:
+    // JPEG chroma is centered, even if the decoder does not say so
+    if (frame->format == AV_PIX_FMT_YUVJ420P || frame->format == AV_PIX_FMT_YUVJ422P)
+      fmt.VideoChromaSubsampling = DXVA2_VideoChromaSubsampling_MPEG1;
+    break;
   }
 
   // Color Range, 0-255 or 16-235
@@ -320,7 +325,6 @@ CDecAvcodec::CDecAvcodec(void)
   , m_pFrame(NULL)
   , m_pFFBuffer(NULL), m_nFFBufferSize(0)
   , m_pFFBuffer2(NULL), m_nFFBufferSize2(0)
-  , m_pSwsContext(NULL)
   , m_nCodecId(AV_CODEC_ID_NONE)
   , m_rtStartCache(AV_NOPTS_VALUE)
   , m_bResumeAtKeyFrame(FALSE)
@@ -672,10 +676,7 @@ STDMETHODIMP CDecAvcodec::DestroyDecoder()
   av_freep(&m_pFFBuffer2);
   m_nFFBufferSize2 = 0;
 
-  if (m_pSwsContext) {
-    sws_freeContext(m_pSwsContext);
-    m_pSwsContext = NULL;
-  }
+  m_SwsContext.Release();
 
   m_nCodecId = AV_CODEC_ID_NONE;
 
@@ -1058,10 +1059,11 @@ STDMETHODIMP CDecAvcodec::ConvertPixFmt(AVFrame *pFrame, LAVFrame *pOutFrame)
   AVPixelFormat dstFormat = getFFPixelFormatFromLAV(pOutFrame->format, pOutFrame->bpp);
 
   // Get a context
-  m_pSwsContext = sws_getCachedContext(m_pSwsContext, pFrame->width, pFrame->height, (AVPixelFormat)pFrame->format, pFrame->width, pFrame->height, dstFormat, SWS_BILINEAR | SWS_PRINT_INFO, NULL, NULL, NULL);
+  SwsContext *ctx = m_SwsContext.Get(LAVSwsKey(pFrame->width, pFrame->height, (AVPixelFormat)pFrame->format, pFrame->width, pFrame->height, dstFormat, SWS_BILINEAR | SWS_PRINT_INFO));
+  CheckPointer(ctx, E_POINTER);
 
   // Perform conversion
-  sws_scale(m_pSwsContext, pFrame->data, pFrame->linesize, 0, pFrame->height, pOutFrame->data, pOutFrame->stride);
+  sws_scale(ctx, pFrame->data, pFrame->linesize, 0, pFrame->height, pOutFrame->data, pOutFrame->stride);
 
   return S_OK;
 }
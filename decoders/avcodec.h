@@ -21,6 +21,7 @@
 
 #include "DecBase.h"
 #include "H264RandomAccess.h"
+#include "LAVSwsCache.h"
 
 #include <map>
 
@@ -76,7 +77,7 @@ private:
   int                  m_nFFBufferSize;
   int                  m_nFFBufferSize2;
 
-  SwsContext           *m_pSwsContext;
+  CLAVSwsContext       m_SwsContext;
 
   CH264RandomAccess    m_h264RandomAccess;
 
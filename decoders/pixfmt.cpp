@@ -20,6 +20,8 @@
 #include "stdafx.h"
 #include "ILAVDecoder.h"
 
+#include <list>
+
 static LAVPixFmtDesc lav_pixfmt_desc[] = {
   { 1, 3, { 1, 2, 2 }, { 1, 2, 2 } },       ///< LAVPixFmt_YUV420
   { 2, 3, { 1, 2, 2 }, { 1, 2, 2 } },       ///< LAVPixFmt_YUV420bX
@@ -82,12 +84,94 @@ AVPixelFormat getFFPixelFormatFromLAV(LAVPixelFormat pixFmt, int bpp)
   return fmt;
 }
 
+// Pools of frame buffers, shared by all frames in the process
+// A buffer goes back into its pool once the last reference to it is gone, which can be long after the decoder that
+// allocated it was destroyed (see LAV_FRAME_FLAG_BUFFER_CONTIGUOUS), so the pools are not owned by any decoder.
+// There is one pool per frame layout, the least recently used one is dropped when there are too many.
+// The pools exist as long as a filter instance holds a reference (see AcquireLAVFrameBufferPools), without one
+// every buffer is allocated on its own.
+#define BUFFER_POOL_COUNT 8
+
+struct BufferPoolEntry {
+  LAVPixelFormat format;
+  int width;
+  int height;
+  int stride;
+  AVBufferPool *pPool;
+};
+
+// Most recently used pools first
+static CCritSec s_csBufferPools;
+static std::list<BufferPoolEntry> s_BufferPools;
+static int s_nBufferPoolRefs = 0;
+
+void AcquireLAVFrameBufferPools()
+{
+  CAutoLock lock(&s_csBufferPools);
+  s_nBufferPoolRefs++;
+}
+
+void ReleaseLAVFrameBufferPools()
+{
+  std::list<BufferPoolEntry> pools;
+  {
+    CAutoLock lock(&s_csBufferPools);
+    ASSERT(s_nBufferPoolRefs > 0);
+    if (--s_nBufferPoolRefs > 0)
+      return;
+    pools.swap(s_BufferPools);
+  }
+
+  // Buffers still in use free themselves when they are returned
+  for (std::list<BufferPoolEntry>::iterator it = pools.begin(); it != pools.end(); it++)
+    av_buffer_pool_uninit(&it->pPool);
+}
+
+static AVBufferRef *get_pool_buffer(LAVPixelFormat format, int width, int height, int stride, size_t size)
+{
+  AVBufferPool *pEvicted = NULL;
+  AVBufferRef *buf = NULL;
+  {
+    CAutoLock lock(&s_csBufferPools);
+    if (s_nBufferPoolRefs == 0)
+      return av_buffer_alloc((int)size);
+
+    std::list<BufferPoolEntry>::iterator it;
+    for (it = s_BufferPools.begin(); it != s_BufferPools.end(); it++) {
+      if (it->format == format && it->width == width && it->height == height && it->stride == stride)
+        break;
+    }
+
+    if (it != s_BufferPools.end()) {
+      s_BufferPools.splice(s_BufferPools.begin(), s_BufferPools, it);
+    } else {
+      DbgLog((LOG_TRACE, 10, L"get_pool_buffer(): Creating pool for %dx%d (%d), stride %d, %Iu bytes", width, height, format, stride, size));
+      BufferPoolEntry entry = { format, width, height, stride, av_buffer_pool_init((int)size, NULL) };
+      if (!entry.pPool)
+        return NULL;
+      s_BufferPools.push_front(entry);
+      if (s_BufferPools.size() > BUFFER_POOL_COUNT) {
+        pEvicted = s_BufferPools.back().pPool;
+        s_BufferPools.pop_back();
+      }
+    }
+
+    // The pool is only guaranteed to exist while the lock is held
+    buf = av_buffer_pool_get(s_BufferPools.front().pPool);
+  }
+
+  // The pool itself goes away once all of its buffers are returned
+  if (pEvicted)
+    av_buffer_pool_uninit(&pEvicted);
+
+  return buf;
+}
+
 static void free_buffers(struct LAVFrame *pFrame)
 {
-  av_freep(&pFrame->data[0]);
-  av_freep(&pFrame->data[1]);
-  av_freep(&pFrame->data[2]);
-  av_freep(&pFrame->data[3]);
+  // All planes share the buffer of the first plane, which goes back into its pool
+  AVBufferRef *buf = (AVBufferRef *)pFrame->priv_data;
+  av_buffer_unref(&buf);
 }
 
 HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, int stride)
@@ -101,16 +185,30 @@ HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, int stride)
 
   stride *= desc.codedbytes;
 
+  // Lay out the planes back to back in one buffer, like in a media sample
+  size_t planeSize[4] = {0};
+  size_t totalSize = 0;
+  for (int plane = 0; plane < desc.planes; plane++) {
+    pFrame->stride[plane] = stride / desc.planeWidth[plane];
+    // Subsampled planes of odd-sized frames have a line for the last, incomplete line pair
+    planeSize[plane] = pFrame->stride[plane] * ((pFrame->height + desc.planeHeight[plane] - 1) / desc.planeHeight[plane]);
+    totalSize += planeSize[plane];
+  }
+
   memset(pFrame->data, 0, sizeof(pFrame->data));
+  AVBufferRef *buf = get_pool_buffer(pFrame->format, pFrame->width, pFrame->height, pFrame->stride[0], totalSize + FF_INPUT_BUFFER_PADDING_SIZE);
+  if (!buf)
+    return E_OUTOFMEMORY;
+
+  BYTE *buffer = buf->data;
   for (int plane = 0; plane < desc.planes; plane++) {
-    int planeStride = stride / desc.planeWidth[plane];
-    size_t size = planeStride * (pFrame->height / desc.planeHeight[plane]);
-    pFrame->data[plane]   = (BYTE *)av_malloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
-    pFrame->stride[plane] = planeStride;
+    pFrame->data[plane] = buffer;
+    buffer += planeSize[plane];
   }
 
-  pFrame->destruct = &free_buffers;
-  pFrame->flags   |= LAV_FRAME_FLAG_BUFFER_MODIFY;
+  pFrame->destruct  = &free_buffers;
+  pFrame->priv_data = buf;
+  pFrame->flags   |= LAV_FRAME_FLAG_BUFFER_MODIFY|LAV_FRAME_FLAG_BUFFER_CONTIGUOUS;
 
   return S_OK;
 }
@@ -126,6 +224,7 @@ HRESULT FreeLAVFrameBuffers(LAVFrame *pFrame)
   }
   memset(pFrame->data, 0, sizeof(pFrame->data));
   memset(pFrame->stride, 0, sizeof(pFrame->stride));
+  pFrame->flags &= ~LAV_FRAME_FLAG_BUFFER_CONTIGUOUS;
   return S_OK;
 }
 
@@ -148,7 +247,7 @@ HRESULT CopyLAVFrame(LAVFrame *pSrc, LAVFrame **ppDst)
     BYTE *src = pSrc->data[plane];
     if (!dst || !src)
       return E_FAIL;
-    for (int i = 0; i < (pSrc->height / desc.planeHeight[plane]); i++) {
+    for (int i = 0; i < ((pSrc->height + desc.planeHeight[plane] - 1) / desc.planeHeight[plane]); i++) {
       memcpy(dst, src, linesize);
       dst += (*ppDst)->stride[plane];
       src += pSrc->stride[plane];
@@ -98,16 +98,13 @@ DECLARE_CONV_FUNC_IMPL(convert_generic)
 
 inline SwsContext *CLAVPixFmtConverter::GetSWSContext(int width, int height, enum AVPixelFormat srcPix, enum AVPixelFormat dstPix, int flags)
 {
-  if (!m_pSwsContext || swsWidth != width || swsHeight != height) {
-    // Get context
-    m_pSwsContext = sws_getCachedContext(m_pSwsContext,
-                                 width, height, srcPix,
-                                 width, height, dstPix,
-                                 flags|SWS_PRINT_INFO, NULL, NULL, NULL);
-
+  // Get context, the color space details are part of the key, so contexts from the cache are already set up
+  BOOL bNew = FALSE;
+  SwsContext *ctx = m_SwsContext.Get(LAVSwsKey(width, height, srcPix, width, height, dstPix, flags|SWS_PRINT_INFO, m_ColorProps.VideoTransferMatrix, m_ColorProps.NominalRange), &bNew);
+  if (ctx && bNew) {
     int *inv_tbl = NULL, *tbl = NULL;
     int srcRange, dstRange, brightness, contrast, saturation;
-    int ret = sws_getColorspaceDetails(m_pSwsContext, &inv_tbl, &srcRange, &tbl, &dstRange, &brightness, &contrast, &saturation);
+    int ret = sws_getColorspaceDetails(ctx, &inv_tbl, &srcRange, &tbl, &dstRange, &brightness, &contrast, &saturation);
     if (ret >= 0) {
       const int *rgbTbl = NULL;
       if (m_ColorProps.VideoTransferMatrix != DXVA2_VideoTransferMatrix_Unknown) {
@@ -129,12 +126,10 @@ inline SwsContext *CLAVPixFmtConverter::GetSWSContext(int width, int height, enu
         rgbTbl = sws_getCoefficients(isHD ? SWS_CS_ITU709 : SWS_CS_ITU601);
       }
       srcRange = dstRange = (m_ColorProps.NominalRange == DXVA2_NominalRange_0_255);
-      sws_setColorspaceDetails(m_pSwsContext, rgbTbl, srcRange, tbl, dstRange, brightness, contrast, saturation);
+      sws_setColorspaceDetails(ctx, rgbTbl, srcRange, tbl, dstRange, brightness, contrast, saturation);
     }
-    swsWidth = width;
-    swsHeight = height;
   }
-  return m_pSwsContext;
+  return ctx;
 }
 
 HRESULT CLAVPixFmtConverter::swscale_scale(enum AVPixelFormat srcPix, enum AVPixelFormat dstPix, const uint8_t* const src[], const int srcStride[], BYTE *pOut, int width, int height, int stride, LAVOutPixFmtDesc pixFmtDesc, bool swapPlanes12)
@@ -144,15 +139,32 @@ HRESULT CLAVPixFmtConverter::swscale_scale(enum AVPixelFormat srcPix, enum AVPix
   int     i, ret;
 
   SwsContext *ctx = GetSWSContext(width, height, srcPix, dstPix, SWS_BILINEAR);
-  CheckPointer(m_pSwsContext, E_POINTER);
+  CheckPointer(ctx, E_POINTER);
 
   memset(dst, 0, sizeof(dst));
   memset(dstStride, 0, sizeof(dstStride));
 
-  dst[0] = pOut;
+  // swscale writes a chroma line for the incomplete last line pair of odd heights, which the output has no room for,
+  // so those images are scaled into a temporary buffer first
+  BYTE *pTmpBuffer = NULL;
+  size_t planeSize[4] = {0}, tmpPlaneSize[4] = {0}, size = 0, tmpSize = 0;
+  for (i = 0; i < max(pixFmtDesc.planes, 1); ++i) {
+    const int planeStride = stride / pixFmtDesc.planeWidth[i];
+    planeSize[i]    = (size_t)planeStride * (height / pixFmtDesc.planeHeight[i]);
+    tmpPlaneSize[i] = (size_t)planeStride * ((height + pixFmtDesc.planeHeight[i] - 1) / pixFmtDesc.planeHeight[i]);
+    size += planeSize[i];
+    tmpSize += tmpPlaneSize[i];
+  }
+  if (tmpSize != size) {
+    pTmpBuffer = (BYTE *)av_malloc(tmpSize);
+    if (!pTmpBuffer)
+      return E_OUTOFMEMORY;
+  }
+
+  dst[0] = pTmpBuffer ? pTmpBuffer : pOut;
   dstStride[0] = stride;
   for (i = 1; i < pixFmtDesc.planes; ++i) {
-    dst[i] = dst[i-1] + (stride / pixFmtDesc.planeWidth[i-1]) * (height / pixFmtDesc.planeHeight[i-1]);
+    dst[i] = dst[i-1] + (pTmpBuffer ? tmpPlaneSize[i-1] : planeSize[i-1]);
     dstStride[i] = stride / pixFmtDesc.planeWidth[i];
   }
 
@@ -163,6 +175,16 @@ HRESULT CLAVPixFmtConverter::swscale_scale(enum AVPixelFormat srcPix, enum AVPix
   }
   ret = sws_scale(ctx, src, srcStride, 0, height, dst, dstStride);
 
+  if (pTmpBuffer) {
+    const BYTE *tmp = pTmpBuffer;
+    for (i = 0; i < pixFmtDesc.planes; ++i) {
+      memcpy(pOut, tmp, planeSize[i]);
+      pOut += planeSize[i];
+      tmp += tmpPlaneSize[i];
+    }
+    av_freep(&pTmpBuffer);
+  }
+
   return S_OK;
 }
 
@@ -212,7 +234,7 @@ HRESULT CLAVPixFmtConverter::ConvertTo422Packed(const uint8_t* const src[4], con
 #define YUV422_PACK_UYVY(offset) *idst++ = u[i+offset] | (y[(i+offset) * 2] << 8) | (v[i+offset] << 16) | (y[(i+offset) * 2 + 1] << 24);
 
   BYTE *out = pOut;
-  int halfwidth = width >> 1;
+  int halfwidth = (width + 1) >> 1;
   int halfstride = sourceStride >> 1;
 
   if (m_OutputPixFmt == LAVOutPixFmt_YUY2) {
@@ -356,7 +378,7 @@ HRESULT CLAVPixFmtConverter::ConvertToPX1X(const uint8_t* const src[4], const in
 
     dst[0] = pTmpBuffer;
     dst[1] = dst[0] + (height * scaleStride);
-    dst[2] = dst[1] + ((height / chromaVertical) * (scaleStride / 2));
+    dst[2] = dst[1] + (((height + chromaVertical - 1) / chromaVertical) * (scaleStride / 2));
     dst[3] = NULL;
     dstStride[0] = scaleStride;
     dstStride[1] = scaleStride / 2;
@@ -406,7 +428,7 @@ HRESULT CLAVPixFmtConverter::ConvertToPX1X(const uint8_t* const src[4], const in
   const int16_t *vc = (int16_t *)v;
   for (line = 0; line < height/chromaVertical; ++line) {
     int32_t *idst = (int32_t *)out;
-    for (i = 0; i < width/2; ++i) {
+    for (i = 0; i < (width + 1)/2; ++i) {
       int32_t uv = AV_RL16(uc+i);
       int32_t vv = AV_RL16(vc+i);
       if (shift) {
@@ -621,6 +643,7 @@ HRESULT CLAVPixFmtConverter::ConvertTov210(const uint8_t* const src[4], const in
     *p++ = val;                     \
   } while (0)
 
+  const int16_t *yLine = y, *uLine = u, *vLine = v;
   for (int h = 0; h < height; h++) {
     uint32_t val;
     for (w = 0; w < width - 5; w += 6) {
@@ -629,27 +652,35 @@ HRESULT CLAVPixFmtConverter::ConvertTov210(const uint8_t* const src[4], const in
       WRITE_PIXELS(v, y, u);
       WRITE_PIXELS(y, v, y);
     }
-    if (w < width - 1) {
-      WRITE_PIXELS(u, y, v);
 
-      val = CLIP(*y++);
-      if (w == width - 2)
-        *p++ = val;
-      if (w < width - 3) {
-        val |= (CLIP(*u++) << 10) | (CLIP(*y++) << 20);
+    // Incomplete last group, only the words holding a pixel are written
+    const int left = width - w;
+    if (left > 0) {
+      WRITE_PIXELS(u, y, v);
+      if (left > 1) {
+        val = CLIP(y[0]);
+        if (left > 2)
+          val |= (CLIP(u[0]) << 10) | (CLIP(y[1]) << 20);
         *p++ = val;
-
-        val = CLIP(*v++) | (CLIP(*y++) << 10);
+      }
+      if (left > 2) {
+        val = CLIP(v[0]);
+        if (left > 3)
+          val |= (CLIP(y[2]) << 10);
+        if (left > 4)
+          val |= (CLIP(u[1]) << 20);
         *p++ = val;
       }
+      if (left > 4)
+        *p++ = CLIP(y[3]) | (CLIP(v[1]) << 10);
     }
 
     pdst += dstStride;
     memset(p, 0, pdst - (BYTE *)p);
     p = (int32_t *)pdst;
-    y += srcyStride - width;
-    u += srcuvStride - (width >> 1);
-    v += srcuvStride - (width >> 1);
+    y = (yLine += srcyStride);
+    u = (uLine += srcuvStride);
+    v = (vLine += srcuvStride);
   }
   av_freep(&pTmpBuffer);
 
@@ -41,10 +41,15 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_y410)
   xmm7 = _mm_set1_epi32(0xC0000000);
   xmm6 = _mm_setzero_si128();
 
+  y += inStride * sliceYStart;
+  u += inStride * sliceYStart;
+  v += inStride * sliceYStart;
+
   _mm_sfence();
 
-  for (line = 0; line < height; ++line) {
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
     __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 2);
 
     for (i = 0; i < width; i+=8) {
       PIXCONV_LOAD_PIXEL8_ALIGNED(xmm0, (y+i));
@@ -68,8 +73,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_y410)
       xmm4 = _mm_or_si128(xmm4, xmm2);       // AVVVVVYYYYYUUUUU
 
       // Write data back
-      _mm_stream_si128(dst128++, xmm3);
-      _mm_stream_si128(dst128++, xmm4);
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm4);
     }
 
     y += inStride;
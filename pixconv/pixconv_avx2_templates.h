@@ -0,0 +1,83 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <immintrin.h>
+
+// Load the dithering coefficients for this line into both lanes of a 256-bit register
+// reg   - register to load coefficients into
+// line  - index of line to process (0 based)
+// bits  - number of bits to dither (for 10 -> 8, set to 2)
+#define PIXCONV_LOAD_DITHER_COEFFS_AVX2(reg,line,bits,name)                  \
+  const uint16_t *name = dither_8x8_256[(line) % 8];                         \
+  reg = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)name));  \
+  reg = _mm256_srli_epi16(reg, 8-bits); /* shift to the required dithering strength */
+
+// Load 4 8-bit pixels each of two neighbouring blocks into the low and the high 128-bit lane
+// reg   - register to store pixels in
+// src   - memory pointer of the first block
+// next  - distance of the second block, in bytes
+#define PIXCONV_LOAD_4PIXEL8_X2_AVX2(reg,src,next)                                                      \
+  reg = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_cvtsi32_si128(*(const int*)(src))),         \
+                                _mm_cvtsi32_si128(*(const int*)((src)+(next))), 1);
+
+// Load 4 16-bit pixels each of two neighbouring blocks into the low and the high 128-bit lane
+// reg   - register to store pixels in
+// src   - memory pointer of the first block
+// next  - distance of the second block, in bytes
+#define PIXCONV_LOAD_4PIXEL16_X2_AVX2(reg,src,next)                                                     \
+  reg = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)(src))),       \
+                                _mm_loadl_epi64((const __m128i *)((src)+(next))), 1);
+
+// Load 16 16-bit pixels into a register
+// reg   - register to store pixels in
+// src   - memory pointer of the source
+// bpp   - bit depth of the pixels
+#define PIXCONV_LOAD_PIXEL16_AVX2(reg,src,bpp)                                  \
+  reg = _mm256_loadu_si256((const __m256i *)(src)); /* load (unaligned) */      \
+  reg = _mm256_slli_epi16(reg, 16-bpp);             /* shift to 16-bit */
+
+// Load 16 16-bit pixels into a register, and dither them to 8 bit
+// The 8-bit pixels will be in the low-bytes of the 16 16-bit parts
+// reg   - register to store pixels in
+// dreg  - register with dithering coefficients
+// src   - memory pointer of the source
+// bpp   - bit depth of the pixels
+#define PIXCONV_LOAD_PIXEL16_DITHER_AVX2(reg,dreg,src,bpp)   \
+  PIXCONV_LOAD_PIXEL16_AVX2(reg,src,bpp)                     \
+  reg = _mm256_adds_epu16(reg, dreg);           /* dither */ \
+  reg = _mm256_srli_epi16(reg, 8);              /* shift to 8-bit */
+
+// Pack two registers of 16-bit values into one register of 8-bit values, in source order
+// packus works per 128-bit lane, the permute restores linear order afterwards
+// reg   - first register, receives the result
+// reg2  - second register
+#define PIXCONV_PACKUS_EPI16_AVX2(reg,reg2)                  \
+  reg = _mm256_packus_epi16(reg, reg2);                      \
+  reg = _mm256_permute4x64_epi64(reg, _MM_SHUFFLE(3,1,2,0));
+
+// Store a 256-bit register into a line of the destination, in two 128-bit halves
+// See pixconv_put_stream for the handling of unaligned memory and the end of the line
+// dst128 - __m128i pointer to the destination, will be advanced by two
+// end    - end of the line (first byte that must not be written)
+// reg    - register to store
+#define PIXCONV_PUT_STREAM_AVX2(dst128,end,reg)                        \
+  PIXCONV_PUT_STREAM(dst128, end, _mm256_castsi256_si128(reg));        \
+  PIXCONV_PUT_STREAM(dst128, end, _mm256_extracti128_si256(reg, 1));
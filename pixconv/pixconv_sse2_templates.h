@@ -95,7 +95,51 @@
 #define PIXCONV_LOAD_4PIXEL16(reg,src) \
    reg = _mm_loadl_epi64((const __m128i *)(src)); /* load 64-bit (4 pixel) */
 
-// SSE2 Aligned memcpy
+// Load 16 YUY2 pixels (32 bytes), and split them into luma and chroma
+// y     - register to receive Y0-Y15
+// uv    - register to receive the 8 chroma pairs, U0 V0 U1 V1 ... U7 V7
+// mask  - register with 0x00FF in every 16-bit word
+// src   - memory pointer of the first pixel
+#define PIXCONV_LOAD_YUY2_SPLIT(y,uv,mask,src)                                            \
+  {                                                                                       \
+    __m128i yuy2lo = _mm_loadu_si128((const __m128i *)(src));                             \
+    __m128i yuy2hi = _mm_loadu_si128((const __m128i *)(src) + 1);                         \
+    y  = _mm_packus_epi16(_mm_and_si128(yuy2lo, mask), _mm_and_si128(yuy2hi, mask));      \
+    uv = _mm_packus_epi16(_mm_srli_epi16(yuy2lo, 8), _mm_srli_epi16(yuy2hi, 8));          \
+  }
+
+// Store 128-bit into a line of the destination
+// With bStream, aligned memory is written with a non-temporal store, which bypasses the cache. Otherwise, and for
+// unaligned memory, a regular store is used.
+// A store that would reach past the end of the line is truncated, so the destination needs no padding.
+// dst     - memory destination
+// end     - end of the line (first byte that must not be written)
+// reg     - register to store
+// bStream - use non-temporal stores (see CLAVPixFmtConverter::UseStreamingStores)
+static __forceinline void pixconv_put_stream(__m128i *dst, const uint8_t *end, __m128i reg, BOOL bStream)
+{
+  const ptrdiff_t left = end - (const uint8_t *)dst;
+  if (left >= 16) {
+    if (bStream && ((uintptr_t)dst & 15) == 0)
+      _mm_stream_si128(dst, reg);
+    else
+      _mm_storeu_si128(dst, reg);
+  } else if (left > 0) {
+    DECLARE_ALIGNED(16, uint8_t, buf)[16];
+    _mm_store_si128((__m128i *)buf, reg);
+    memcpy(dst, buf, left);
+  }
+}
+
+// Store 128-bit into a line of the destination, and advance the pointer
+// Only usable in converter functions, which select the store type of the frame with m_bStreamingStores
+// dst - __m128i pointer to the destination, will be advanced by one
+// end - end of the line (first byte that must not be written)
+// reg - register to store
+#define PIXCONV_PUT_STREAM(dst,end,reg) \
+  pixconv_put_stream((dst)++, (const uint8_t *)(end), reg, m_bStreamingStores);
+
+// SSE2 memcpy from aligned memory
 // dst - memory destination
 // src - memory source
 // len - size in bytes
@@ -103,13 +147,14 @@
   {                                             \
     __m128i reg;                                \
     __m128i *dst128 =  (__m128i *)(dst);        \
+    const uint8_t *end = (const uint8_t *)(dst) + (len); \
     for (int i = 0; i < len; i+=16) {           \
       PIXCONV_LOAD_PIXEL8_ALIGNED(reg,(src)+i); \
-      _mm_stream_si128(dst128++, reg);          \
+      PIXCONV_PUT_STREAM(dst128, end, reg);     \
     }                                           \
   }
 
-// SSE2 Aligned memcpy (for 32-bit aligned data)
+// SSE2 memcpy from aligned memory (for 32-bit aligned data)
 // dst - memory destination
 // src - memory source
 // len - size in bytes
@@ -117,15 +162,16 @@
   {                                              \
     __m128i reg1,reg2;                           \
     __m128i *dst128 =  (__m128i *)(dst);         \
+    const uint8_t *end = (const uint8_t *)(dst) + (len); \
     for (int i = 0; i < len; i+=32) {            \
       PIXCONV_LOAD_PIXEL8_ALIGNED(reg1,(src)+i); \
       PIXCONV_LOAD_PIXEL8_ALIGNED(reg2,(src)+i+16); \
-      _mm_stream_si128(dst128++, reg1);          \
-      _mm_stream_si128(dst128++, reg2);          \
+      PIXCONV_PUT_STREAM(dst128, end, reg1);     \
+      PIXCONV_PUT_STREAM(dst128, end, reg2);     \
     }                                            \
   }
 
-// SSE2 Aligned memcpy
+// SSE2 memcpy from aligned memory
 // Copys the same size from two source into two destinations at the same time
 // Can be useful to copy U/V planes in one go
 // dst1 - memory destination
@@ -138,10 +184,12 @@
     __m128i reg1,reg2;                            \
     __m128i *dst128_1 =  (__m128i *)(dst1);       \
     __m128i *dst128_2 =  (__m128i *)(dst2);       \
+    const uint8_t *end1 = (const uint8_t *)(dst1) + (len); \
+    const uint8_t *end2 = (const uint8_t *)(dst2) + (len); \
     for (int i = 0; i < len; i+=16) {             \
       PIXCONV_LOAD_PIXEL8_ALIGNED(reg1,(src1)+i); \
       PIXCONV_LOAD_PIXEL8_ALIGNED(reg2,(src2)+i); \
-      _mm_stream_si128(dst128_1++, reg1);         \
-      _mm_stream_si128(dst128_2++, reg2);         \
+      PIXCONV_PUT_STREAM(dst128_1, end1, reg1);   \
+      PIXCONV_PUT_STREAM(dst128_2, end2, reg2);   \
     }                                             \
   }
@@ -24,26 +24,203 @@
 #include "pixconv_internal.h"
 #include "pixconv_sse2_templates.h"
 
-DECLARE_CONV_FUNC_IMPL(convert_rgb48_rgb32_ssse3)
+// Pack four registers of BGRA (4 pixels each) into 48 bytes of BGR
+#define PIXCONV_PACK_BGR24(p0,p1,p2,p3) {                                        \
+  const __m128i mask24 = _mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);  \
+  p0 = _mm_shuffle_epi8(p0, mask24);                                             \
+  p1 = _mm_shuffle_epi8(p1, mask24);                                             \
+  p2 = _mm_shuffle_epi8(p2, mask24);                                             \
+  p3 = _mm_shuffle_epi8(p3, mask24);                                             \
+  p0 = _mm_or_si128(p0, _mm_slli_si128(p1, 12));                                 \
+  p1 = _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8));               \
+  p2 = _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4));               \
+}
+
+// Load 16 pixels of 8-bit RGB as four registers of BGRA
+// RGB24 and RGB32 have no (valid) alpha, and are made opaque
+template <LAVPixelFormat inputFormat>
+static __forceinline void rgb8_load_bgra(const uint8_t *src, __m128i &p0, __m128i &p1, __m128i &p2, __m128i &p3)
 {
-  const uint16_t *rgb = (const uint16_t *)src[0];
-  const ptrdiff_t inStride = srcStride[0] >> 1;
-  const ptrdiff_t outStride = dstStride * 4;
-  ptrdiff_t line, i;
+  const __m128i alpha = _mm_set1_epi32(0xFF000000);
+  if (inputFormat == LAVPixFmt_RGB24) {
+    const __m128i mask = _mm_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    __m128i a = _mm_loadu_si128((const __m128i *)(src +  0));
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+    __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+    p0 = _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha);
+    p1 = _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha);
+    p2 = _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), alpha);
+    p3 = _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), alpha);
+  } else {
+    p0 = _mm_loadu_si128((const __m128i *)(src +  0));
+    p1 = _mm_loadu_si128((const __m128i *)(src + 16));
+    p2 = _mm_loadu_si128((const __m128i *)(src + 32));
+    p3 = _mm_loadu_si128((const __m128i *)(src + 48));
+    if (inputFormat == LAVPixFmt_RGB32) {
+      p0 = _mm_or_si128(p0, alpha);
+      p1 = _mm_or_si128(p1, alpha);
+      p2 = _mm_or_si128(p2, alpha);
+      p3 = _mm_or_si128(p3, alpha);
+    }
+  }
+}
+
+// Multiply the colors of 4 BGRA pixels with their alpha, the alpha itself is kept
+static __forceinline __m128i rgb8_premultiply(__m128i p)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(128);
+  const __m128i amask = _mm_set1_epi32(0xFF000000);
+
+  __m128i lo = _mm_unpacklo_epi8(p, zero);
+  __m128i hi = _mm_unpackhi_epi8(p, zero);
+  __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+  __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+
+  // c * a / 255, rounded: (x + 128 + ((x + 128) >> 8)) >> 8
+  lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), round);
+  hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), round);
+  lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+  hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+  return _mm_or_si128(_mm_andnot_si128(amask, _mm_packus_epi16(lo, hi)), _mm_and_si128(amask, p));
+}
+
+// Conversion between the 8-bit RGB formats, and from them to RGB48
+template <LAVPixelFormat inputFormat, LAVOutPixFmts outputFormat, int premultiply>
+static void rgb8_convert(const uint8_t *src, ptrdiff_t srcStride, uint8_t *dst, ptrdiff_t dstStride, int width, int sliceYStart, int sliceYEnd, BOOL bStream)
+{
+  const int inBytes = (inputFormat == LAVPixFmt_RGB24) ? 3 : 4;
+  const int outBytes = (outputFormat == LAVOutPixFmt_RGB24) ? 3 : (outputFormat == LAVOutPixFmt_RGB32) ? 4 : 6;
+  const ptrdiff_t outStride = dstStride * outBytes;
+  // The last pixels of a line are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint8_t, tail)[16 * 4];
+
+  __m128i p0,p1,p2,p3;
+
+  _mm_sfence();
+  for (ptrdiff_t line = sliceYStart; line < sliceYEnd; line++) {
+    const uint8_t *rgb = src + line * srcStride;
+    __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + width * outBytes;
+
+    for (int i = 0; i < width; i += 16) {
+      const uint8_t *in = rgb + i * inBytes;
+      if (width - i < 16) {
+        memcpy(tail, in, (width - i) * inBytes);
+        in = tail;
+      }
+
+      rgb8_load_bgra<inputFormat>(in, p0, p1, p2, p3);
+      if (premultiply) {
+        p0 = rgb8_premultiply(p0);
+        p1 = rgb8_premultiply(p1);
+        p2 = rgb8_premultiply(p2);
+        p3 = rgb8_premultiply(p3);
+      }
+
+      if (outputFormat == LAVOutPixFmt_RGB32) {
+        pixconv_put_stream(dst128++, end, p0, bStream);
+        pixconv_put_stream(dst128++, end, p1, bStream);
+        pixconv_put_stream(dst128++, end, p2, bStream);
+        pixconv_put_stream(dst128++, end, p3, bStream);
+      } else if (outputFormat == LAVOutPixFmt_RGB24) {
+        PIXCONV_PACK_BGR24(p0, p1, p2, p3);
+        pixconv_put_stream(dst128++, end, p0, bStream);
+        pixconv_put_stream(dst128++, end, p1, bStream);
+        pixconv_put_stream(dst128++, end, p2, bStream);
+      } else {
+        // RGB48: expand to 16-bit (v * 257), and swap to RGB order, two pixels in 12 bytes
+        const __m128i mask48 = _mm_setr_epi8(4,5,2,3,0,1,12,13,10,11,8,9,-1,-1,-1,-1);
+        __m128i q0 = _mm_shuffle_epi8(_mm_unpacklo_epi8(p0, p0), mask48);
+        __m128i q1 = _mm_shuffle_epi8(_mm_unpackhi_epi8(p0, p0), mask48);
+        __m128i q2 = _mm_shuffle_epi8(_mm_unpacklo_epi8(p1, p1), mask48);
+        __m128i q3 = _mm_shuffle_epi8(_mm_unpackhi_epi8(p1, p1), mask48);
+        pixconv_put_stream(dst128++, end, _mm_or_si128(q0, _mm_slli_si128(q1, 12)), bStream);
+        pixconv_put_stream(dst128++, end, _mm_or_si128(_mm_srli_si128(q1, 4), _mm_slli_si128(q2, 8)), bStream);
+        pixconv_put_stream(dst128++, end, _mm_or_si128(_mm_srli_si128(q2, 8), _mm_slli_si128(q3, 4)), bStream);
+        q0 = _mm_shuffle_epi8(_mm_unpacklo_epi8(p2, p2), mask48);
+        q1 = _mm_shuffle_epi8(_mm_unpackhi_epi8(p2, p2), mask48);
+        q2 = _mm_shuffle_epi8(_mm_unpacklo_epi8(p3, p3), mask48);
+        q3 = _mm_shuffle_epi8(_mm_unpackhi_epi8(p3, p3), mask48);
+        pixconv_put_stream(dst128++, end, _mm_or_si128(q0, _mm_slli_si128(q1, 12)), bStream);
+        pixconv_put_stream(dst128++, end, _mm_or_si128(_mm_srli_si128(q1, 4), _mm_slli_si128(q2, 8)), bStream);
+        pixconv_put_stream(dst128++, end, _mm_or_si128(_mm_srli_si128(q2, 8), _mm_slli_si128(q3, 4)), bStream);
+      }
+    }
+  }
+}
+
+template <LAVPixelFormat inputFormat, int premultiply>
+static void rgb8_convert_dispatch(LAVOutPixFmts outputFormat, const uint8_t *src, ptrdiff_t srcStride, uint8_t *dst, ptrdiff_t dstStride, int width, int sliceYStart, int sliceYEnd, BOOL bStream)
+{
+  switch (outputFormat) {
+  case LAVOutPixFmt_RGB24:
+    rgb8_convert<inputFormat, LAVOutPixFmt_RGB24, premultiply>(src, srcStride, dst, dstStride, width, sliceYStart, sliceYEnd, bStream);
+    break;
+  case LAVOutPixFmt_RGB32:
+    rgb8_convert<inputFormat, LAVOutPixFmt_RGB32, premultiply>(src, srcStride, dst, dstStride, width, sliceYStart, sliceYEnd, bStream);
+    break;
+  case LAVOutPixFmt_RGB48:
+    rgb8_convert<inputFormat, LAVOutPixFmt_RGB48, premultiply>(src, srcStride, dst, dstStride, width, sliceYStart, sliceYEnd, bStream);
+    break;
+  default:
+    ASSERT(0);
+  }
+}
 
-  int processWidth = width * 3;
+DECLARE_CONV_FUNC_IMPL(convert_rgb8_rgb_ssse3)
+{
+  // Only ARGB32 has an alpha channel to premultiply with
+  const BOOL bPremultiply = (inputFormat == LAVPixFmt_ARGB32) && m_pSettings->GetRGBPremultiplyAlpha();
+  if (inputFormat == LAVPixFmt_ARGB32 && outputFormat == LAVOutPixFmt_RGB32 && !bPremultiply)
+    return plane_copy(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
+
+  switch (inputFormat) {
+  case LAVPixFmt_RGB24:
+    rgb8_convert_dispatch<LAVPixFmt_RGB24, 0>(outputFormat, src[0], srcStride[0], dst, dstStride, width, sliceYStart, sliceYEnd, m_bStreamingStores);
+    break;
+  case LAVPixFmt_RGB32:
+    rgb8_convert_dispatch<LAVPixFmt_RGB32, 0>(outputFormat, src[0], srcStride[0], dst, dstStride, width, sliceYStart, sliceYEnd, m_bStreamingStores);
+    break;
+  case LAVPixFmt_ARGB32:
+    if (bPremultiply)
+      rgb8_convert_dispatch<LAVPixFmt_ARGB32, 1>(outputFormat, src[0], srcStride[0], dst, dstStride, width, sliceYStart, sliceYEnd, m_bStreamingStores);
+    else
+      rgb8_convert_dispatch<LAVPixFmt_ARGB32, 0>(outputFormat, src[0], srcStride[0], dst, dstStride, width, sliceYStart, sliceYEnd, m_bStreamingStores);
+    break;
+  default:
+    ASSERT(0);
+    return E_FAIL;
+  }
+
+  return S_OK;
+}
+
+template <int out32>
+DECLARE_CONV_FUNC_IMPL(convert_rgb48_rgb_ssse3)
+{
+  const ptrdiff_t inStride = srcStride[0];
+  const ptrdiff_t outStride = dstStride * (out32 ? 4 : 3);
+  ptrdiff_t line, i;
+  // The last pixels of a line are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint8_t, tail)[16 * 6];
 
   LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
   const uint16_t *dithers = GetRandomDitherCoeffs(height, 4, 8, 0);
   if (dithers == NULL)
     ditherMode = LAVDither_Ordered;
 
-  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
-  __m128i mask = _mm_setr_epi8(4,5,2,3,0,1,-1,-1,10,11,8,9,6,7,-1,-1);
+  __m128i xmm0,xmm1,xmm2,xmm5,xmm6,xmm7;
+  __m128i p[4];
+  const __m128i mask = _mm_setr_epi8(4,5,2,3,0,1,-1,-1,10,11,8,9,6,7,-1,-1);
+  const __m128i alpha = _mm_set1_epi32(0xFF000000);
 
   _mm_sfence();
-  for (line = 0; line < height; line++) {
+  for (line = sliceYStart; line < sliceYEnd; line++) {
+    const uint8_t *rgb = src[0] + line * inStride;
     __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + width * (out32 ? 4 : 3);
 
     // Load dithering coefficients for this line
     if (ditherMode == LAVDither_Random) {
@@ -54,71 +231,82 @@ DECLARE_CONV_FUNC_IMPL(convert_rgb48_rgb32_ssse3)
       PIXCONV_LOAD_DITHER_COEFFS(xmm7,line,8,dithers);
       xmm5 = xmm6 = xmm7;
     }
-    for (i = 0; i < processWidth; i += 24) {
-      PIXCONV_LOAD_ALIGNED(xmm0, (rgb + i));      /* load */
-      PIXCONV_LOAD_ALIGNED(xmm1, (rgb + i + 8));
-      PIXCONV_LOAD_ALIGNED(xmm2, (rgb + i + 16));
-      _mm_adds_epu16(xmm0, xmm5);                 /* apply dithering coefficients */
-      _mm_adds_epu16(xmm1, xmm6);
-      _mm_adds_epu16(xmm2, xmm7);
-      xmm0 = _mm_srli_epi16(xmm0, 8);             /* shift to 8-bit */
-      xmm1 = _mm_srli_epi16(xmm1, 8);
-      xmm2 = _mm_srli_epi16(xmm2, 8);
-
-      xmm3 = _mm_shuffle_epi8(xmm0, mask);
-      xmm4 = _mm_shuffle_epi8(_mm_alignr_epi8(xmm1, xmm0, 12), mask);
-      xmm0 = _mm_shuffle_epi8(_mm_alignr_epi8(xmm2, xmm1, 8),  mask);
-      xmm1 = _mm_shuffle_epi8(_mm_alignr_epi8(xmm2, xmm2, 4),  mask);
-      
-      xmm3 = _mm_packus_epi16(xmm3, xmm4);
-      xmm0 = _mm_packus_epi16(xmm0, xmm1);
 
-      _mm_stream_si128(dst128++, xmm3);
-      _mm_stream_si128(dst128++, xmm0);
-    }
+    for (i = 0; i < width; i += 16) {
+      const uint8_t *in = rgb + i * 6;
+      if (width - i < 16) {
+        memcpy(tail, in, (width - i) * 6);
+        in = tail;
+      }
 
-    rgb += inStride;
+      // Two times 8 pixels in 3 registers
+      for (int half = 0; half < 2; half++) {
+        xmm0 = _mm_loadu_si128((const __m128i *)(in + half * 48 +  0));
+        xmm1 = _mm_loadu_si128((const __m128i *)(in + half * 48 + 16));
+        xmm2 = _mm_loadu_si128((const __m128i *)(in + half * 48 + 32));
+        xmm0 = _mm_adds_epu16(xmm0, xmm5);        /* apply dithering coefficients */
+        xmm1 = _mm_adds_epu16(xmm1, xmm6);
+        xmm2 = _mm_adds_epu16(xmm2, xmm7);
+        xmm0 = _mm_srli_epi16(xmm0, 8);           /* shift to 8-bit */
+        xmm1 = _mm_srli_epi16(xmm1, 8);
+        xmm2 = _mm_srli_epi16(xmm2, 8);
+
+        // Swap to BGR order, two pixels per register
+        __m128i a = _mm_shuffle_epi8(xmm0, mask);
+        __m128i b = _mm_shuffle_epi8(_mm_alignr_epi8(xmm1, xmm0, 12), mask);
+        __m128i c = _mm_shuffle_epi8(_mm_alignr_epi8(xmm2, xmm1, 8), mask);
+        __m128i d = _mm_shuffle_epi8(_mm_srli_si128(xmm2, 4), mask);
+        p[half * 2 + 0] = _mm_or_si128(_mm_packus_epi16(a, b), alpha);
+        p[half * 2 + 1] = _mm_or_si128(_mm_packus_epi16(c, d), alpha);
+      }
+
+      if (out32) {
+        PIXCONV_PUT_STREAM(dst128, end, p[0]);
+        PIXCONV_PUT_STREAM(dst128, end, p[1]);
+        PIXCONV_PUT_STREAM(dst128, end, p[2]);
+        PIXCONV_PUT_STREAM(dst128, end, p[3]);
+      } else {
+        PIXCONV_PACK_BGR24(p[0], p[1], p[2], p[3]);
+        PIXCONV_PUT_STREAM(dst128, end, p[0]);
+        PIXCONV_PUT_STREAM(dst128, end, p[1]);
+        PIXCONV_PUT_STREAM(dst128, end, p[2]);
+      }
+    }
   }
 
   return S_OK;
 }
 
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_rgb48_rgb_ssse3<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_rgb48_rgb_ssse3<1>CONV_FUNC_PARAMS;
+
 template <int out32>
 DECLARE_CONV_FUNC_IMPL(convert_rgb48_rgb)
 {
-  // Byte Swap to BGR layout
-  uint8_t *dstBS[4]    = {NULL};
-  dstBS[0] = (BYTE *)av_malloc(height * srcStride[0]);
-
-  SwsContext *ctx = GetSWSContext(width, height, GetFFInput(), AV_PIX_FMT_BGR48LE, SWS_POINT);
-  sws_scale(ctx, src, srcStride, 0, height, dstBS, srcStride);
-
-  // Dither to RGB24/32 with SSE2
-  const uint16_t *rgb = (const uint16_t *)dstBS[0];
-  const ptrdiff_t inStride = srcStride[0] >> 1;
+  const ptrdiff_t inStride = srcStride[0];
   const ptrdiff_t outStride = dstStride * (out32 ? 4 : 3);
+  const int processWidth = width * 3;
   ptrdiff_t line, i;
-  int processWidth = width * 3;
+  // The last samples of a line are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint16_t, tail)[16];
 
   LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
   const uint16_t *dithers = GetRandomDitherCoeffs(height, 2, 8, 0);
   if (dithers == NULL)
     ditherMode = LAVDither_Ordered;
 
+  // Dither to RGB24 with SSE2 into a line buffer, and swap to BGR while writing the output
+  const size_t bufferSize = FFALIGN(processWidth, 16);
+  uint8_t *rgb24buffer = AcquireScratchBuffer(bufferSize);
+  if (!rgb24buffer)
+    return E_OUTOFMEMORY;
+
   __m128i xmm0,xmm1,xmm6,xmm7;
 
-  uint8_t *rgb24buffer = NULL;
-  if (out32)
-    rgb24buffer = (uint8_t *)av_malloc(outStride + FF_INPUT_BUFFER_PADDING_SIZE);
-
-  _mm_sfence();
-  for (line = 0; line < height; line++) {
-    __m128i *dst128 = NULL;
-    if (out32) {
-      dst128 = (__m128i *)rgb24buffer;
-    } else {
-      dst128 = (__m128i *)(dst + line * outStride);
-    }
+  for (line = sliceYStart; line < sliceYEnd; line++) {
+    const uint16_t *rgb = (const uint16_t *)(src[0] + line * inStride);
+    __m128i *dst128 = (__m128i *)rgb24buffer;
 
     // Load dithering coefficients for this line
     if (ditherMode == LAVDither_Random) {
@@ -129,39 +317,36 @@ DECLARE_CONV_FUNC_IMPL(convert_rgb48_rgb)
       xmm6 = xmm7;
     }
     for (i = 0; i < processWidth; i += 16) {
-      PIXCONV_LOAD_ALIGNED(xmm0, (rgb + i));      /* load */
-      PIXCONV_LOAD_ALIGNED(xmm1, (rgb + i + 8));
-      _mm_adds_epu16(xmm0, xmm6);                 /* apply dithering coefficients */
-      _mm_adds_epu16(xmm1, xmm7);
+      const uint16_t *in = rgb + i;
+      if (processWidth - i < 16) {
+        memcpy(tail, in, (processWidth - i) * 2);
+        in = tail;
+      }
+      xmm0 = _mm_loadu_si128((const __m128i *)(in + 0)); /* load */
+      xmm1 = _mm_loadu_si128((const __m128i *)(in + 8));
+      xmm0 = _mm_adds_epu16(xmm0, xmm6);          /* apply dithering coefficients */
+      xmm1 = _mm_adds_epu16(xmm1, xmm7);
       xmm0 = _mm_srli_epi16(xmm0, 8);             /* shift to 8-bit */
       xmm1 = _mm_srli_epi16(xmm1, 8);
 
       xmm0 = _mm_packus_epi16(xmm0, xmm1);
-      _mm_stream_si128(dst128++, xmm0);
+      _mm_store_si128(dst128++, xmm0);
     }
 
-    rgb += inStride;
-    if (out32) {
-      uint32_t *src24 = (uint32_t *)rgb24buffer;
-      uint32_t *dst32 = (uint32_t *)(dst + line * outStride);
-      for (i = 0; i < width; i += 4) {
-        uint32_t sa = src24[0];
-        uint32_t sb = src24[1];
-        uint32_t sc = src24[2];
-
-        dst32[i+0] = sa;
-        dst32[i+1] = (sa>>24) | (sb<<8);
-        dst32[i+2] = (sb>>16) | (sc<<16);
-        dst32[i+3] = sc>>8;
-
-        src24 += 3;
-      }
+    const uint8_t *src24 = rgb24buffer;
+    uint8_t *out = dst + line * outStride;
+    for (i = 0; i < width; i++) {
+      out[0] = src24[2];
+      out[1] = src24[1];
+      out[2] = src24[0];
+      if (out32)
+        out[3] = 0xFF;
+      src24 += 3;
+      out += out32 ? 4 : 3;
     }
   }
 
-  if (out32)
-    av_freep(&rgb24buffer);
-  av_freep(&dstBS[0]);
+  ReleaseScratchBuffer(rgb24buffer, bufferSize);
 
   return S_OK;
 }
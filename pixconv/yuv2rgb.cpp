@@ -20,7 +20,6 @@
 #include "stdafx.h"
 
 #include <emmintrin.h>
-#include <ppl.h>
 
 #include "pixconv_internal.h"
 #include "pixconv_sse2_templates.h"
@@ -28,576 +27,21 @@
 #pragma warning(push)
 #pragma warning(disable: 4556)
 
-#define DITHER_STEPS 3
-
-#if defined(DEBUG) && _MSC_VER == 1700
-#define SHIFTFIX(x) (max((x),0))
-#else
-#define SHIFTFIX(x) x
-#endif
-
-// This function converts 4x2 pixels from the source into 4x2 RGB pixels in the destination
-template <LAVPixelFormat inputFormat, int shift, int out32, int right_edge, int dithertype, int ycgco> __forceinline
-static int yuv2rgb_convert_pixels(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, RGBCoeffs *coeffs, const uint16_t* &dithers, ptrdiff_t pos)
-{
-  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
-  xmm7 = _mm_setzero_si128 ();
-
-  // Shift > 0 is for 9/10 bit formats
-  if (shift > 0) {
-    // Load 4 U/V values from line 0/1 into registers
-    PIXCONV_LOAD_4PIXEL16(xmm1, srcU);
-    PIXCONV_LOAD_4PIXEL16(xmm3, srcU+srcStrideUV);
-    PIXCONV_LOAD_4PIXEL16(xmm0, srcV);
-    PIXCONV_LOAD_4PIXEL16(xmm2, srcV+srcStrideUV);
-
-    // Interleave U and V
-    xmm0 = _mm_unpacklo_epi16(xmm1, xmm0);                       /* 0V0U0V0U */
-    xmm2 = _mm_unpacklo_epi16(xmm3, xmm2);                       /* 0V0U0V0U */
-  } else if (inputFormat == LAVPixFmt_NV12) {
-    // Load 4 16-bit macro pixels, which contain 4 UV samples
-    PIXCONV_LOAD_4PIXEL16(xmm0, srcU);
-    PIXCONV_LOAD_4PIXEL16(xmm2, srcU+srcStrideUV);
-
-    // Expand to 16-bit
-    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* 0V0U0V0U */
-    xmm2 = _mm_unpacklo_epi8(xmm2, xmm7);                       /* 0V0U0V0U */
-  } else {
-    PIXCONV_LOAD_4PIXEL8(xmm1, srcU);
-    PIXCONV_LOAD_4PIXEL8(xmm3, srcU+srcStrideUV);
-    PIXCONV_LOAD_4PIXEL8(xmm0, srcV);
-    PIXCONV_LOAD_4PIXEL8(xmm2, srcV+srcStrideUV);
-
-    // Interleave U and V
-    xmm0 = _mm_unpacklo_epi8(xmm1, xmm0);                       /* VUVU0000 */
-    xmm2 = _mm_unpacklo_epi8(xmm3, xmm2);                       /* VUVU0000 */
-
-    // Expand to 16-bit
-    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* 0V0U0V0U */
-    xmm2 = _mm_unpacklo_epi8(xmm2, xmm7);                       /* 0V0U0V0U */
-  }
-
-  // xmm0/xmm2 contain 4 interleaved U/V samples from two lines each in the 16bit parts, still in their native bitdepth
-
-  // Chroma upsampling required
-  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_YUV422) {
-    if (shift > 0 || inputFormat == LAVPixFmt_NV12) {
-      srcU += 4;
-      srcV += 4;
-    } else {
-      srcU += 2;
-      srcV += 2;
-    }
-
-    // Cut off the over-read into the stride and replace it with the last valid pixel
-    if (right_edge) {
-      xmm6 = _mm_set_epi32(0, 0xffffffff, 0, 0);
-
-      // First line
-      xmm1 = xmm0;
-      xmm1 = _mm_slli_si128(xmm1, 4);
-      xmm1 = _mm_and_si128(xmm1, xmm6);
-      xmm0 = _mm_andnot_si128(xmm6, xmm0);
-      xmm0 = _mm_or_si128(xmm0, xmm1);
-
-      // Second line
-      xmm3 = xmm2;
-      xmm3 = _mm_slli_si128(xmm3, 4);
-      xmm3 = _mm_and_si128(xmm3, xmm6);
-      xmm2 = _mm_andnot_si128(xmm6, xmm2);
-      xmm2 = _mm_or_si128(xmm2, xmm3);
-    }
-
-    // 4:2:0 - upsample to 4:2:2 using 75:25
-    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
-      // Too high bitdepth, shift down to 14-bit
-      if (shift >= 7) {
-        xmm0 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-6));
-        xmm2 = _mm_srli_epi16(xmm2, SHIFTFIX(shift-6));
-      }
-      xmm1 = xmm0;
-      xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2x line 0 */
-      xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 3x line 0 */
-      xmm1 = _mm_add_epi16(xmm1, xmm2);                         /* 3x line 0 + line 1 (10bit) */
-
-      xmm3 = xmm2;
-      xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2x line 1 */
-      xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 3x line 1 */
-      xmm3 = _mm_add_epi16(xmm3, xmm0);                         /* 3x line 1 + line 0 (10bit) */
-
-      // If the bit depth is too high, we need to reduce it here (max 15bit)
-      // 14-16 bits need the reduction, because they all result in a 16-bit result
-      if (shift >= 6) {
-        xmm1 = _mm_srli_epi16(xmm1, 1);
-        xmm3 = _mm_srli_epi16(xmm3, 1);
-      }
-    } else {
-      xmm1 = xmm0;
-      xmm3 = xmm2;
-
-      // Shift to maximum of 15-bit, if required
-      if (shift >= 8) {
-        xmm1 = _mm_srli_epi16(xmm1, 1);
-        xmm3 = _mm_srli_epi16(xmm3, 1);
-      }
-    }
-    // After this step, xmm1 and xmm3 contain 8 16-bit values, V and U interleaved. For 4:2:2, filling 8 to 15 bits (original bit depth). For 4:2:0, filling input+2 bits (10 to 15).
-
-    // Upsample to 4:4:4 using 100:0, 50:50, 0:100 scheme (MPEG2 chroma siting)
-    // TODO: MPEG1 chroma siting, use 75:25
-
-    xmm0 = xmm1;                                               /* UV UV UV UV */
-    xmm0 = _mm_unpacklo_epi32(xmm0, xmm7);                     /* UV 00 UV 00 */
-    xmm1 = _mm_srli_si128(xmm1, 4);                            /* UV UV UV 00 */
-    xmm1 = _mm_unpacklo_epi32(xmm7, xmm1);                     /* 00 UV 00 UV */
-
-    xmm1 = _mm_add_epi16(xmm1, xmm0);                         /*  UV  UV  UV  UV */
-    xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2UV  UV 2UV  UV */
-
-    xmm0 = _mm_slli_si128(xmm0, 4);                            /*  00  UV  00  UV */
-    xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2UV 2UV 2UV 2UV */
-
-    // Same for the second row
-    xmm2 = xmm3;                                               /* UV UV UV UV */
-    xmm2 = _mm_unpacklo_epi32(xmm2, xmm7);                     /* UV 00 UV 00 */
-    xmm3 = _mm_srli_si128(xmm3, 4);                            /* UV UV UV 00 */
-    xmm3 = _mm_unpacklo_epi32(xmm7, xmm3);                     /* 00 UV 00 UV */
-
-    xmm3 = _mm_add_epi16(xmm3, xmm2);                         /*  UV  UV  UV  UV */
-    xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2UV  UV 2UV  UV */
-
-    xmm2 = _mm_slli_si128(xmm2, 4);                            /*  00  UV  00  UV */
-    xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2UV 2UV 2UV 2UV */
-
-    // Shift the result to 12 bit
-    // For 10-bit input, we need to shift one bit off, or we exceed the allowed processing depth
-    // For 8-bit, we need to add one bit
-    if (inputFormat == LAVPixFmt_YUV420 && shift > 1) {
-      if (shift >= 5) {
-        xmm1 = _mm_srli_epi16(xmm1, 4);
-        xmm3 = _mm_srli_epi16(xmm3, 4);
-      } else {
-        xmm1 = _mm_srli_epi16(xmm1, SHIFTFIX(shift-1));
-        xmm3 = _mm_srli_epi16(xmm3, SHIFTFIX(shift-1));
-      }
-    } else if (inputFormat == LAVPixFmt_YUV422) {
-      if (shift >= 7) {
-        xmm1 = _mm_srli_epi16(xmm1, 4);
-        xmm3 = _mm_srli_epi16(xmm3, 4);
-      } else if (shift > 3) {
-        xmm1 = _mm_srli_epi16(xmm1, SHIFTFIX(shift-3));
-        xmm3 = _mm_srli_epi16(xmm3, SHIFTFIX(shift-3));
-      } else if (shift < 3) {
-        xmm1 = _mm_slli_epi16(xmm1, SHIFTFIX(3-shift));
-        xmm3 = _mm_slli_epi16(xmm3, SHIFTFIX(3-shift));
-      }
-    } else if ((inputFormat == LAVPixFmt_YUV420 && shift == 0) || inputFormat == LAVPixFmt_NV12) {
-      xmm1 = _mm_slli_epi16(xmm1, 1);
-      xmm3 = _mm_slli_epi16(xmm3, 1);
-    }
-
-    // 12-bit result, xmm1 & xmm3 with 4 UV combinations each
-  } else if (inputFormat == LAVPixFmt_YUV444) {
-    if (shift > 0) {
-      srcU += 8;
-      srcV += 8;
-    } else {
-      srcU += 4;
-      srcV += 4;
-    }
-    // Shift to 12 bit
-    if (shift > 4) {
-      xmm1 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-4));
-      xmm3 = _mm_srli_epi16(xmm2, SHIFTFIX(shift-4));
-    } else if (shift < 4) {
-      xmm1 = _mm_slli_epi16(xmm0, SHIFTFIX(4-shift));
-      xmm3 = _mm_slli_epi16(xmm2, SHIFTFIX(4-shift));
-    }
-  }
-
-  // Load Y
-  if (shift > 0) {
-    // Load 4 Y values from line 0/1 into registers
-    PIXCONV_LOAD_4PIXEL16(xmm5, srcY);
-    PIXCONV_LOAD_4PIXEL16(xmm0, srcY+srcStrideY);
-
-    srcY += 8;
-  } else {
-    PIXCONV_LOAD_4PIXEL8(xmm5, srcY);
-    PIXCONV_LOAD_4PIXEL8(xmm0, srcY+srcStrideY);
-    srcY += 4;
-
-    xmm5 = _mm_unpacklo_epi8(xmm5, xmm7);                       /* YYYY0000 (16-bit fields) */
-    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* YYYY0000 (16-bit fields)*/
-  }
-
-  xmm0 = _mm_unpacklo_epi64(xmm0, xmm5);                        /* YYYYYYYY */
-
-  // After this step, xmm1 & xmm3 contain 4 UV pairs, each in a 16-bit value, filling 12-bit.
-  if (!ycgco) {
-    // YCbCr conversion
-    // Shift Y to 14 bits
-    if (shift < 6) {
-      xmm0 = _mm_slli_epi16(xmm0, SHIFTFIX(6-shift));
-    } else if (shift > 6) {
-      xmm0 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-6));
-    }
-    xmm0 = _mm_subs_epu16(xmm0, coeffs->Ysub);                  /* Y-16 (in case of range expansion) */
-    xmm0 = _mm_mulhi_epi16(xmm0, coeffs->cy);                   /* Y*cy (result is 28 bits, with 12 high-bits packed into the result) */
-    xmm0 = _mm_add_epi16(xmm0, coeffs->rgb_add);                /* Y*cy + 16 (in case of range compression) */
-
-    xmm2 = coeffs->CbCr_center;                                 /* move CbCr to proper range */
-    xmm1 = _mm_subs_epi16(xmm1, xmm2);
-    xmm3 = _mm_subs_epi16(xmm3, xmm2);
-
-    xmm6 = xmm1;
-    xmm4 = xmm3;
-    xmm6 = _mm_madd_epi16(xmm6, coeffs->cR_Cr);                 /* Result is 25 bits (12 from chroma, 13 from coeff) */
-    xmm4 = _mm_madd_epi16(xmm4, coeffs->cR_Cr);
-    xmm6 = _mm_srai_epi32(xmm6, 13);                            /* Reduce to 12 bit */
-    xmm4 = _mm_srai_epi32(xmm4, 13);
-    xmm6 = _mm_packs_epi32(xmm6, xmm7);                         /* Pack back into 16 bit cells */
-    xmm4 = _mm_packs_epi32(xmm4, xmm7);
-    xmm6 = _mm_unpacklo_epi64(xmm4, xmm6);                      /* Interleave both parts */
-    xmm6 = _mm_add_epi16(xmm6, xmm0);                           /* R (12bit) */
-
-    xmm5 = xmm1;
-    xmm4 = xmm3;
-    xmm5 = _mm_madd_epi16(xmm5, coeffs->cG_Cb_cG_Cr);           /* Result is 25 bits (12 from chroma, 13 from coeff) */
-    xmm4 = _mm_madd_epi16(xmm4, coeffs->cG_Cb_cG_Cr);
-    xmm5 = _mm_srai_epi32(xmm5, 13);                            /* Reduce to 12 bit */
-    xmm4 = _mm_srai_epi32(xmm4, 13);
-    xmm5 = _mm_packs_epi32(xmm5, xmm7);                         /* Pack back into 16 bit cells */
-    xmm4 = _mm_packs_epi32(xmm4, xmm7);
-    xmm5 = _mm_unpacklo_epi64(xmm4, xmm5);                      /* Interleave both parts */
-    xmm5 = _mm_add_epi16(xmm5, xmm0);                           /* G (12bit) */
-
-    xmm1 = _mm_madd_epi16(xmm1, coeffs->cB_Cb);                 /* Result is 25 bits (12 from chroma, 13 from coeff) */
-    xmm3 = _mm_madd_epi16(xmm3, coeffs->cB_Cb);
-    xmm1 = _mm_srai_epi32(xmm1, 13);                            /* Reduce to 12 bit */
-    xmm3 = _mm_srai_epi32(xmm3, 13);
-    xmm1 = _mm_packs_epi32(xmm1, xmm7);                         /* Pack back into 16 bit cells */
-    xmm3 = _mm_packs_epi32(xmm3, xmm7);
-    xmm1 = _mm_unpacklo_epi64(xmm3, xmm1);                      /* Interleave both parts */
-    xmm1 = _mm_add_epi16(xmm1, xmm0);                           /* B (12bit) */
-  } else {
-    // YCgCo conversion
-    // Shift Y to 12 bits
-    if (shift < 4) {
-      xmm0 = _mm_slli_epi16(xmm0, SHIFTFIX(4-shift));
-    } else if (shift > 4) {
-      xmm0 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-4));
-    }
-
-    xmm7 = _mm_set1_epi32(0x0000FFFF);
-    xmm2 = xmm1;
-    xmm4 = xmm3;
-
-    xmm1 = _mm_and_si128(xmm1, xmm7);                          /* null out the high-order bytes to get the Cg values */
-    xmm4 = _mm_and_si128(xmm4, xmm7);
-
-    xmm3 = _mm_srli_epi32(xmm3, 16);                           /* right shift the Co values */
-    xmm2 = _mm_srli_epi32(xmm2, 16);
-
-    xmm1 = _mm_packs_epi32(xmm4, xmm1);                       /* Pack Cg into xmm1 */
-    xmm3 = _mm_packs_epi32(xmm3, xmm2);                       /* Pack Co into xmm3 */
-
-    xmm2 = coeffs->CbCr_center;                               /* move CgCo to proper range */
-    xmm1 = _mm_subs_epi16(xmm1, xmm2);
-    xmm3 = _mm_subs_epi16(xmm3, xmm2);
-
-    xmm2 = xmm0;
-    xmm2 = _mm_subs_epi16(xmm2, xmm1);                         /* tmp = Y - Cg */
-    xmm6 = _mm_adds_epi16(xmm2, xmm3);                         /* R = tmp + Co */
-    xmm5 = _mm_adds_epi16(xmm0, xmm1);                         /* G = Y + Cg */
-    xmm1 = _mm_subs_epi16(xmm2, xmm3);                         /* B = tmp - Co */
-  }
-
-  // Dithering
-  if (dithertype == LAVDither_Random) {
-    /* Load random dithering coeffs from the dithers buffer */
-    int offset = (pos % (DITHER_STEPS * 4 * 2)) * 6;
-    xmm2 = _mm_load_si128((const __m128i *)(dithers +  0 + offset));
-    xmm3 = _mm_load_si128((const __m128i *)(dithers +  8 + offset));
-    xmm4 = _mm_load_si128((const __m128i *)(dithers + 16 + offset));
-  } else {
-    /* Load dithering coeffs and combine them for two lines */
-    const uint16_t *d1 = dither_8x8_256[line % 8];
-    xmm2 = _mm_load_si128((const __m128i *)d1);
-    const uint16_t *d2 = dither_8x8_256[(line+1) % 8];
-    xmm3 = _mm_load_si128((const __m128i *)d2);
-
-    xmm4 = xmm2;
-    xmm2 = _mm_unpacklo_epi64(xmm2, xmm3);
-    xmm4 = _mm_unpackhi_epi64(xmm4, xmm3);
-    xmm2 = _mm_srli_epi16(xmm2, 4);
-    xmm4 = _mm_srli_epi16(xmm4, 4);
-
-    xmm3 = xmm4;
-  }
-
-  xmm6 = _mm_adds_epu16(xmm6, xmm2);                          /* Apply coefficients to the RGB values */
-  xmm5 = _mm_adds_epu16(xmm5, xmm3);
-  xmm1 = _mm_adds_epu16(xmm1, xmm4);
-
-  xmm6 = _mm_srai_epi16(xmm6, 4);                             /* Shift to 8 bit */
-  xmm5 = _mm_srai_epi16(xmm5, 4);
-  xmm1 = _mm_srai_epi16(xmm1, 4);
-
-  xmm2 = _mm_cmpeq_epi8(xmm2, xmm2);                          /* 0xffffffff,0xffffffff,0xffffffff,0xffffffff */
-  xmm6 = _mm_packus_epi16(xmm6, xmm7);                        /* R (lower 8bytes,8bit) * 8 */
-  xmm5 = _mm_packus_epi16(xmm5, xmm7);                        /* G (lower 8bytes,8bit) * 8 */
-  xmm1 = _mm_packus_epi16(xmm1, xmm7);                        /* B (lower 8bytes,8bit) * 8 */
-
-  xmm6 = _mm_unpacklo_epi8(xmm6,xmm2); // 0xff,R
-  xmm1 = _mm_unpacklo_epi8(xmm1,xmm5); // G,B
-  xmm2 = xmm1;
-
-  xmm1 = _mm_unpackhi_epi16(xmm1, xmm6); // 0xff,RGB * 4 (line 0)
-  xmm2 = _mm_unpacklo_epi16(xmm2, xmm6); // 0xff,RGB * 4 (line 1)
-
-  // TODO: RGB limiting
-
-  if (out32) {
-    _mm_stream_si128((__m128i *)(dst), xmm1);
-    _mm_stream_si128((__m128i *)(dst + dstStride), xmm2);
-    dst += 16;
-  } else {
-    // RGB 24 output is terribly inefficient due to the un-aligned size of 3 bytes per pixel
-    uint32_t eax;
-    DECLARE_ALIGNED(16, uint8_t, rgbbuf)[32];
-    *(uint32_t *)rgbbuf = _mm_cvtsi128_si32(xmm1);
-    xmm1 = _mm_srli_si128(xmm1, 4);
-    *(uint32_t *)(rgbbuf+3) = _mm_cvtsi128_si32 (xmm1);
-    xmm1 = _mm_srli_si128(xmm1, 4);
-    *(uint32_t *)(rgbbuf+6) = _mm_cvtsi128_si32 (xmm1);
-    xmm1 = _mm_srli_si128(xmm1, 4);
-    *(uint32_t *)(rgbbuf+9) = _mm_cvtsi128_si32 (xmm1);
-
-    *(uint32_t *)(rgbbuf+16) = _mm_cvtsi128_si32 (xmm2);
-    xmm2 = _mm_srli_si128(xmm2, 4);
-    *(uint32_t *)(rgbbuf+19) = _mm_cvtsi128_si32 (xmm2);
-    xmm2 = _mm_srli_si128(xmm2, 4);
-    *(uint32_t *)(rgbbuf+22) = _mm_cvtsi128_si32 (xmm2);
-    xmm2 = _mm_srli_si128(xmm2, 4);
-    *(uint32_t *)(rgbbuf+25) = _mm_cvtsi128_si32 (xmm2);
-
-    xmm1 = _mm_loadl_epi64((const __m128i *)(rgbbuf));
-    xmm2 = _mm_loadl_epi64((const __m128i *)(rgbbuf+16));
-
-    _mm_storel_epi64((__m128i *)(dst), xmm1);
-    eax = *(uint32_t *)(rgbbuf + 8);
-    *(uint32_t *)(dst + 8) = eax;
-
-    _mm_storel_epi64((__m128i *)(dst + dstStride), xmm2);
-    eax = *(uint32_t *)(rgbbuf + 24);
-    *(uint32_t *)(dst + dstStride + 8) = eax;
-
-    dst += 12;
-  }
-
-  return 0;
-}
-
-template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco>
-static int __stdcall yuv2rgb_process_lines(const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, uint8_t *dst, int width, int height, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, RGBCoeffs *coeffs, const uint16_t *dithers)
-{
-  const uint8_t *y = srcY;
-  const uint8_t *u = srcU;
-  const uint8_t *v = srcV;
-  uint8_t *rgb = dst;
-
-  dstStride *= (3 + out32);
-
-  ptrdiff_t line = sliceYStart;
-  ptrdiff_t lastLine = sliceYEnd;
-
-  const ptrdiff_t endx = width - 4;
-
-  const uint16_t *lineDither = dithers;
-
-  _mm_sfence();
-
-  // 4:2:0 needs special handling for the first and the last line
-  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
-    if (line == 0) {
-      for (ptrdiff_t i = 0; i < endx; i += 4) {
-        yuv2rgb_convert_pixels<inputFormat, shift, out32, 0, dithertype, ycgco>(y, u, v, rgb, 0, 0, 0, line, coeffs, lineDither, i);
-      }
-      yuv2rgb_convert_pixels<inputFormat, shift, out32, 1, dithertype, ycgco>(y, u, v, rgb, 0, 0, 0, line, coeffs, lineDither, 0);
-
-      line = 1;
-    }
-    if (lastLine == height)
-      lastLine--;
-  }
-
-  for (; line < lastLine; line += 2) {
-    if (dithertype == LAVDither_Random)
-      lineDither = dithers + (line * 24 * DITHER_STEPS);
-    y = srcY + line * srcStrideY;
-
-    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
-      u = srcU + (line >> 1) * srcStrideUV;
-      v = srcV + (line >> 1) * srcStrideUV;
-    } else {
-      u = srcU + line * srcStrideUV;
-      v = srcV + line * srcStrideUV;
-    }
-
-    rgb = dst + line * dstStride;
-
-    for (ptrdiff_t i = 0; i < endx; i += 4) {
-      yuv2rgb_convert_pixels<inputFormat, shift, out32, 0, dithertype, ycgco>(y, u, v, rgb, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, i);
-    }
-    yuv2rgb_convert_pixels<inputFormat, shift, out32, 1, dithertype, ycgco>(y, u, v, rgb, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, 0);
-  }
-
-  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
-    if (sliceYEnd == height) {
-      if (dithertype == LAVDither_Random)
-        lineDither = dithers + ((height - 2) * 24 * DITHER_STEPS);
-      y = srcY + (height - 1) * srcStrideY;
-      u = srcU + ((height >> 1) - 1)  * srcStrideUV;
-      v = srcV + ((height >> 1) - 1)  * srcStrideUV;
-      rgb = dst + (height - 1) * dstStride;
-
-      for (ptrdiff_t i = 0; i < endx; i += 4) {
-        yuv2rgb_convert_pixels<inputFormat, shift, out32, 0, dithertype, ycgco>(y, u, v, rgb, 0, 0, 0, line, coeffs, lineDither, i);
-      }
-      yuv2rgb_convert_pixels<inputFormat, shift, out32, 1, dithertype, ycgco>(y, u, v, rgb, 0, 0, 0, line, coeffs, lineDither, 0);
-    }
-  }
-  return 0;
-}
-
-template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco>
-inline int yuv2rgb_convert(const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, uint8_t *dst, int width, int height, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, RGBCoeffs *coeffs, const uint16_t *dithers, int threads)
-{
-  if (threads <= 1) {
-    yuv2rgb_process_lines<inputFormat, shift, out32, dithertype, ycgco>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, 0, height, coeffs, dithers);
-  } else {
-    const int is_odd = (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12);
-    const ptrdiff_t lines_per_thread = (height / threads)&~1;
-
-    Concurrency::parallel_for(0, threads, [&](int i) {
-      const ptrdiff_t starty = (i * lines_per_thread);
-      const ptrdiff_t endy = (i == (threads-1)) ? height : starty + lines_per_thread + is_odd;
-      yuv2rgb_process_lines<inputFormat, shift, out32, dithertype, ycgco>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, starty + (i ? is_odd : 0), endy, coeffs, dithers);
-    });
-  }
-  return 0;
-}
-
-template <int out32, int dithertype, int ycgco>
-inline int yuv2rgb_dispatch(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int dstStride, int width, int height, LAVPixelFormat inputFormat, int bpp, int numThreads, RGBCoeffs *coeffs, const uint16_t *dithers)
-{
-  // Wrap the input format into template args
-  switch (inputFormat) {
-  case LAVPixFmt_YUV420:
-    return yuv2rgb_convert<LAVPixFmt_YUV420, 0, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-  case LAVPixFmt_NV12:
-    return yuv2rgb_convert<LAVPixFmt_NV12, 0, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers,  numThreads);
-  case LAVPixFmt_YUV420bX:
-    if (bpp == 9)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 1, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    else if (bpp == 10)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 2, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 11)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 3, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 12)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 4, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 13)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 5, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 14)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 6, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 15)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 7, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 16)
-      return yuv2rgb_convert<LAVPixFmt_YUV420, 8, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    else
-      ASSERT(0);
-    break;
-  case LAVPixFmt_YUV422:
-    return yuv2rgb_convert<LAVPixFmt_YUV422, 0, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-  case LAVPixFmt_YUV422bX:
-    if (bpp == 9)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 1, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    else if (bpp == 10)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 2, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 11)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 3, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 12)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 4, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 13)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 5, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 14)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 6, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 15)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 7, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 16)
-      return yuv2rgb_convert<LAVPixFmt_YUV422, 8, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    else
-      ASSERT(0);
-    break;
-  case LAVPixFmt_YUV444:
-    return yuv2rgb_convert<LAVPixFmt_YUV444, 0, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-  case LAVPixFmt_YUV444bX:
-    if (bpp == 9)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 1, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    else if (bpp == 10)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 2, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 11)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 3, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 12)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 4, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 13)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 5, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 14)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 6, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    /*else if (bpp == 15)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 7, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);*/
-    else if (bpp == 16)
-      return yuv2rgb_convert<LAVPixFmt_YUV444, 8, out32, dithertype, ycgco>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, coeffs, dithers, numThreads);
-    else
-      ASSERT(0);
-    break;
-  default:
-    ASSERT(0);
-  }
-  return 0;
-  }
+#include "yuv2rgb.h"
 
 template <int out32>
 DECLARE_CONV_FUNC_IMPL(convert_yuv_rgb)
 {
-  RGBCoeffs *coeffs = getRGBCoeffs(width, height);
-
-  LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
-  const uint16_t *dithers = (ditherMode == LAVDither_Random) ? GetRandomDitherCoeffs(height, DITHER_STEPS * 3, 4, 0) : NULL;
-  if (ditherMode == LAVDither_Random && dithers != NULL) {
-    if (m_ColorProps.VideoTransferMatrix == 7) {
-      yuv2rgb_dispatch<out32, 1, 1>(src, srcStride, dst, dstStride, width, height, inputFormat, bpp, m_NumThreads, coeffs, dithers);
-    } else {
-      yuv2rgb_dispatch<out32, 1, 0>(src, srcStride, dst, dstStride, width, height, inputFormat, bpp, m_NumThreads, coeffs, dithers);
-    }
-  } else {
-    if (m_ColorProps.VideoTransferMatrix == 7) {
-      yuv2rgb_dispatch<out32, 0, 1>(src, srcStride, dst, dstStride, width, height, inputFormat, bpp, m_NumThreads, coeffs, NULL);
-    } else {
-      yuv2rgb_dispatch<out32, 0, 0>(src, srcStride, dst, dstStride, width, height, inputFormat, bpp, m_NumThreads, coeffs, NULL);
-    }
-  }
-
-  return S_OK;
+  return convert_yuv_rgb_impl<out32, 0>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
 }
 
-// Force creation of these two variants
+// Force creation of these variants
 template HRESULT CLAVPixFmtConverter::convert_yuv_rgb<0>CONV_FUNC_PARAMS;
 template HRESULT CLAVPixFmtConverter::convert_yuv_rgb<1>CONV_FUNC_PARAMS;
 
 RGBCoeffs* CLAVPixFmtConverter::getRGBCoeffs(int width, int height)
 {
+  CAutoLock lock(&m_csTables);
   if (!m_rgbCoeffs || width != swsWidth || height != swsHeight) {
     swsWidth = width;
     swsHeight = height;
@@ -613,6 +57,9 @@ RGBCoeffs* CLAVPixFmtConverter::getRGBCoeffs(int width, int height)
     BOOL inFullRange = (m_ColorProps.NominalRange == DXVA2_NominalRange_0_255);
     BOOL outFullRange = (swsOutputRange == 0) ? inFullRange : (swsOutputRange == 2);
 
+    if (CLAVSwsCache::FindRGBCoeffs(matrix, inFullRange, outFullRange, m_rgbCoeffs))
+      return m_rgbCoeffs;
+
     int inputWhite, inputBlack, inputChroma, outputWhite, outputBlack;
     if (inFullRange) {
       inputWhite = 255;
@@ -695,6 +142,7 @@ RGBCoeffs* CLAVPixFmtConverter::getRGBCoeffs(int width, int height)
       // Other Coeffs are not used in YCgCo
     }
 
+    CLAVSwsCache::StoreRGBCoeffs(matrix, inFullRange, outFullRange, m_rgbCoeffs);
   }
   return m_rgbCoeffs;
 }
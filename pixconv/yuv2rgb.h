@@ -0,0 +1,778 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <emmintrin.h>
+
+// Templates of the YUV to RGB conversion, shared by the SSE2 converters in yuv2rgb.cpp and the AVX2 converters in yuv2rgb_avx2.cpp
+// Everything in here is either static or templated on avx2, so code compiled for AVX2 never ends up in the SSE2 converters
+
+#define DITHER_STEPS 3
+
+// Position of the subsampled chroma samples relative to the luma samples
+enum {
+  CHROMA_SITING_MPEG2,    // horizontally co-sited with the left luma sample, vertically centered (MPEG-2, H.264)
+  CHROMA_SITING_MPEG1,    // centered between the luma samples (MPEG-1, JPEG)
+  CHROMA_SITING_TOPLEFT,  // co-sited with the top-left luma sample (DV PAL)
+};
+
+#if defined(DEBUG) && _MSC_VER == 1700
+#define SHIFTFIX(x) (max((x),0))
+#else
+#define SHIFTFIX(x) x
+#endif
+
+// This function converts 4x2 pixels from the source into 4x2 RGB pixels in the destination
+// dstEnd is the end of the first destination line, nothing at or beyond it will be written
+// left_edge/right_edge mark the first and last block of a line, which must not use chroma samples outside of the image
+template <LAVPixelFormat inputFormat, int shift, int out32, int left_edge, int right_edge, int dithertype, int ycgco, int siting> __forceinline
+static int yuv2rgb_convert_pixels(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, RGBCoeffs *coeffs, const uint16_t* &dithers, ptrdiff_t pos, BOOL bStream)
+{
+  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
+  xmm7 = _mm_setzero_si128 ();
+
+  // Centered chroma is interpolated with the chroma sample left of the block, so load from one sample earlier
+  const ptrdiff_t chromaBack = (siting == CHROMA_SITING_MPEG1 && !left_edge) ? ((shift > 0 || inputFormat == LAVPixFmt_NV12) ? 2 : 1) : 0;
+  const uint8_t *chromaU = srcU - chromaBack;
+  const uint8_t *chromaV = srcV - chromaBack;
+
+  // Shift > 0 is for 9/10 bit formats
+  if (shift > 0) {
+    // Load 4 U/V values from line 0/1 into registers
+    PIXCONV_LOAD_4PIXEL16(xmm1, chromaU);
+    PIXCONV_LOAD_4PIXEL16(xmm3, chromaU+srcStrideUV);
+    PIXCONV_LOAD_4PIXEL16(xmm0, chromaV);
+    PIXCONV_LOAD_4PIXEL16(xmm2, chromaV+srcStrideUV);
+
+    // Interleave U and V
+    xmm0 = _mm_unpacklo_epi16(xmm1, xmm0);                       /* 0V0U0V0U */
+    xmm2 = _mm_unpacklo_epi16(xmm3, xmm2);                       /* 0V0U0V0U */
+  } else if (inputFormat == LAVPixFmt_NV12) {
+    // Load 4 16-bit macro pixels, which contain 4 UV samples
+    PIXCONV_LOAD_4PIXEL16(xmm0, chromaU);
+    PIXCONV_LOAD_4PIXEL16(xmm2, chromaU+srcStrideUV);
+
+    // Expand to 16-bit
+    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* 0V0U0V0U */
+    xmm2 = _mm_unpacklo_epi8(xmm2, xmm7);                       /* 0V0U0V0U */
+  } else {
+    PIXCONV_LOAD_4PIXEL8(xmm1, chromaU);
+    PIXCONV_LOAD_4PIXEL8(xmm3, chromaU+srcStrideUV);
+    PIXCONV_LOAD_4PIXEL8(xmm0, chromaV);
+    PIXCONV_LOAD_4PIXEL8(xmm2, chromaV+srcStrideUV);
+
+    // Interleave U and V
+    xmm0 = _mm_unpacklo_epi8(xmm1, xmm0);                       /* VUVU0000 */
+    xmm2 = _mm_unpacklo_epi8(xmm3, xmm2);                       /* VUVU0000 */
+
+    // Expand to 16-bit
+    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* 0V0U0V0U */
+    xmm2 = _mm_unpacklo_epi8(xmm2, xmm7);                       /* 0V0U0V0U */
+  }
+
+  // xmm0/xmm2 contain 4 interleaved U/V samples from two lines each in the 16bit parts, still in their native bitdepth
+
+  // Chroma upsampling required
+  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_YUV422) {
+    if (shift > 0 || inputFormat == LAVPixFmt_NV12) {
+      srcU += 4;
+      srcV += 4;
+    } else {
+      srcU += 2;
+      srcV += 2;
+    }
+
+    // For centered chroma, the registers contain the samples -1 to 2 relative to the block
+    // In the first block, there is no sample left of it, replicate the first sample instead
+    if (siting == CHROMA_SITING_MPEG1 && left_edge) {
+      xmm0 = _mm_shuffle_epi32(xmm0, _MM_SHUFFLE(2, 1, 0, 0));
+      xmm2 = _mm_shuffle_epi32(xmm2, _MM_SHUFFLE(2, 1, 0, 0));
+    }
+
+    // Cut off the over-read into the stride and replace it with the last valid pixel
+    if (right_edge && siting == CHROMA_SITING_MPEG1) {
+      xmm0 = _mm_shuffle_epi32(xmm0, _MM_SHUFFLE(2, 2, 1, 0));
+      xmm2 = _mm_shuffle_epi32(xmm2, _MM_SHUFFLE(2, 2, 1, 0));
+    } else if (right_edge) {
+      xmm6 = _mm_set_epi32(0, 0xffffffff, 0, 0);
+
+      // First line
+      xmm1 = xmm0;
+      xmm1 = _mm_slli_si128(xmm1, 4);
+      xmm1 = _mm_and_si128(xmm1, xmm6);
+      xmm0 = _mm_andnot_si128(xmm6, xmm0);
+      xmm0 = _mm_or_si128(xmm0, xmm1);
+
+      // Second line
+      xmm3 = xmm2;
+      xmm3 = _mm_slli_si128(xmm3, 4);
+      xmm3 = _mm_and_si128(xmm3, xmm6);
+      xmm2 = _mm_andnot_si128(xmm6, xmm2);
+      xmm2 = _mm_or_si128(xmm2, xmm3);
+    }
+
+    // 4:2:0 - upsample to 4:2:2 using 75:25, or 50:50 and 0:100 for top-left chroma siting
+    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
+      // Too high bitdepth, shift down to 14-bit
+      if (shift >= 7) {
+        xmm0 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-6));
+        xmm2 = _mm_srli_epi16(xmm2, SHIFTFIX(shift-6));
+      }
+      if (siting == CHROMA_SITING_TOPLEFT) {
+        xmm1 = _mm_add_epi16(xmm0, xmm2);                       /* line 0 + line 1 */
+        xmm1 = _mm_add_epi16(xmm1, xmm1);                       /* 2x line 0 + 2x line 1 (10bit) */
+
+        xmm3 = _mm_add_epi16(xmm2, xmm2);                       /* 2x line 1 */
+        xmm3 = _mm_add_epi16(xmm3, xmm3);                       /* 4x line 1 (10bit) */
+      } else {
+        xmm1 = xmm0;
+        xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2x line 0 */
+        xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 3x line 0 */
+        xmm1 = _mm_add_epi16(xmm1, xmm2);                         /* 3x line 0 + line 1 (10bit) */
+
+        xmm3 = xmm2;
+        xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2x line 1 */
+        xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 3x line 1 */
+        xmm3 = _mm_add_epi16(xmm3, xmm0);                         /* 3x line 1 + line 0 (10bit) */
+      }
+
+      // If the bit depth is too high, we need to reduce it here (max 15bit)
+      // 14-16 bits need the reduction, because they all result in a 16-bit result
+      if (shift >= 6) {
+        xmm1 = _mm_srli_epi16(xmm1, 1);
+        xmm3 = _mm_srli_epi16(xmm3, 1);
+      }
+    } else {
+      xmm1 = xmm0;
+      xmm3 = xmm2;
+
+      // Shift to maximum of 15-bit, if required
+      if (shift >= 8) {
+        xmm1 = _mm_srli_epi16(xmm1, 1);
+        xmm3 = _mm_srli_epi16(xmm3, 1);
+      }
+    }
+    // After this step, xmm1 and xmm3 contain 8 16-bit values, V and U interleaved. For 4:2:2, filling 8 to 15 bits (original bit depth). For 4:2:0, filling input+2 bits (10 to 15).
+
+    if (siting == CHROMA_SITING_MPEG1) {
+      // Upsample to 4:4:4 using 75:25 (MPEG1 chroma siting)
+      // The result is scaled by 2 like the MPEG2 scheme below, computed as center + (center + neighbour) / 2
+
+      xmm0 = _mm_shuffle_epi32(xmm1, _MM_SHUFFLE(2, 2, 1, 1));   /* UV0 UV0 UV1 UV1 */
+      xmm1 = _mm_shuffle_epi32(xmm1, _MM_SHUFFLE(3, 1, 2, 0));   /* UV-1 UV1 UV0 UV2 */
+      xmm1 = _mm_avg_epu16(xmm1, xmm0);
+      xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 1.5UV0+0.5UV-1 1.5UV0+0.5UV1 1.5UV1+0.5UV0 1.5UV1+0.5UV2 */
+
+      // Same for the second row
+      xmm2 = _mm_shuffle_epi32(xmm3, _MM_SHUFFLE(2, 2, 1, 1));
+      xmm3 = _mm_shuffle_epi32(xmm3, _MM_SHUFFLE(3, 1, 2, 0));
+      xmm3 = _mm_avg_epu16(xmm3, xmm2);
+      xmm3 = _mm_add_epi16(xmm3, xmm2);
+    } else {
+      // Upsample to 4:4:4 using 100:0, 50:50, 0:100 scheme (MPEG2 chroma siting)
+
+      xmm0 = xmm1;                                               /* UV UV UV UV */
+      xmm0 = _mm_unpacklo_epi32(xmm0, xmm7);                     /* UV 00 UV 00 */
+      xmm1 = _mm_srli_si128(xmm1, 4);                            /* UV UV UV 00 */
+      xmm1 = _mm_unpacklo_epi32(xmm7, xmm1);                     /* 00 UV 00 UV */
+
+      xmm1 = _mm_add_epi16(xmm1, xmm0);                         /*  UV  UV  UV  UV */
+      xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2UV  UV 2UV  UV */
+
+      xmm0 = _mm_slli_si128(xmm0, 4);                            /*  00  UV  00  UV */
+      xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2UV 2UV 2UV 2UV */
+
+      // Same for the second row
+      xmm2 = xmm3;                                               /* UV UV UV UV */
+      xmm2 = _mm_unpacklo_epi32(xmm2, xmm7);                     /* UV 00 UV 00 */
+      xmm3 = _mm_srli_si128(xmm3, 4);                            /* UV UV UV 00 */
+      xmm3 = _mm_unpacklo_epi32(xmm7, xmm3);                     /* 00 UV 00 UV */
+
+      xmm3 = _mm_add_epi16(xmm3, xmm2);                         /*  UV  UV  UV  UV */
+      xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2UV  UV 2UV  UV */
+
+      xmm2 = _mm_slli_si128(xmm2, 4);                            /*  00  UV  00  UV */
+      xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2UV 2UV 2UV 2UV */
+    }
+
+    // Shift the result to 12 bit
+    // For 10-bit input, we need to shift one bit off, or we exceed the allowed processing depth
+    // For 8-bit, we need to add one bit
+    if (inputFormat == LAVPixFmt_YUV420 && shift > 1) {
+      if (shift >= 5) {
+        xmm1 = _mm_srli_epi16(xmm1, 4);
+        xmm3 = _mm_srli_epi16(xmm3, 4);
+      } else {
+        xmm1 = _mm_srli_epi16(xmm1, SHIFTFIX(shift-1));
+        xmm3 = _mm_srli_epi16(xmm3, SHIFTFIX(shift-1));
+      }
+    } else if (inputFormat == LAVPixFmt_YUV422) {
+      if (shift >= 7) {
+        xmm1 = _mm_srli_epi16(xmm1, 4);
+        xmm3 = _mm_srli_epi16(xmm3, 4);
+      } else if (shift > 3) {
+        xmm1 = _mm_srli_epi16(xmm1, SHIFTFIX(shift-3));
+        xmm3 = _mm_srli_epi16(xmm3, SHIFTFIX(shift-3));
+      } else if (shift < 3) {
+        xmm1 = _mm_slli_epi16(xmm1, SHIFTFIX(3-shift));
+        xmm3 = _mm_slli_epi16(xmm3, SHIFTFIX(3-shift));
+      }
+    } else if ((inputFormat == LAVPixFmt_YUV420 && shift == 0) || inputFormat == LAVPixFmt_NV12) {
+      xmm1 = _mm_slli_epi16(xmm1, 1);
+      xmm3 = _mm_slli_epi16(xmm3, 1);
+    }
+
+    // 12-bit result, xmm1 & xmm3 with 4 UV combinations each
+  } else if (inputFormat == LAVPixFmt_YUV444) {
+    if (shift > 0) {
+      srcU += 8;
+      srcV += 8;
+    } else {
+      srcU += 4;
+      srcV += 4;
+    }
+    // Shift to 12 bit
+    if (shift > 4) {
+      xmm1 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-4));
+      xmm3 = _mm_srli_epi16(xmm2, SHIFTFIX(shift-4));
+    } else if (shift < 4) {
+      xmm1 = _mm_slli_epi16(xmm0, SHIFTFIX(4-shift));
+      xmm3 = _mm_slli_epi16(xmm2, SHIFTFIX(4-shift));
+    } else {
+      xmm1 = xmm0;
+      xmm3 = xmm2;
+    }
+  }
+
+  // Load Y
+  if (shift > 0) {
+    // Load 4 Y values from line 0/1 into registers
+    PIXCONV_LOAD_4PIXEL16(xmm5, srcY);
+    PIXCONV_LOAD_4PIXEL16(xmm0, srcY+srcStrideY);
+
+    srcY += 8;
+  } else {
+    PIXCONV_LOAD_4PIXEL8(xmm5, srcY);
+    PIXCONV_LOAD_4PIXEL8(xmm0, srcY+srcStrideY);
+    srcY += 4;
+
+    xmm5 = _mm_unpacklo_epi8(xmm5, xmm7);                       /* YYYY0000 (16-bit fields) */
+    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* YYYY0000 (16-bit fields)*/
+  }
+
+  xmm0 = _mm_unpacklo_epi64(xmm0, xmm5);                        /* YYYYYYYY */
+
+  // After this step, xmm1 & xmm3 contain 4 UV pairs, each in a 16-bit value, filling 12-bit.
+  if (!ycgco) {
+    // YCbCr conversion
+    // Shift Y to 14 bits
+    if (shift < 6) {
+      xmm0 = _mm_slli_epi16(xmm0, SHIFTFIX(6-shift));
+    } else if (shift > 6) {
+      xmm0 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-6));
+    }
+    xmm0 = _mm_subs_epu16(xmm0, coeffs->Ysub);                  /* Y-16 (in case of range expansion) */
+    xmm0 = _mm_mulhi_epi16(xmm0, coeffs->cy);                   /* Y*cy (result is 28 bits, with 12 high-bits packed into the result) */
+    xmm0 = _mm_add_epi16(xmm0, coeffs->rgb_add);                /* Y*cy + 16 (in case of range compression) */
+
+    xmm2 = coeffs->CbCr_center;                                 /* move CbCr to proper range */
+    xmm1 = _mm_subs_epi16(xmm1, xmm2);
+    xmm3 = _mm_subs_epi16(xmm3, xmm2);
+
+    xmm6 = xmm1;
+    xmm4 = xmm3;
+    xmm6 = _mm_madd_epi16(xmm6, coeffs->cR_Cr);                 /* Result is 25 bits (12 from chroma, 13 from coeff) */
+    xmm4 = _mm_madd_epi16(xmm4, coeffs->cR_Cr);
+    xmm6 = _mm_srai_epi32(xmm6, 13);                            /* Reduce to 12 bit */
+    xmm4 = _mm_srai_epi32(xmm4, 13);
+    xmm6 = _mm_packs_epi32(xmm6, xmm7);                         /* Pack back into 16 bit cells */
+    xmm4 = _mm_packs_epi32(xmm4, xmm7);
+    xmm6 = _mm_unpacklo_epi64(xmm4, xmm6);                      /* Interleave both parts */
+    xmm6 = _mm_add_epi16(xmm6, xmm0);                           /* R (12bit) */
+
+    xmm5 = xmm1;
+    xmm4 = xmm3;
+    xmm5 = _mm_madd_epi16(xmm5, coeffs->cG_Cb_cG_Cr);           /* Result is 25 bits (12 from chroma, 13 from coeff) */
+    xmm4 = _mm_madd_epi16(xmm4, coeffs->cG_Cb_cG_Cr);
+    xmm5 = _mm_srai_epi32(xmm5, 13);                            /* Reduce to 12 bit */
+    xmm4 = _mm_srai_epi32(xmm4, 13);
+    xmm5 = _mm_packs_epi32(xmm5, xmm7);                         /* Pack back into 16 bit cells */
+    xmm4 = _mm_packs_epi32(xmm4, xmm7);
+    xmm5 = _mm_unpacklo_epi64(xmm4, xmm5);                      /* Interleave both parts */
+    xmm5 = _mm_add_epi16(xmm5, xmm0);                           /* G (12bit) */
+
+    xmm1 = _mm_madd_epi16(xmm1, coeffs->cB_Cb);                 /* Result is 25 bits (12 from chroma, 13 from coeff) */
+    xmm3 = _mm_madd_epi16(xmm3, coeffs->cB_Cb);
+    xmm1 = _mm_srai_epi32(xmm1, 13);                            /* Reduce to 12 bit */
+    xmm3 = _mm_srai_epi32(xmm3, 13);
+    xmm1 = _mm_packs_epi32(xmm1, xmm7);                         /* Pack back into 16 bit cells */
+    xmm3 = _mm_packs_epi32(xmm3, xmm7);
+    xmm1 = _mm_unpacklo_epi64(xmm3, xmm1);                      /* Interleave both parts */
+    xmm1 = _mm_add_epi16(xmm1, xmm0);                           /* B (12bit) */
+  } else {
+    // YCgCo conversion
+    // Shift Y to 12 bits
+    if (shift < 4) {
+      xmm0 = _mm_slli_epi16(xmm0, SHIFTFIX(4-shift));
+    } else if (shift > 4) {
+      xmm0 = _mm_srli_epi16(xmm0, SHIFTFIX(shift-4));
+    }
+
+    xmm7 = _mm_set1_epi32(0x0000FFFF);
+    xmm2 = xmm1;
+    xmm4 = xmm3;
+
+    xmm1 = _mm_and_si128(xmm1, xmm7);                          /* null out the high-order bytes to get the Cg values */
+    xmm4 = _mm_and_si128(xmm4, xmm7);
+
+    xmm3 = _mm_srli_epi32(xmm3, 16);                           /* right shift the Co values */
+    xmm2 = _mm_srli_epi32(xmm2, 16);
+
+    xmm1 = _mm_packs_epi32(xmm4, xmm1);                       /* Pack Cg into xmm1 */
+    xmm3 = _mm_packs_epi32(xmm3, xmm2);                       /* Pack Co into xmm3 */
+
+    xmm2 = coeffs->CbCr_center;                               /* move CgCo to proper range */
+    xmm1 = _mm_subs_epi16(xmm1, xmm2);
+    xmm3 = _mm_subs_epi16(xmm3, xmm2);
+
+    xmm2 = xmm0;
+    xmm2 = _mm_subs_epi16(xmm2, xmm1);                         /* tmp = Y - Cg */
+    xmm6 = _mm_adds_epi16(xmm2, xmm3);                         /* R = tmp + Co */
+    xmm5 = _mm_adds_epi16(xmm0, xmm1);                         /* G = Y + Cg */
+    xmm1 = _mm_subs_epi16(xmm2, xmm3);                         /* B = tmp - Co */
+  }
+
+  // Dithering
+  if (dithertype == LAVDither_Random) {
+    /* Load random dithering coeffs from the dithers buffer */
+    int offset = (pos % (DITHER_STEPS * 4 * 2)) * 6;
+    xmm2 = _mm_load_si128((const __m128i *)(dithers +  0 + offset));
+    xmm3 = _mm_load_si128((const __m128i *)(dithers +  8 + offset));
+    xmm4 = _mm_load_si128((const __m128i *)(dithers + 16 + offset));
+  } else {
+    /* Load dithering coeffs and combine them for two lines */
+    const uint16_t *d1 = dither_8x8_256[line % 8];
+    xmm2 = _mm_load_si128((const __m128i *)d1);
+    const uint16_t *d2 = dither_8x8_256[(line+1) % 8];
+    xmm3 = _mm_load_si128((const __m128i *)d2);
+
+    xmm4 = xmm2;
+    xmm2 = _mm_unpacklo_epi64(xmm2, xmm3);
+    xmm4 = _mm_unpackhi_epi64(xmm4, xmm3);
+    xmm2 = _mm_srli_epi16(xmm2, 4);
+    xmm4 = _mm_srli_epi16(xmm4, 4);
+
+    xmm3 = xmm4;
+  }
+
+  xmm6 = _mm_adds_epu16(xmm6, xmm2);                          /* Apply coefficients to the RGB values */
+  xmm5 = _mm_adds_epu16(xmm5, xmm3);
+  xmm1 = _mm_adds_epu16(xmm1, xmm4);
+
+  xmm6 = _mm_srai_epi16(xmm6, 4);                             /* Shift to 8 bit */
+  xmm5 = _mm_srai_epi16(xmm5, 4);
+  xmm1 = _mm_srai_epi16(xmm1, 4);
+
+  xmm2 = _mm_cmpeq_epi8(xmm2, xmm2);                          /* 0xffffffff,0xffffffff,0xffffffff,0xffffffff */
+  xmm6 = _mm_packus_epi16(xmm6, xmm7);                        /* R (lower 8bytes,8bit) * 8 */
+  xmm5 = _mm_packus_epi16(xmm5, xmm7);                        /* G (lower 8bytes,8bit) * 8 */
+  xmm1 = _mm_packus_epi16(xmm1, xmm7);                        /* B (lower 8bytes,8bit) * 8 */
+
+  xmm6 = _mm_unpacklo_epi8(xmm6,xmm2); // 0xff,R
+  xmm1 = _mm_unpacklo_epi8(xmm1,xmm5); // G,B
+  xmm2 = xmm1;
+
+  xmm1 = _mm_unpackhi_epi16(xmm1, xmm6); // 0xff,RGB * 4 (line 0)
+  xmm2 = _mm_unpacklo_epi16(xmm2, xmm6); // 0xff,RGB * 4 (line 1)
+
+  // TODO: RGB limiting
+
+  if (out32) {
+    pixconv_put_stream((__m128i *)(dst), dstEnd, xmm1, bStream);
+    pixconv_put_stream((__m128i *)(dst + dstStride), dstEnd + dstStride, xmm2, bStream);
+    dst += 16;
+  } else {
+    // RGB 24 output is terribly inefficient due to the un-aligned size of 3 bytes per pixel
+    uint32_t eax;
+    DECLARE_ALIGNED(16, uint8_t, rgbbuf)[32];
+    *(uint32_t *)rgbbuf = _mm_cvtsi128_si32(xmm1);
+    xmm1 = _mm_srli_si128(xmm1, 4);
+    *(uint32_t *)(rgbbuf+3) = _mm_cvtsi128_si32 (xmm1);
+    xmm1 = _mm_srli_si128(xmm1, 4);
+    *(uint32_t *)(rgbbuf+6) = _mm_cvtsi128_si32 (xmm1);
+    xmm1 = _mm_srli_si128(xmm1, 4);
+    *(uint32_t *)(rgbbuf+9) = _mm_cvtsi128_si32 (xmm1);
+
+    *(uint32_t *)(rgbbuf+16) = _mm_cvtsi128_si32 (xmm2);
+    xmm2 = _mm_srli_si128(xmm2, 4);
+    *(uint32_t *)(rgbbuf+19) = _mm_cvtsi128_si32 (xmm2);
+    xmm2 = _mm_srli_si128(xmm2, 4);
+    *(uint32_t *)(rgbbuf+22) = _mm_cvtsi128_si32 (xmm2);
+    xmm2 = _mm_srli_si128(xmm2, 4);
+    *(uint32_t *)(rgbbuf+25) = _mm_cvtsi128_si32 (xmm2);
+
+    if (right_edge) {
+      // The last block may extend beyond the end of the line, only write what fits
+      ptrdiff_t left = min(dstEnd - dst, (ptrdiff_t)12);
+      memcpy(dst, rgbbuf, left);
+      memcpy(dst + dstStride, rgbbuf+16, left);
+    } else {
+      xmm1 = _mm_loadl_epi64((const __m128i *)(rgbbuf));
+      xmm2 = _mm_loadl_epi64((const __m128i *)(rgbbuf+16));
+
+      _mm_storel_epi64((__m128i *)(dst), xmm1);
+      eax = *(uint32_t *)(rgbbuf + 8);
+      *(uint32_t *)(dst + 8) = eax;
+
+      _mm_storel_epi64((__m128i *)(dst + dstStride), xmm2);
+      eax = *(uint32_t *)(rgbbuf + 24);
+      *(uint32_t *)(dst + dstStride + 8) = eax;
+    }
+
+    dst += 12;
+  }
+
+  return 0;
+}
+
+// Convert the blocks inside of a line two at a time, starting at position i, and return the position of the first block left to convert
+// Only the AVX2 converters do this, their specialization for avx2 = 1 is in yuv2rgb_avx2.cpp
+template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco, int siting, int avx2>
+struct yuv2rgb_convert_blocks_x2 {
+  static __forceinline ptrdiff_t convert(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, RGBCoeffs *coeffs, const uint16_t* &dithers, ptrdiff_t i, ptrdiff_t endx, BOOL bStream)
+  {
+    return i;
+  }
+};
+
+// Convert a line pair, or a single line with zero strides, block by block
+// avx2 - convert the blocks inside of the line two at a time with yuv2rgb_convert_blocks_x2
+template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco, int siting, int avx2> __forceinline
+static void yuv2rgb_convert_line(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *rgb, const uint8_t *end, int width, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, RGBCoeffs *coeffs, const uint16_t *lineDither, BOOL bStream)
+{
+  const ptrdiff_t endx = width - 4;
+  ptrdiff_t i = 0;
+
+  // Only centered chroma uses the chroma sample left of a block
+  if (siting == CHROMA_SITING_MPEG1 && endx > 0) {
+    yuv2rgb_convert_pixels<inputFormat, shift, out32, 1, 0, dithertype, ycgco, siting>(y, u, v, rgb, end, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, i, bStream);
+    i += 4;
+  }
+  i = yuv2rgb_convert_blocks_x2<inputFormat, shift, out32, dithertype, ycgco, siting, avx2>::convert(y, u, v, rgb, end, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, i, endx, bStream);
+  for (; i < endx; i += 4) {
+    yuv2rgb_convert_pixels<inputFormat, shift, out32, 0, 0, dithertype, ycgco, siting>(y, u, v, rgb, end, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, i, bStream);
+  }
+  if (siting == CHROMA_SITING_MPEG1 && endx <= 0)
+    yuv2rgb_convert_pixels<inputFormat, shift, out32, 1, 1, dithertype, ycgco, siting>(y, u, v, rgb, end, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, 0, bStream);
+  else
+    yuv2rgb_convert_pixels<inputFormat, shift, out32, 0, 1, dithertype, ycgco, siting>(y, u, v, rgb, end, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, 0, bStream);
+}
+
+template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco, int siting, int avx2>
+static int __stdcall yuv2rgb_process_lines(const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, uint8_t *dst, int width, int height, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, RGBCoeffs *coeffs, const uint16_t *dithers, BOOL bStream)
+{
+  const uint8_t *y = srcY;
+  const uint8_t *u = srcU;
+  const uint8_t *v = srcV;
+  uint8_t *rgb = dst;
+
+  dstStride *= (3 + out32);
+
+  ptrdiff_t line = sliceYStart;
+  ptrdiff_t lastLine = sliceYEnd;
+
+  const uint16_t *lineDither = dithers;
+
+  _mm_sfence();
+
+  // 4:2:0 needs special handling for the first and the last line
+  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
+    if (line == 0) {
+      const uint8_t *end = rgb + width * (3 + out32);
+      yuv2rgb_convert_line<inputFormat, shift, out32, dithertype, ycgco, siting, avx2>(y, u, v, rgb, end, width, 0, 0, 0, line, coeffs, lineDither, bStream);
+
+      line = 1;
+    }
+    if (lastLine == height)
+      lastLine--;
+  }
+
+  for (; line < lastLine; line += 2) {
+    if (dithertype == LAVDither_Random)
+      lineDither = dithers + (line * 24 * DITHER_STEPS);
+    y = srcY + line * srcStrideY;
+
+    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
+      u = srcU + (line >> 1) * srcStrideUV;
+      v = srcV + (line >> 1) * srcStrideUV;
+    } else {
+      u = srcU + line * srcStrideUV;
+      v = srcV + line * srcStrideUV;
+    }
+
+    rgb = dst + line * dstStride;
+    const uint8_t *end = rgb + width * (3 + out32);
+
+    // A single line is left at the end of odd-sized slices
+    if (line + 1 == lastLine)
+      yuv2rgb_convert_line<inputFormat, shift, out32, dithertype, ycgco, siting, avx2>(y, u, v, rgb, end, width, 0, 0, 0, line, coeffs, lineDither, bStream);
+    else
+      yuv2rgb_convert_line<inputFormat, shift, out32, dithertype, ycgco, siting, avx2>(y, u, v, rgb, end, width, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, bStream);
+  }
+
+  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
+    if (sliceYEnd == height) {
+      if (dithertype == LAVDither_Random)
+        lineDither = dithers + ((height - 2) * 24 * DITHER_STEPS);
+      y = srcY + (height - 1) * srcStrideY;
+      u = srcU + ((height >> 1) - 1)  * srcStrideUV;
+      v = srcV + ((height >> 1) - 1)  * srcStrideUV;
+      rgb = dst + (height - 1) * dstStride;
+      const uint8_t *end = rgb + width * (3 + out32);
+
+      yuv2rgb_convert_line<inputFormat, shift, out32, dithertype, ycgco, siting, avx2>(y, u, v, rgb, end, width, 0, 0, 0, line, coeffs, lineDither, bStream);
+    }
+  }
+  return 0;
+}
+
+template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco, int avx2>
+inline int yuv2rgb_convert(const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, uint8_t *dst, int width, int height, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, RGBCoeffs *coeffs, const uint16_t *dithers, int siting, BOOL bStream)
+{
+  // 4:2:0 is processed in line pairs starting at line 1, so every slice but the first starts one line later, and every slice but the last ends one line later
+  const int is_odd = (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12);
+  const ptrdiff_t starty = sliceYStart ? sliceYStart + is_odd : 0;
+  const ptrdiff_t endy   = (sliceYEnd == height) ? height : sliceYEnd + is_odd;
+
+  // 4:4:4 has no chroma siting, and horizontally, 4:2:2 is top-left sited like MPEG-2
+  switch (siting) {
+  case CHROMA_SITING_MPEG1:
+    yuv2rgb_process_lines<inputFormat, shift, out32, dithertype, ycgco, (inputFormat == LAVPixFmt_YUV444) ? CHROMA_SITING_MPEG2 : CHROMA_SITING_MPEG1, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, starty, endy, coeffs, dithers, bStream);
+    break;
+  case CHROMA_SITING_TOPLEFT:
+    yuv2rgb_process_lines<inputFormat, shift, out32, dithertype, ycgco, is_odd ? CHROMA_SITING_TOPLEFT : CHROMA_SITING_MPEG2, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, starty, endy, coeffs, dithers, bStream);
+    break;
+  default:
+    yuv2rgb_process_lines<inputFormat, shift, out32, dithertype, ycgco, CHROMA_SITING_MPEG2, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, starty, endy, coeffs, dithers, bStream);
+  }
+  return 0;
+}
+
+// YUY2 is split into a planar 4:2:2 line pair in a small buffer, which is then converted like YUV422
+// The blocks at the end of the line read a few samples beyond the width, the buffer leaves room for them
+#define YUY2RGB_BUFFER_STRIDE(width) (FFALIGN(width, 32) + 32)
+#define YUY2RGB_BUFFER_SIZE(width)   (YUY2RGB_BUFFER_STRIDE(width) * 6)
+
+// buffer    - two lines each of Y, U and V, bufStride bytes apart
+template <int out32, int dithertype, int ycgco, int siting, int avx2>
+static int __stdcall yuy2rgb_process_lines(const uint8_t *src, uint8_t *dst, int width, ptrdiff_t srcStride, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, RGBCoeffs *coeffs, const uint16_t *dithers, uint8_t *buffer, ptrdiff_t bufStride, BOOL bStream)
+{
+  uint8_t *y = buffer;
+  uint8_t *u = buffer + 2 * bufStride;
+  uint8_t *v = buffer + 4 * bufStride;
+
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  __m128i xmm0,xmm1,xmm2,xmm3;
+
+  dstStride *= (3 + out32);
+
+  const ptrdiff_t chromaWidth = (width + 1) >> 1;
+  // Bytes of an input line, the last pixel of an odd width still has a full chroma pair
+  const ptrdiff_t inBytes = chromaWidth << 2;
+  const uint16_t *lineDither = dithers;
+  // The last pixels of a line are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint8_t, tail)[32];
+
+  _mm_sfence();
+
+  for (ptrdiff_t line = sliceYStart; line < sliceYEnd; line += 2) {
+    // An odd last line is converted on its own, as a pair of the same line with zero strides
+    const int lines = (sliceYEnd - line) >= 2 ? 2 : 1;
+    for (int l = 0; l < lines; l++) {
+      const uint8_t *yuy2 = src + (line + l) * srcStride;
+      for (ptrdiff_t i = 0; i < width; i += 16) {
+        const uint8_t *in = yuy2 + i * 2;
+        if (inBytes - i * 2 < 32) {
+          memcpy(tail, in, inBytes - i * 2);
+          in = tail;
+        }
+        PIXCONV_LOAD_YUY2_SPLIT(xmm0, xmm1, mask, in);                           /* YYYY / UVUV */
+        xmm2 = _mm_packus_epi16(_mm_and_si128(xmm1, mask), xmm1);                /* UUUU in the low half */
+        xmm3 = _mm_packus_epi16(_mm_srli_epi16(xmm1, 8), xmm1);                  /* VVVV in the low half */
+        _mm_store_si128((__m128i *)(y + l * bufStride + i), xmm0);
+        _mm_storel_epi64((__m128i *)(u + l * bufStride + (i >> 1)), xmm2);
+        _mm_storel_epi64((__m128i *)(v + l * bufStride + (i >> 1)), xmm3);
+      }
+      // The last pixel of a block is interpolated with the next chroma sample, which has to repeat the last one at the edge
+      u[l * bufStride + chromaWidth] = u[l * bufStride + chromaWidth - 1];
+      v[l * bufStride + chromaWidth] = v[l * bufStride + chromaWidth - 1];
+    }
+
+    if (dithertype == LAVDither_Random)
+      lineDither = dithers + (line * 24 * DITHER_STEPS);
+
+    uint8_t *rgb = dst + line * dstStride;
+    const uint8_t *end = rgb + width * (3 + out32);
+    const ptrdiff_t pairStride = (lines == 2) ? bufStride : 0;
+
+    yuv2rgb_convert_line<LAVPixFmt_YUV422, 0, out32, dithertype, ycgco, siting, avx2>(y, u, v, rgb, end, width, pairStride, pairStride, (lines == 2) ? dstStride : 0, line, coeffs, lineDither, bStream);
+  }
+  return 0;
+}
+
+// buffer - YUY2RGB_BUFFER_SIZE(width) bytes of scratch memory, owned by the slice
+template <int out32, int dithertype, int ycgco, int avx2>
+inline int yuy2rgb_convert(const uint8_t *src, uint8_t *dst, int width, ptrdiff_t srcStride, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, RGBCoeffs *coeffs, const uint16_t *dithers, int siting, uint8_t *buffer, BOOL bStream)
+{
+  if (!buffer)
+    return -1;
+
+  // Horizontally, 4:2:2 is top-left sited like MPEG-2
+  if (siting == CHROMA_SITING_MPEG1)
+    yuy2rgb_process_lines<out32, dithertype, ycgco, CHROMA_SITING_MPEG1, avx2>(src, dst, width, srcStride, dstStride, sliceYStart, sliceYEnd, coeffs, dithers, buffer, YUY2RGB_BUFFER_STRIDE(width), bStream);
+  else
+    yuy2rgb_process_lines<out32, dithertype, ycgco, CHROMA_SITING_MPEG2, avx2>(src, dst, width, srcStride, dstStride, sliceYStart, sliceYEnd, coeffs, dithers, buffer, YUY2RGB_BUFFER_STRIDE(width), bStream);
+
+  return 0;
+}
+
+// buffer - scratch memory of the YUY2 conversion, unused for the other formats
+template <int out32, int dithertype, int ycgco, int avx2>
+inline int yuv2rgb_dispatch(const uint8_t* const src[4], const int srcStride[4], uint8_t *dst, int dstStride, int width, int height, int sliceYStart, int sliceYEnd, LAVPixelFormat inputFormat, int bpp, RGBCoeffs *coeffs, const uint16_t *dithers, int siting, uint8_t *buffer, BOOL bStream)
+{
+  // Wrap the input format into template args
+  switch (inputFormat) {
+  case LAVPixFmt_YUV420:
+    return yuv2rgb_convert<LAVPixFmt_YUV420, 0, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+  case LAVPixFmt_NV12:
+    return yuv2rgb_convert<LAVPixFmt_NV12, 0, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+  case LAVPixFmt_YUV420bX:
+    if (bpp == 9)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 1, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    else if (bpp == 10)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 2, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 11)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 3, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 12)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 4, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 13)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 5, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 14)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 6, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 15)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 7, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 16)
+      return yuv2rgb_convert<LAVPixFmt_YUV420, 8, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    else
+      ASSERT(0);
+    break;
+  case LAVPixFmt_YUV422:
+    return yuv2rgb_convert<LAVPixFmt_YUV422, 0, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+  case LAVPixFmt_YUV422bX:
+    if (bpp == 9)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 1, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    else if (bpp == 10)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 2, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 11)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 3, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 12)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 4, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 13)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 5, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 14)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 6, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 15)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 7, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 16)
+      return yuv2rgb_convert<LAVPixFmt_YUV422, 8, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    else
+      ASSERT(0);
+    break;
+  case LAVPixFmt_YUV444:
+    return yuv2rgb_convert<LAVPixFmt_YUV444, 0, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+  case LAVPixFmt_YUV444bX:
+    if (bpp == 9)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 1, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    else if (bpp == 10)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 2, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 11)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 3, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 12)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 4, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 13)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 5, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 14)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 6, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    /*else if (bpp == 15)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 7, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);*/
+    else if (bpp == 16)
+      return yuv2rgb_convert<LAVPixFmt_YUV444, 8, out32, dithertype, ycgco, avx2>(src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, bStream);
+    else
+      ASSERT(0);
+    break;
+  case LAVPixFmt_YUY2:
+    return yuy2rgb_convert<out32, dithertype, ycgco, avx2>(src[0], dst, width, srcStride[0], dstStride, sliceYStart, sliceYEnd, coeffs, dithers, siting, buffer, bStream);
+  default:
+    ASSERT(0);
+  }
+  return 0;
+  }
+
+template <int out32, int avx2>
+DECLARE_CONV_FUNC_IMPL(convert_yuv_rgb_impl)
+{
+  RGBCoeffs *coeffs = getRGBCoeffs(width, height);
+
+  LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
+  const uint16_t *dithers = (ditherMode == LAVDither_Random) ? GetRandomDitherCoeffs(height, DITHER_STEPS * 3, 4, 0) : NULL;
+
+  // Chroma siting from the stream, unknown siting is treated as MPEG-2
+  int siting = CHROMA_SITING_MPEG2;
+  if (m_ColorProps.VideoChromaSubsampling != DXVA2_VideoChromaSubsampling_Unknown) {
+    if (!(m_ColorProps.VideoChromaSubsampling & DXVA2_VideoChromaSubsampling_Horizontally_Cosited))
+      siting = CHROMA_SITING_MPEG1;
+    else if (m_ColorProps.VideoChromaSubsampling & DXVA2_VideoChromaSubsampling_Vertically_Cosited)
+      siting = CHROMA_SITING_TOPLEFT;
+  }
+
+  // YUY2 is split into planar lines in a scratch buffer first
+  const size_t bufferSize = (inputFormat == LAVPixFmt_YUY2) ? YUY2RGB_BUFFER_SIZE(width) : 0;
+  uint8_t *buffer = bufferSize ? AcquireScratchBuffer(bufferSize) : NULL;
+  if (bufferSize && !buffer)
+    return E_OUTOFMEMORY;
+
+  if (ditherMode == LAVDither_Random && dithers != NULL) {
+    if (m_ColorProps.VideoTransferMatrix == 7) {
+      yuv2rgb_dispatch<out32, 1, 1, avx2>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, coeffs, dithers, siting, buffer, m_bStreamingStores);
+    } else {
+      yuv2rgb_dispatch<out32, 1, 0, avx2>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, coeffs, dithers, siting, buffer, m_bStreamingStores);
+    }
+  } else {
+    if (m_ColorProps.VideoTransferMatrix == 7) {
+      yuv2rgb_dispatch<out32, 0, 1, avx2>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, coeffs, NULL, siting, buffer, m_bStreamingStores);
+    } else {
+      yuv2rgb_dispatch<out32, 0, 0, avx2>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, coeffs, NULL, siting, buffer, m_bStreamingStores);
+    }
+  }
+
+  ReleaseScratchBuffer(buffer, bufferSize);
+
+  return S_OK;
+}
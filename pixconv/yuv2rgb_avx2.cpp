@@ -0,0 +1,364 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <immintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+#include "pixconv_avx2_templates.h"
+
+#pragma warning(push)
+#pragma warning(disable: 4556)
+
+#include "yuv2rgb.h"
+
+// AVX2 versions of the YUV to RGB converters in yuv2rgb.cpp
+// This file is compiled with AVX2 code generation, it must only be called after checking for AVX2 support.
+
+// AVX2 version of yuv2rgb_convert_pixels, which converts two blocks of 4x2 pixels at once, one in each 128-bit lane
+// The instructions operate on the lanes independently, so every step is the same as in the SSE2 version, and the
+// output is bit-identical. Only blocks inside of the line are handled, the blocks at the edges use the SSE2 version.
+template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco, int siting> __forceinline
+static int yuv2rgb_convert_pixels_avx2(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, RGBCoeffs *coeffs, const uint16_t* &dithers, ptrdiff_t pos, BOOL bStream)
+{
+  __m256i ymm0,ymm1,ymm2,ymm3,ymm4,ymm5,ymm6,ymm7;
+  ymm7 = _mm256_setzero_si256();
+
+  // Bytes of chroma and luma of one line of a block
+  const ptrdiff_t chromaStep = (inputFormat == LAVPixFmt_YUV444) ? ((shift > 0) ? 8 : 4) : ((shift > 0 || inputFormat == LAVPixFmt_NV12) ? 4 : 2);
+  const ptrdiff_t lumaStep = (shift > 0) ? 8 : 4;
+
+  const ptrdiff_t chromaBack = (siting == CHROMA_SITING_MPEG1) ? ((shift > 0 || inputFormat == LAVPixFmt_NV12) ? 2 : 1) : 0;
+  const uint8_t *chromaU = srcU - chromaBack;
+  const uint8_t *chromaV = srcV - chromaBack;
+
+  if (shift > 0) {
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm1, chromaU, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm3, chromaU+srcStrideUV, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm0, chromaV, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm2, chromaV+srcStrideUV, chromaStep);
+
+    ymm0 = _mm256_unpacklo_epi16(ymm1, ymm0);                   /* 0V0U0V0U */
+    ymm2 = _mm256_unpacklo_epi16(ymm3, ymm2);                   /* 0V0U0V0U */
+  } else if (inputFormat == LAVPixFmt_NV12) {
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm0, chromaU, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm2, chromaU+srcStrideUV, chromaStep);
+
+    ymm0 = _mm256_unpacklo_epi8(ymm0, ymm7);                    /* 0V0U0V0U */
+    ymm2 = _mm256_unpacklo_epi8(ymm2, ymm7);                    /* 0V0U0V0U */
+  } else {
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm1, chromaU, chromaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm3, chromaU+srcStrideUV, chromaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm0, chromaV, chromaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm2, chromaV+srcStrideUV, chromaStep);
+
+    ymm0 = _mm256_unpacklo_epi8(ymm1, ymm0);                    /* VUVU0000 */
+    ymm2 = _mm256_unpacklo_epi8(ymm3, ymm2);                    /* VUVU0000 */
+
+    ymm0 = _mm256_unpacklo_epi8(ymm0, ymm7);                    /* 0V0U0V0U */
+    ymm2 = _mm256_unpacklo_epi8(ymm2, ymm7);                    /* 0V0U0V0U */
+  }
+
+  srcU += chromaStep * 2;
+  srcV += chromaStep * 2;
+
+  if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_YUV422) {
+    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12) {
+      if (shift >= 7) {
+        ymm0 = _mm256_srli_epi16(ymm0, SHIFTFIX(shift-6));
+        ymm2 = _mm256_srli_epi16(ymm2, SHIFTFIX(shift-6));
+      }
+      if (siting == CHROMA_SITING_TOPLEFT) {
+        ymm1 = _mm256_add_epi16(ymm0, ymm2);                    /* line 0 + line 1 */
+        ymm1 = _mm256_add_epi16(ymm1, ymm1);                    /* 2x line 0 + 2x line 1 */
+
+        ymm3 = _mm256_add_epi16(ymm2, ymm2);                    /* 2x line 1 */
+        ymm3 = _mm256_add_epi16(ymm3, ymm3);                    /* 4x line 1 */
+      } else {
+        ymm1 = _mm256_add_epi16(ymm0, ymm0);                    /* 2x line 0 */
+        ymm1 = _mm256_add_epi16(ymm1, ymm0);                    /* 3x line 0 */
+        ymm1 = _mm256_add_epi16(ymm1, ymm2);                    /* 3x line 0 + line 1 */
+
+        ymm3 = _mm256_add_epi16(ymm2, ymm2);                    /* 2x line 1 */
+        ymm3 = _mm256_add_epi16(ymm3, ymm2);                    /* 3x line 1 */
+        ymm3 = _mm256_add_epi16(ymm3, ymm0);                    /* 3x line 1 + line 0 */
+      }
+
+      if (shift >= 6) {
+        ymm1 = _mm256_srli_epi16(ymm1, 1);
+        ymm3 = _mm256_srli_epi16(ymm3, 1);
+      }
+    } else {
+      ymm1 = ymm0;
+      ymm3 = ymm2;
+
+      if (shift >= 8) {
+        ymm1 = _mm256_srli_epi16(ymm1, 1);
+        ymm3 = _mm256_srli_epi16(ymm3, 1);
+      }
+    }
+
+    if (siting == CHROMA_SITING_MPEG1) {
+      ymm0 = _mm256_shuffle_epi32(ymm1, _MM_SHUFFLE(2, 2, 1, 1)); /* UV0 UV0 UV1 UV1 */
+      ymm1 = _mm256_shuffle_epi32(ymm1, _MM_SHUFFLE(3, 1, 2, 0)); /* UV-1 UV1 UV0 UV2 */
+      ymm1 = _mm256_avg_epu16(ymm1, ymm0);
+      ymm1 = _mm256_add_epi16(ymm1, ymm0);
+
+      ymm2 = _mm256_shuffle_epi32(ymm3, _MM_SHUFFLE(2, 2, 1, 1));
+      ymm3 = _mm256_shuffle_epi32(ymm3, _MM_SHUFFLE(3, 1, 2, 0));
+      ymm3 = _mm256_avg_epu16(ymm3, ymm2);
+      ymm3 = _mm256_add_epi16(ymm3, ymm2);
+    } else {
+      ymm0 = _mm256_unpacklo_epi32(ymm1, ymm7);                 /* UV 00 UV 00 */
+      ymm1 = _mm256_srli_si256(ymm1, 4);                        /* UV UV UV 00 */
+      ymm1 = _mm256_unpacklo_epi32(ymm7, ymm1);                 /* 00 UV 00 UV */
+
+      ymm1 = _mm256_add_epi16(ymm1, ymm0);                      /*  UV  UV  UV  UV */
+      ymm1 = _mm256_add_epi16(ymm1, ymm0);                      /* 2UV  UV 2UV  UV */
+
+      ymm0 = _mm256_slli_si256(ymm0, 4);                        /*  00  UV  00  UV */
+      ymm1 = _mm256_add_epi16(ymm1, ymm0);                      /* 2UV 2UV 2UV 2UV */
+
+      ymm2 = _mm256_unpacklo_epi32(ymm3, ymm7);
+      ymm3 = _mm256_srli_si256(ymm3, 4);
+      ymm3 = _mm256_unpacklo_epi32(ymm7, ymm3);
+
+      ymm3 = _mm256_add_epi16(ymm3, ymm2);
+      ymm3 = _mm256_add_epi16(ymm3, ymm2);
+
+      ymm2 = _mm256_slli_si256(ymm2, 4);
+      ymm3 = _mm256_add_epi16(ymm3, ymm2);
+    }
+
+    // Shift the result to 12 bit
+    if (inputFormat == LAVPixFmt_YUV420 && shift > 1) {
+      if (shift >= 5) {
+        ymm1 = _mm256_srli_epi16(ymm1, 4);
+        ymm3 = _mm256_srli_epi16(ymm3, 4);
+      } else {
+        ymm1 = _mm256_srli_epi16(ymm1, SHIFTFIX(shift-1));
+        ymm3 = _mm256_srli_epi16(ymm3, SHIFTFIX(shift-1));
+      }
+    } else if (inputFormat == LAVPixFmt_YUV422) {
+      if (shift >= 7) {
+        ymm1 = _mm256_srli_epi16(ymm1, 4);
+        ymm3 = _mm256_srli_epi16(ymm3, 4);
+      } else if (shift > 3) {
+        ymm1 = _mm256_srli_epi16(ymm1, SHIFTFIX(shift-3));
+        ymm3 = _mm256_srli_epi16(ymm3, SHIFTFIX(shift-3));
+      } else if (shift < 3) {
+        ymm1 = _mm256_slli_epi16(ymm1, SHIFTFIX(3-shift));
+        ymm3 = _mm256_slli_epi16(ymm3, SHIFTFIX(3-shift));
+      }
+    } else if ((inputFormat == LAVPixFmt_YUV420 && shift == 0) || inputFormat == LAVPixFmt_NV12) {
+      ymm1 = _mm256_slli_epi16(ymm1, 1);
+      ymm3 = _mm256_slli_epi16(ymm3, 1);
+    }
+  } else if (inputFormat == LAVPixFmt_YUV444) {
+    if (shift > 4) {
+      ymm1 = _mm256_srli_epi16(ymm0, SHIFTFIX(shift-4));
+      ymm3 = _mm256_srli_epi16(ymm2, SHIFTFIX(shift-4));
+    } else if (shift < 4) {
+      ymm1 = _mm256_slli_epi16(ymm0, SHIFTFIX(4-shift));
+      ymm3 = _mm256_slli_epi16(ymm2, SHIFTFIX(4-shift));
+    } else {
+      ymm1 = ymm0;
+      ymm3 = ymm2;
+    }
+  }
+
+  // Load Y
+  if (shift > 0) {
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm5, srcY, lumaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm0, srcY+srcStrideY, lumaStep);
+  } else {
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm5, srcY, lumaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm0, srcY+srcStrideY, lumaStep);
+
+    ymm5 = _mm256_unpacklo_epi8(ymm5, ymm7);                    /* YYYY0000 (16-bit fields) */
+    ymm0 = _mm256_unpacklo_epi8(ymm0, ymm7);                    /* YYYY0000 (16-bit fields) */
+  }
+  srcY += lumaStep * 2;
+
+  ymm0 = _mm256_unpacklo_epi64(ymm0, ymm5);                     /* YYYYYYYY */
+
+  if (!ycgco) {
+    if (shift < 6) {
+      ymm0 = _mm256_slli_epi16(ymm0, SHIFTFIX(6-shift));
+    } else if (shift > 6) {
+      ymm0 = _mm256_srli_epi16(ymm0, SHIFTFIX(shift-6));
+    }
+    ymm0 = _mm256_subs_epu16(ymm0, _mm256_broadcastsi128_si256(coeffs->Ysub));
+    ymm0 = _mm256_mulhi_epi16(ymm0, _mm256_broadcastsi128_si256(coeffs->cy));
+    ymm0 = _mm256_add_epi16(ymm0, _mm256_broadcastsi128_si256(coeffs->rgb_add));
+
+    ymm2 = _mm256_broadcastsi128_si256(coeffs->CbCr_center);
+    ymm1 = _mm256_subs_epi16(ymm1, ymm2);
+    ymm3 = _mm256_subs_epi16(ymm3, ymm2);
+
+    ymm2 = _mm256_broadcastsi128_si256(coeffs->cR_Cr);
+    ymm6 = _mm256_madd_epi16(ymm1, ymm2);
+    ymm4 = _mm256_madd_epi16(ymm3, ymm2);
+    ymm6 = _mm256_srai_epi32(ymm6, 13);
+    ymm4 = _mm256_srai_epi32(ymm4, 13);
+    ymm6 = _mm256_packs_epi32(ymm6, ymm7);
+    ymm4 = _mm256_packs_epi32(ymm4, ymm7);
+    ymm6 = _mm256_unpacklo_epi64(ymm4, ymm6);
+    ymm6 = _mm256_add_epi16(ymm6, ymm0);                        /* R (12bit) */
+
+    ymm2 = _mm256_broadcastsi128_si256(coeffs->cG_Cb_cG_Cr);
+    ymm5 = _mm256_madd_epi16(ymm1, ymm2);
+    ymm4 = _mm256_madd_epi16(ymm3, ymm2);
+    ymm5 = _mm256_srai_epi32(ymm5, 13);
+    ymm4 = _mm256_srai_epi32(ymm4, 13);
+    ymm5 = _mm256_packs_epi32(ymm5, ymm7);
+    ymm4 = _mm256_packs_epi32(ymm4, ymm7);
+    ymm5 = _mm256_unpacklo_epi64(ymm4, ymm5);
+    ymm5 = _mm256_add_epi16(ymm5, ymm0);                        /* G (12bit) */
+
+    ymm2 = _mm256_broadcastsi128_si256(coeffs->cB_Cb);
+    ymm1 = _mm256_madd_epi16(ymm1, ymm2);
+    ymm3 = _mm256_madd_epi16(ymm3, ymm2);
+    ymm1 = _mm256_srai_epi32(ymm1, 13);
+    ymm3 = _mm256_srai_epi32(ymm3, 13);
+    ymm1 = _mm256_packs_epi32(ymm1, ymm7);
+    ymm3 = _mm256_packs_epi32(ymm3, ymm7);
+    ymm1 = _mm256_unpacklo_epi64(ymm3, ymm1);
+    ymm1 = _mm256_add_epi16(ymm1, ymm0);                        /* B (12bit) */
+  } else {
+    if (shift < 4) {
+      ymm0 = _mm256_slli_epi16(ymm0, SHIFTFIX(4-shift));
+    } else if (shift > 4) {
+      ymm0 = _mm256_srli_epi16(ymm0, SHIFTFIX(shift-4));
+    }
+
+    ymm7 = _mm256_set1_epi32(0x0000FFFF);
+    ymm2 = ymm1;
+    ymm4 = ymm3;
+
+    ymm1 = _mm256_and_si256(ymm1, ymm7);                        /* Cg */
+    ymm4 = _mm256_and_si256(ymm4, ymm7);
+
+    ymm3 = _mm256_srli_epi32(ymm3, 16);                         /* Co */
+    ymm2 = _mm256_srli_epi32(ymm2, 16);
+
+    ymm1 = _mm256_packs_epi32(ymm4, ymm1);
+    ymm3 = _mm256_packs_epi32(ymm3, ymm2);
+
+    ymm2 = _mm256_broadcastsi128_si256(coeffs->CbCr_center);
+    ymm1 = _mm256_subs_epi16(ymm1, ymm2);
+    ymm3 = _mm256_subs_epi16(ymm3, ymm2);
+
+    ymm2 = _mm256_subs_epi16(ymm0, ymm1);                       /* tmp = Y - Cg */
+    ymm6 = _mm256_adds_epi16(ymm2, ymm3);                       /* R = tmp + Co */
+    ymm5 = _mm256_adds_epi16(ymm0, ymm1);                       /* G = Y + Cg */
+    ymm1 = _mm256_subs_epi16(ymm2, ymm3);                       /* B = tmp - Co */
+
+    ymm7 = _mm256_setzero_si256();
+  }
+
+  // Dithering
+  if (dithertype == LAVDither_Random) {
+    // Each block has its own coefficients
+    const ptrdiff_t offset = (pos % (DITHER_STEPS * 4 * 2)) * 6;
+    const ptrdiff_t offset2 = ((pos + 4) % (DITHER_STEPS * 4 * 2)) * 6;
+    ymm2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *)(dithers +  0 + offset))), _mm_load_si128((const __m128i *)(dithers +  0 + offset2)), 1);
+    ymm3 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *)(dithers +  8 + offset))), _mm_load_si128((const __m128i *)(dithers +  8 + offset2)), 1);
+    ymm4 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *)(dithers + 16 + offset))), _mm_load_si128((const __m128i *)(dithers + 16 + offset2)), 1);
+  } else {
+    ymm2 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)dither_8x8_256[line % 8]));
+    ymm3 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)dither_8x8_256[(line+1) % 8]));
+
+    ymm4 = _mm256_unpackhi_epi64(ymm2, ymm3);
+    ymm2 = _mm256_unpacklo_epi64(ymm2, ymm3);
+    ymm2 = _mm256_srli_epi16(ymm2, 4);
+    ymm4 = _mm256_srli_epi16(ymm4, 4);
+
+    ymm3 = ymm4;
+  }
+
+  ymm6 = _mm256_adds_epu16(ymm6, ymm2);
+  ymm5 = _mm256_adds_epu16(ymm5, ymm3);
+  ymm1 = _mm256_adds_epu16(ymm1, ymm4);
+
+  ymm6 = _mm256_srai_epi16(ymm6, 4);                            /* Shift to 8 bit */
+  ymm5 = _mm256_srai_epi16(ymm5, 4);
+  ymm1 = _mm256_srai_epi16(ymm1, 4);
+
+  ymm2 = _mm256_cmpeq_epi8(ymm2, ymm2);
+  ymm6 = _mm256_packus_epi16(ymm6, ymm7);                       /* R */
+  ymm5 = _mm256_packus_epi16(ymm5, ymm7);                       /* G */
+  ymm1 = _mm256_packus_epi16(ymm1, ymm7);                       /* B */
+
+  ymm6 = _mm256_unpacklo_epi8(ymm6, ymm2);                      // 0xff,R
+  ymm1 = _mm256_unpacklo_epi8(ymm1, ymm5);                      // G,B
+
+  ymm2 = _mm256_unpacklo_epi16(ymm1, ymm6);                     // 0xff,RGB * 8 (line 1)
+  ymm1 = _mm256_unpackhi_epi16(ymm1, ymm6);                     // 0xff,RGB * 8 (line 0)
+
+  if (out32) {
+    pixconv_put_stream((__m128i *)(dst), dstEnd, _mm256_castsi256_si128(ymm1), bStream);
+    pixconv_put_stream((__m128i *)(dst + 16), dstEnd, _mm256_extracti128_si256(ymm1, 1), bStream);
+    pixconv_put_stream((__m128i *)(dst + dstStride), dstEnd + dstStride, _mm256_castsi256_si128(ymm2), bStream);
+    pixconv_put_stream((__m128i *)(dst + dstStride + 16), dstEnd + dstStride, _mm256_extracti128_si256(ymm2, 1), bStream);
+    dst += 32;
+  } else {
+    // Drop the alpha bytes, and move the 12 bytes of each lane together
+    const __m256i shuf = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    ymm1 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(ymm1, shuf), perm);
+    ymm2 = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(ymm2, shuf), perm);
+
+    _mm_storeu_si128((__m128i *)(dst), _mm256_castsi256_si128(ymm1));
+    _mm_storel_epi64((__m128i *)(dst + 16), _mm256_extracti128_si256(ymm1, 1));
+    _mm_storeu_si128((__m128i *)(dst + dstStride), _mm256_castsi256_si128(ymm2));
+    _mm_storel_epi64((__m128i *)(dst + dstStride + 16), _mm256_extracti128_si256(ymm2, 1));
+    dst += 24;
+  }
+
+  return 0;
+}
+
+template <LAVPixelFormat inputFormat, int shift, int out32, int dithertype, int ycgco, int siting>
+struct yuv2rgb_convert_blocks_x2<inputFormat, shift, out32, dithertype, ycgco, siting, 1> {
+  static __forceinline ptrdiff_t convert(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, RGBCoeffs *coeffs, const uint16_t* &dithers, ptrdiff_t i, ptrdiff_t endx, BOOL bStream)
+  {
+    for (; (i + 4) < endx; i += 8) {
+      yuv2rgb_convert_pixels_avx2<inputFormat, shift, out32, dithertype, ycgco, siting>(srcY, srcU, srcV, dst, dstEnd, srcStrideY, srcStrideUV, dstStride, line, coeffs, dithers, i, bStream);
+    }
+    return i;
+  }
+};
+
+template <int out32>
+DECLARE_CONV_FUNC_IMPL(convert_yuv_rgb_avx2)
+{
+  HRESULT hr = convert_yuv_rgb_impl<out32, 1>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
+  _mm256_zeroupper();
+  return hr;
+}
+
+// Force creation of these variants
+template HRESULT CLAVPixFmtConverter::convert_yuv_rgb_avx2<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv_rgb_avx2<1>CONV_FUNC_PARAMS;
+
+#pragma warning(pop)
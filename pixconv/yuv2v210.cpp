@@ -0,0 +1,210 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+#include "yuv2v210.h"
+
+// SIMD versions of ConvertTov210 and ConvertTov410 in convert_generic.cpp, for input that needs no scaling
+// They produce the same output as the scalar versions. 8-bit input is scaled to 10-bit by a plain shift.
+//
+// v210 packs 6 pixels of 4:2:2 into four 32-bit words, three 10-bit components each:
+//   U0 Y0 V0 | Y1 U1 Y2 | V1 Y3 U2 | Y4 V2 Y5
+// Every line is padded to a multiple of 48 pixels (128 bytes), the padding is cleared.
+//
+// v410 packs one 4:4:4 pixel into a 32-bit word: U << 2 | Y << 12 | V << 22
+
+// Sample type of the input planes
+template <int hbd> struct v210_sample      { typedef uint8_t type; };
+template <>        struct v210_sample<1>   { typedef uint16_t type; };
+
+template <int hbd>
+DECLARE_CONV_FUNC_IMPL(convert_yuv422_v210_ssse3)
+{
+  typedef typename v210_sample<hbd>::type sample_t;
+
+  const sample_t *y = (const sample_t *)src[0];
+  const sample_t *u = (const sample_t *)src[1];
+  const sample_t *v = (const sample_t *)src[2];
+
+  const ptrdiff_t inYStride = srcStride[0] / sizeof(sample_t);
+  const ptrdiff_t inUVStride = srcStride[1] / sizeof(sample_t);
+  const ptrdiff_t outStride = ((dstStride + 47) / 48) * 128;
+  const ptrdiff_t groups = width / 6;
+
+  ptrdiff_t line, i;
+
+  V210_SHUFFLE_MASKS(_mm_setr_epi8)
+  const __m128i mask10 = _mm_set1_epi16(0x03FF);
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i xmm0,xmm1,xmm2;
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * sliceYStart;
+  v += inUVStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    uint8_t *out = dst + line * outStride;
+    __m128i *dst128 = (__m128i *)out;
+
+    for (i = 0; i < groups; i++) {
+      if (hbd) {
+        V210_LOAD_GROUP16(xmm1, xmm2, (y+i*6), (u+i*3), (v+i*3));
+      } else {
+        V210_LOAD_GROUP8(xmm1, xmm2, (y+i*6), (u+i*3), (v+i*3));
+      }
+      V210_PACK_GROUP(xmm0, xmm1, xmm2);
+      PIXCONV_PUT_STREAM(dst128, out + outStride, xmm0);
+    }
+    v210_line_end<sample_t, hbd ? 0 : 2>(y, u, v, groups * 6, width, out, out + outStride);
+
+    y += inYStride;
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv422_v210_ssse3<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv422_v210_ssse3<1>CONV_FUNC_PARAMS;
+
+// Load one group of 6 YUY2 pixels (12 bytes) as 10-bit values, in the same layout as V210_LOAD_GROUP8
+#define V210_LOAD_GROUP_YUY2(yy,uv,src)                                        \
+  yy = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(src)),             \
+                          _mm_cvtsi32_si128(*(const int *)((src) + 8)));       \
+  uv = _mm_shuffle_epi8(yy, shufYUY2UV);                                       \
+  yy = _mm_shuffle_epi8(yy, shufYUY2Y);                                        \
+  yy = _mm_slli_epi16(yy, 2);                                                  \
+  uv = _mm_slli_epi16(uv, 2);
+
+DECLARE_CONV_FUNC_IMPL(convert_yuy2_v210_ssse3)
+{
+  const uint8_t *yuy2 = src[0];
+
+  const ptrdiff_t inStride = srcStride[0];
+  const ptrdiff_t outStride = ((dstStride + 47) / 48) * 128;
+  const ptrdiff_t groups = width / 6;
+
+  ptrdiff_t line, i;
+
+  V210_SHUFFLE_MASKS(_mm_setr_epi8)
+  // Y0-Y5, and U0-U2/V0-V2 in the low/high half, zero-extended to 16-bit
+  const __m128i shufYUY2Y  = _mm_setr_epi8(0,-1, 2,-1, 4,-1,  6,-1,  8,-1, 10,-1, -1,-1,-1,-1);
+  const __m128i shufYUY2UV = _mm_setr_epi8(1,-1, 5,-1, 9,-1, -1,-1,  3,-1,  7,-1, 11,-1,-1,-1);
+
+  __m128i xmm0,xmm1,xmm2;
+
+  yuy2 += inStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    uint8_t *out = dst + line * outStride;
+    __m128i *dst128 = (__m128i *)out;
+
+    for (i = 0; i < groups; i++) {
+      V210_LOAD_GROUP_YUY2(xmm1, xmm2, (yuy2+i*12));
+      V210_PACK_GROUP(xmm0, xmm1, xmm2);
+      PIXCONV_PUT_STREAM(dst128, out + outStride, xmm0);
+    }
+
+    // Split the remaining pixels into planes for the scalar line end
+    uint8_t y[6] = {0}, u[3] = {0}, v[3] = {0};
+    const uint8_t *rest = yuy2 + groups * 12;
+    for (i = 0; i < width - groups * 6; i++) {
+      y[i] = rest[i * 2];
+      if (!(i & 1)) {
+        u[i >> 1] = rest[i * 2 + 1];
+        v[i >> 1] = rest[i * 2 + 3];
+      }
+    }
+    v210_line_end<uint8_t, 2>(y, u, v, 0, width - groups * 6, out + groups * 16, out + outStride);
+
+    yuy2 += inStride;
+  }
+
+  return S_OK;
+}
+
+DECLARE_CONV_FUNC_IMPL(convert_yuv444_v410)
+{
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inStride = srcStride[0] >> 1;
+  const ptrdiff_t outStride = dstStride << 2;
+  const int shift = 10 - bpp;
+
+  ptrdiff_t line, i;
+
+  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
+
+  xmm6 = _mm_set1_epi16(0x03FF);
+  xmm7 = _mm_setzero_si128();
+
+  y += inStride * sliceYStart;
+  u += inStride * sliceYStart;
+  v += inStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 2);
+
+    for (i = 0; i < width; i+=8) {
+      // Load pixels, and scale 9-bit to 10-bit
+      xmm0 = _mm_loadu_si128((const __m128i *)(y+i));       /* YYYY */
+      xmm1 = _mm_loadu_si128((const __m128i *)(u+i));       /* UUUU */
+      xmm2 = _mm_loadu_si128((const __m128i *)(v+i));       /* VVVV */
+      xmm0 = _mm_and_si128(_mm_slli_epi16(xmm0, shift), xmm6);
+      xmm1 = _mm_and_si128(_mm_slli_epi16(xmm1, shift), xmm6);
+      xmm2 = _mm_and_si128(_mm_slli_epi16(xmm2, shift), xmm6);
+
+      // U << 2 | Y << 12 | V << 22
+      xmm3 = _mm_slli_epi32(_mm_unpacklo_epi16(xmm1, xmm7), 2);
+      xmm3 = _mm_or_si128(xmm3, _mm_slli_epi32(_mm_unpacklo_epi16(xmm0, xmm7), 12));
+      xmm3 = _mm_or_si128(xmm3, _mm_slli_epi32(_mm_unpacklo_epi16(xmm2, xmm7), 22));
+
+      xmm4 = _mm_slli_epi32(_mm_unpackhi_epi16(xmm1, xmm7), 2);
+      xmm4 = _mm_or_si128(xmm4, _mm_slli_epi32(_mm_unpackhi_epi16(xmm0, xmm7), 12));
+      xmm4 = _mm_or_si128(xmm4, _mm_slli_epi32(_mm_unpackhi_epi16(xmm2, xmm7), 22));
+
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm4);
+    }
+
+    y += inStride;
+    u += inStride;
+    v += inStride;
+  }
+
+  return S_OK;
+}
@@ -0,0 +1,110 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+// Helpers of the v210 converters, shared by the SSSE3 converters in yuv2v210.cpp and the AVX2 converters in yuv2v210_avx2.cpp
+// See yuv2v210.cpp for the layout of v210
+
+// Shuffle masks to gather the components of one v210 group into the three 10-bit slots of the words
+// Y holds Y0-Y7, UV holds U0-U3 in the low and V0-V3 in the high half, all as 16-bit values
+#define V210_SHUFFLE_MASKS(setr)                                                   \
+  /* slot 0: U0 Y1 V1 Y4 */                                                        \
+  const __m128i shufY0  = setr(-1,-1,-1,-1,  2, 3,-1,-1, -1,-1,-1,-1,  8, 9,-1,-1); \
+  const __m128i shufUV0 = setr( 0, 1,-1,-1, -1,-1,-1,-1, 10,11,-1,-1, -1,-1,-1,-1); \
+  /* slot 1: Y0 U1 Y3 V2 */                                                        \
+  const __m128i shufY1  = setr( 0, 1,-1,-1, -1,-1,-1,-1,  6, 7,-1,-1, -1,-1,-1,-1); \
+  const __m128i shufUV1 = setr(-1,-1,-1,-1,  2, 3,-1,-1, -1,-1,-1,-1, 12,13,-1,-1); \
+  /* slot 2: V0 Y2 U2 Y5 */                                                        \
+  const __m128i shufY2  = setr(-1,-1,-1,-1,  4, 5,-1,-1, -1,-1,-1,-1, 10,11,-1,-1); \
+  const __m128i shufUV2 = setr( 8, 9,-1,-1, -1,-1,-1,-1,  4, 5,-1,-1, -1,-1,-1,-1);
+
+// Load the samples of one group of 6 pixels as 10-bit values
+// yy   - register to receive Y0-Y7
+// uv   - register to receive U0-U3 and V0-V3
+// y    - pointer to Y0 of the group
+// u, v - pointer to U0/V0 of the group
+#define V210_LOAD_GROUP16(yy,uv,y,u,v)                                         \
+  yy = _mm_loadu_si128((const __m128i *)(y));                                  \
+  uv = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(u)),               \
+                          _mm_loadl_epi64((const __m128i *)(v)));              \
+  yy = _mm_and_si128(yy, mask10);                                              \
+  uv = _mm_and_si128(uv, mask10);
+
+#define V210_LOAD_GROUP8(yy,uv,y,u,v)                                          \
+  yy = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y)), zero);         \
+  uv = _mm_unpacklo_epi32(_mm_cvtsi32_si128(*(const int *)(u)),                \
+                          _mm_cvtsi32_si128(*(const int *)(v)));               \
+  uv = _mm_unpacklo_epi8(uv, zero);                                            \
+  yy = _mm_slli_epi16(yy, 2);                                                  \
+  uv = _mm_slli_epi16(uv, 2);
+
+// Pack one group of 6 pixels into a register
+// reg  - register to receive the 4 words
+// yy   - Y0-Y7, as loaded by V210_LOAD_GROUP16/8
+// uv   - U0-U3 and V0-V3, as loaded by V210_LOAD_GROUP16/8
+#define V210_PACK_GROUP(reg,yy,uv)                                             \
+  {                                                                            \
+    reg = _mm_or_si128(_mm_shuffle_epi8(yy, shufY0), _mm_shuffle_epi8(uv, shufUV0));                              \
+    reg = _mm_or_si128(reg, _mm_slli_epi32(_mm_or_si128(_mm_shuffle_epi8(yy, shufY1), _mm_shuffle_epi8(uv, shufUV1)), 10)); \
+    reg = _mm_or_si128(reg, _mm_slli_epi32(_mm_or_si128(_mm_shuffle_epi8(yy, shufY2), _mm_shuffle_epi8(uv, shufUV2)), 20)); \
+  }
+
+// Write the pixels at the end of a line that do not fill a complete group, exactly like ConvertTov210, and clear the padding
+// w    - first pixel that has not been written yet, a multiple of 6
+// out  - start of the output line
+// end  - end of the output line, including the padding
+template <typename T, int shift>
+static __forceinline void v210_line_end(const T *y, const T *u, const T *v, ptrdiff_t w, ptrdiff_t width, uint8_t *out, uint8_t *end)
+{
+  uint32_t *p = (uint32_t *)(out + (w / 6) * 16);
+  y += w;
+  u += w >> 1;
+  v += w >> 1;
+
+#define CLIP(v) (((uint32_t)(v) << shift) & 0x03FF)
+  // Words of a group: U0 Y0 V0, Y1 U1 Y2, V1 Y3 U2, Y4 V2 Y5
+  const ptrdiff_t left = width - w;
+  if (left > 0) {
+    uint32_t val;
+    *p++ = CLIP(u[0]) | (CLIP(y[0]) << 10) | (CLIP(v[0]) << 20);
+    if (left > 1) {
+      val = CLIP(y[1]);
+      if (left > 2)
+        val |= (CLIP(u[1]) << 10) | (CLIP(y[2]) << 20);
+      *p++ = val;
+    }
+    if (left > 2) {
+      val = CLIP(v[1]);
+      if (left > 3)
+        val |= (CLIP(y[3]) << 10);
+      if (left > 4)
+        val |= (CLIP(u[2]) << 20);
+      *p++ = val;
+    }
+    if (left > 4)
+      *p++ = CLIP(y[4]) | (CLIP(v[2]) << 10);
+  }
+#undef CLIP
+
+  memset(p, 0, end - (uint8_t *)p);
+}
@@ -0,0 +1,155 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <immintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+#include "pixconv_avx2_templates.h"
+#include "yuv2v210.h"
+
+// AVX2 versions of the v210 and v410 converters in yuv2v210.cpp, with the same output
+// This file is compiled with AVX2 code generation, it must only be called after checking for AVX2 support.
+
+DECLARE_CONV_FUNC_IMPL(convert_yuv422_v210_avx2)
+{
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inYStride = srcStride[0] >> 1;
+  const ptrdiff_t inUVStride = srcStride[1] >> 1;
+  const ptrdiff_t outStride = ((dstStride + 47) / 48) * 128;
+  const ptrdiff_t groups = width / 6;
+
+  ptrdiff_t line, i;
+
+  V210_SHUFFLE_MASKS(_mm_setr_epi8)
+  const __m128i mask10 = _mm_set1_epi16(0x03FF);
+
+  // The same masks in both lanes, each lane packs one group
+  const __m256i ymask10   = _mm256_broadcastsi128_si256(mask10);
+  const __m256i yshufY0   = _mm256_broadcastsi128_si256(shufY0);
+  const __m256i yshufUV0  = _mm256_broadcastsi128_si256(shufUV0);
+  const __m256i yshufY1   = _mm256_broadcastsi128_si256(shufY1);
+  const __m256i yshufUV1  = _mm256_broadcastsi128_si256(shufUV1);
+  const __m256i yshufY2   = _mm256_broadcastsi128_si256(shufY2);
+  const __m256i yshufUV2  = _mm256_broadcastsi128_si256(shufUV2);
+
+  __m256i ymm0,ymm1,ymm2;
+  __m128i xmm0,xmm1,xmm2;
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * sliceYStart;
+  v += inUVStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    uint8_t *out = dst + line * outStride;
+    __m128i *dst128 = (__m128i *)out;
+
+    // Two groups (12 pixels) at a time
+    for (i = 0; (i + 2) <= groups; i += 2) {
+      const uint16_t *yg = y + i * 6, *ug = u + i * 3, *vg = v + i * 3;
+
+      ymm0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)yg)), _mm_loadu_si128((const __m128i *)(yg + 6)), 1); /* Y0-Y7 | Y6-Y13 */
+      ymm1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)ug), _mm_loadl_epi64((const __m128i *)vg))),
+                                     _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(ug + 3)), _mm_loadl_epi64((const __m128i *)(vg + 3))), 1); /* U0-U3 V0-V3 | U3-U6 V3-V6 */
+      ymm0 = _mm256_and_si256(ymm0, ymask10);
+      ymm1 = _mm256_and_si256(ymm1, ymask10);
+
+      ymm2 = _mm256_or_si256(_mm256_shuffle_epi8(ymm0, yshufY0), _mm256_shuffle_epi8(ymm1, yshufUV0));
+      ymm2 = _mm256_or_si256(ymm2, _mm256_slli_epi32(_mm256_or_si256(_mm256_shuffle_epi8(ymm0, yshufY1), _mm256_shuffle_epi8(ymm1, yshufUV1)), 10));
+      ymm2 = _mm256_or_si256(ymm2, _mm256_slli_epi32(_mm256_or_si256(_mm256_shuffle_epi8(ymm0, yshufY2), _mm256_shuffle_epi8(ymm1, yshufUV2)), 20));
+
+      PIXCONV_PUT_STREAM_AVX2(dst128, out + outStride, ymm2);
+    }
+
+    // Last full group
+    if (i < groups) {
+      V210_LOAD_GROUP16(xmm1, xmm2, (y+i*6), (u+i*3), (v+i*3));
+      V210_PACK_GROUP(xmm0, xmm1, xmm2);
+      PIXCONV_PUT_STREAM(dst128, out + outStride, xmm0);
+    }
+    v210_line_end<uint16_t, 0>(y, u, v, groups * 6, width, out, out + outStride);
+
+    y += inYStride;
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  _mm256_zeroupper();
+
+  return S_OK;
+}
+
+DECLARE_CONV_FUNC_IMPL(convert_yuv444_v410_avx2)
+{
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inStride = srcStride[0] >> 1;
+  const ptrdiff_t outStride = dstStride << 2;
+  const int shift = 10 - bpp;
+
+  ptrdiff_t line, i;
+
+  __m256i ymm0,ymm1,ymm2,ymm3;
+  const __m256i ymm7 = _mm256_set1_epi32(0x03FF);
+
+  y += inStride * sliceYStart;
+  u += inStride * sliceYStart;
+  v += inStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 2);
+
+    for (i = 0; i < width; i+=8) {
+      // Load 8 pixels, extended to 32-bit, and scale 9-bit to 10-bit
+      ymm0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(y+i)));  /* Y0Y0Y0Y0 */
+      ymm1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(u+i)));  /* U0U0U0U0 */
+      ymm2 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(v+i)));  /* V0V0V0V0 */
+      ymm0 = _mm256_and_si256(_mm256_slli_epi32(ymm0, shift), ymm7);
+      ymm1 = _mm256_and_si256(_mm256_slli_epi32(ymm1, shift), ymm7);
+      ymm2 = _mm256_and_si256(_mm256_slli_epi32(ymm2, shift), ymm7);
+
+      // U << 2 | Y << 12 | V << 22
+      ymm3 = _mm256_slli_epi32(ymm1, 2);
+      ymm3 = _mm256_or_si256(ymm3, _mm256_slli_epi32(ymm0, 12));
+      ymm3 = _mm256_or_si256(ymm3, _mm256_slli_epi32(ymm2, 22));
+
+      PIXCONV_PUT_STREAM_AVX2(dst128, end, ymm3);
+    }
+
+    y += inStride;
+    u += inStride;
+    v += inStride;
+  }
+
+  _mm256_zeroupper();
+
+  return S_OK;
+}
@@ -51,6 +51,9 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv_nv12_dither_le)
     outChromaStride = outChromaStride >> 1;
   }
 
+  const ptrdiff_t chromaSliceStart = (chromaHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t chromaSliceEnd   = (chromaHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
+
   ptrdiff_t line, i;
 
   __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
@@ -59,10 +62,14 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv_nv12_dither_le)
   uint8_t *dstV = dstY + outLumaStride * height;
   uint8_t *dstU = dstV + outChromaStride * chromaHeight;
 
+  y += inYStride * sliceYStart;
+  u += inUVStride * chromaSliceStart;
+  v += inUVStride * chromaSliceStart;
+
   _mm_sfence();
 
   // Process Y
-  for (line = 0; line < height; ++line) {
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
     // Load dithering coefficients for this line
     if (ditherMode == LAVDither_Random) {
       xmm4 = _mm_load_si128((const __m128i *)(dithers + (line << 5) + 0));
@@ -75,6 +82,7 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv_nv12_dither_le)
     }
 
     __m128i *dst128Y = (__m128i *)(dstY + line * outLumaStride);
+    const uint8_t *endY = (const uint8_t *)dst128Y + width;
 
     for (i = 0; i < width; i+=32) {
       // Load pixels into registers, and apply dithering
@@ -86,42 +94,56 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv_nv12_dither_le)
       xmm2 = _mm_packus_epi16(xmm2, xmm3);                     /* YYYYYYYY */
 
       // Write data back
-      _mm_stream_si128(dst128Y++, xmm0);
-      _mm_stream_si128(dst128Y++, xmm2);
+      PIXCONV_PUT_STREAM(dst128Y, endY, xmm0);
+      PIXCONV_PUT_STREAM(dst128Y, endY, xmm2);
     }
 
-    // Process U/V for chromaHeight lines
-    if (line < chromaHeight) {
-      __m128i *dst128UV = (__m128i *)(dstV + line * outLumaStride);
-      __m128i *dst128U = (__m128i *)(dstU + line * outChromaStride);
-      __m128i *dst128V = (__m128i *)(dstV + line * outChromaStride);
-
-       for (i = 0; i < chromaWidth; i+=16) {
-        PIXCONV_LOAD_PIXEL16_DITHER(xmm0, xmm4, (u+i+0), bpp);  /* U0U0U0U0 */
-        PIXCONV_LOAD_PIXEL16_DITHER(xmm1, xmm5, (u+i+8), bpp);  /* U0U0U0U0 */
-        PIXCONV_LOAD_PIXEL16_DITHER(xmm2, xmm6, (v+i+0), bpp);  /* V0V0V0V0 */
-        PIXCONV_LOAD_PIXEL16_DITHER(xmm3, xmm7, (v+i+8), bpp);  /* V0V0V0V0 */
-
-        xmm0 = _mm_packus_epi16(xmm0, xmm1);                    /* UUUUUUUU */
-        xmm2 = _mm_packus_epi16(xmm2, xmm3);                    /* VVVVVVVV */
-        if (nv12) {
-          xmm1 = xmm0;
-          xmm0 = _mm_unpacklo_epi8(xmm0, xmm2);
-          xmm1 = _mm_unpackhi_epi8(xmm1, xmm2);
-
-          _mm_stream_si128(dst128UV++, xmm0);
-          _mm_stream_si128(dst128UV++, xmm1);
-        } else {
-          _mm_stream_si128(dst128U++, xmm0);
-          _mm_stream_si128(dst128V++, xmm2);
-        }
-      }
+    y += inYStride;
+  }
+
+  // Process U/V
+  // Chroma line n uses the same dithering coefficients as luma line n
+  for (line = chromaSliceStart; line < chromaSliceEnd; ++line) {
+    if (ditherMode == LAVDither_Random) {
+      xmm4 = _mm_load_si128((const __m128i *)(dithers + (line << 5) + 0));
+      xmm5 = _mm_load_si128((const __m128i *)(dithers + (line << 5) + 8));
+      xmm6 = _mm_load_si128((const __m128i *)(dithers + (line << 5) + 16));
+      xmm7 = _mm_load_si128((const __m128i *)(dithers + (line << 5) + 24));
+    } else {
+      PIXCONV_LOAD_DITHER_COEFFS(xmm7,line,8,dithers);
+      xmm4 = xmm5 = xmm6 = xmm7;
+    }
 
-      u += inUVStride;
-      v += inUVStride;
+    __m128i *dst128UV = (__m128i *)(dstV + line * outLumaStride);
+    __m128i *dst128U = (__m128i *)(dstU + line * outChromaStride);
+    __m128i *dst128V = (__m128i *)(dstV + line * outChromaStride);
+    const uint8_t *endUV = (const uint8_t *)dst128UV + (chromaWidth << 1);
+    const uint8_t *endU = (const uint8_t *)dst128U + chromaWidth;
+    const uint8_t *endV = (const uint8_t *)dst128V + chromaWidth;
+
+    for (i = 0; i < chromaWidth; i+=16) {
+      PIXCONV_LOAD_PIXEL16_DITHER(xmm0, xmm4, (u+i+0), bpp);  /* U0U0U0U0 */
+      PIXCONV_LOAD_PIXEL16_DITHER(xmm1, xmm5, (u+i+8), bpp);  /* U0U0U0U0 */
+      PIXCONV_LOAD_PIXEL16_DITHER(xmm2, xmm6, (v+i+0), bpp);  /* V0V0V0V0 */
+      PIXCONV_LOAD_PIXEL16_DITHER(xmm3, xmm7, (v+i+8), bpp);  /* V0V0V0V0 */
+
+      xmm0 = _mm_packus_epi16(xmm0, xmm1);                    /* UUUUUUUU */
+      xmm2 = _mm_packus_epi16(xmm2, xmm3);                    /* VVVVVVVV */
+      if (nv12) {
+        xmm1 = xmm0;
+        xmm0 = _mm_unpacklo_epi8(xmm0, xmm2);
+        xmm1 = _mm_unpackhi_epi8(xmm1, xmm2);
+
+        PIXCONV_PUT_STREAM(dst128UV, endUV, xmm0);
+        PIXCONV_PUT_STREAM(dst128UV, endUV, xmm1);
+      } else {
+        PIXCONV_PUT_STREAM(dst128U, endU, xmm0);
+        PIXCONV_PUT_STREAM(dst128V, endV, xmm2);
+      }
     }
 
-    y += inYStride;
+    u += inUVStride;
+    v += inUVStride;
   }
 
   return S_OK;
@@ -142,23 +164,30 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv420_px1x_le)
   const ptrdiff_t outStride = dstStride << 1;
   const ptrdiff_t uvHeight = (outputFormat == LAVOutPixFmt_P010 || outputFormat == LAVOutPixFmt_P016) ? (height >> 1) : height;
   const ptrdiff_t uvWidth = (width + 1) >> 1;
+  const ptrdiff_t uvSliceStart = (uvHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t uvSliceEnd   = (uvHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
 
   ptrdiff_t line, i;
   __m128i xmm0,xmm1,xmm2;
 
+  y += inYStride * sliceYStart;
+  u += inUVStride * uvSliceStart;
+  v += inUVStride * uvSliceStart;
+
   _mm_sfence();
 
   // Process Y
-  for (line = 0; line < height; ++line) {
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
     __m128i *dst128Y = (__m128i *)(dst + line * outStride);
+    const uint8_t *endY = (const uint8_t *)dst128Y + (width << 1);
 
     for (i = 0; i < width; i+=16) {
       // Load 8 pixels into register
       PIXCONV_LOAD_PIXEL16(xmm0, (y+i+0), bpp); /* YYYY */
       PIXCONV_LOAD_PIXEL16(xmm1, (y+i+8), bpp); /* YYYY */
       // and write them out
-      _mm_stream_si128(dst128Y++, xmm0);
-      _mm_stream_si128(dst128Y++, xmm1);
+      PIXCONV_PUT_STREAM(dst128Y, endY, xmm0);
+      PIXCONV_PUT_STREAM(dst128Y, endY, xmm1);
     }
 
     y += inYStride;
@@ -167,8 +196,9 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv420_px1x_le)
   BYTE *dstUV = dst + (height * outStride);
 
   // Process UV
-  for (line = 0; line < uvHeight; ++line) {
+  for (line = uvSliceStart; line < uvSliceEnd; ++line) {
     __m128i *dst128UV = (__m128i *)(dstUV + line * outStride);
+    const uint8_t *endUV = (const uint8_t *)dst128UV + (uvWidth << 2);
 
     for (i = 0; i < uvWidth; i+=8) {
       // Load 8 pixels into register
@@ -179,8 +209,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv420_px1x_le)
       xmm0 = _mm_unpacklo_epi16(xmm1, xmm0);    /* UVUV */
       xmm2 = _mm_unpackhi_epi16(xmm1, xmm2);    /* UVUV */
 
-      _mm_stream_si128(dst128UV++, xmm0);
-      _mm_stream_si128(dst128UV++, xmm2);
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm0);
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm2);
     }
 
     u += inUVStride;
@@ -212,44 +242,35 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv)
     outChromaStride = outChromaStride >> 1;
   }
 
+  const ptrdiff_t chromaSliceStart = (chromaHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t chromaSliceEnd   = (chromaHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
+
   uint8_t *dstY = dst;
   uint8_t *dstV = dstY + height * outLumaStride;
   uint8_t *dstU = dstV + chromaHeight * outChromaStride;
 
+  y += inLumaStride * sliceYStart;
+  u += inChromaStride * chromaSliceStart;
+  v += inChromaStride * chromaSliceStart;
+
   // Copy planes
 
   _mm_sfence();
 
   // Y
-  if ((outLumaStride % 16) == 0 && ((intptr_t)dst % 16u) == 0) {
-    for(line = 0; line < height; ++line) {
-      PIXCONV_MEMCPY_ALIGNED(dstY + outLumaStride * line, y, width);
-      y += inLumaStride;
-    }
-  } else {
-    for(line = 0; line < height; ++line) {
-      memcpy(dstY + outLumaStride * line, y, width);
-      y += inLumaStride;
-    }
+  for(line = sliceYStart; line < sliceYEnd; ++line) {
+    PIXCONV_MEMCPY_ALIGNED(dstY + outLumaStride * line, y, width);
+    y += inLumaStride;
   }
 
   // U/V
-  if ((outChromaStride % 16) == 0 && ((intptr_t)dst % 16u) == 0) {
-    for(line = 0; line < chromaHeight; ++line) {
-      PIXCONV_MEMCPY_ALIGNED_TWO(
-        dstU + outChromaStride * line, u,
-        dstV + outChromaStride * line, v,
-        chromaWidth);
-      u += inChromaStride;
-      v += inChromaStride;
-    }
-  } else {
-    for(line = 0; line < chromaHeight; ++line) {
-      memcpy(dstU + outChromaStride * line, u, chromaWidth);
-      memcpy(dstV + outChromaStride * line, v, chromaWidth);
-      u += inChromaStride;
-      v += inChromaStride;
-    }
+  for(line = chromaSliceStart; line < chromaSliceEnd; ++line) {
+    PIXCONV_MEMCPY_ALIGNED_TWO(
+      dstU + outChromaStride * line, u,
+      dstV + outChromaStride * line, v,
+      chromaWidth);
+    u += inChromaStride;
+    v += inChromaStride;
   }
 
   return S_OK;
@@ -271,20 +292,28 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv420_nv12)
   uint8_t *dstY = dst;
   uint8_t *dstUV = dstY + height * outStride;
 
+  const ptrdiff_t chromaSliceStart = sliceYStart >> 1;
+  const ptrdiff_t chromaSliceEnd   = sliceYEnd >> 1;
+
   ptrdiff_t line,i;
   __m128i xmm0,xmm1,xmm2,xmm3;
 
+  y += inLumaStride * sliceYStart;
+  u += inChromaStride * chromaSliceStart;
+  v += inChromaStride * chromaSliceStart;
+
   _mm_sfence();
 
   // Y
-  for(line = 0; line < height; ++line) {
+  for(line = sliceYStart; line < sliceYEnd; ++line) {
     PIXCONV_MEMCPY_ALIGNED32(dstY + outStride * line, y, width);
     y += inLumaStride;
   }
 
   // U/V
-  for(line = 0; line < chromaHeight; ++line) {
+  for(line = chromaSliceStart; line < chromaSliceEnd; ++line) {
     __m128i *dst128UV = (__m128i *)(dstUV + line * outStride);
+    const uint8_t *endUV = (const uint8_t *)dst128UV + (chromaWidth << 1);
 
     for (i = 0; i < chromaWidth; i+=16) {
       PIXCONV_LOAD_PIXEL8_ALIGNED(xmm0, (v+i));  /* VVVV */
@@ -293,8 +322,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv420_nv12)
       xmm2 = _mm_unpacklo_epi8(xmm1, xmm0);      /* UVUV */
       xmm3 = _mm_unpackhi_epi8(xmm1, xmm0);      /* UVUV */
 
-      _mm_stream_si128(dst128UV++, xmm2);
-      _mm_stream_si128(dst128UV++, xmm3);
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm2);
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm3);
     }
 
     u += inChromaStride;
@@ -320,10 +349,15 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv422_yuy2_uyvy)
   ptrdiff_t line,i;
   __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5;
 
+  y += inLumaStride * sliceYStart;
+  u += inChromaStride * sliceYStart;
+  v += inChromaStride * sliceYStart;
+
   _mm_sfence();
 
-  for (line = 0;  line < height; ++line) {
+  for (line = sliceYStart;  line < sliceYEnd; ++line) {
     __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (chromaWidth << 2);
 
     for (i = 0; i < chromaWidth; i+=16) {
       // Load pixels
@@ -348,8 +382,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv422_yuy2_uyvy)
         xmm4 = _mm_unpackhi_epi8(xmm0, xmm4);
       }
 
-      _mm_stream_si128(dst128++, xmm3);
-      _mm_stream_si128(dst128++, xmm4);
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm4);
 
       // Interlave those with the Ys
       if (uyvy) {
@@ -362,8 +396,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv422_yuy2_uyvy)
         xmm2 = _mm_unpackhi_epi8(xmm1, xmm2);
       }
 
-      _mm_stream_si128(dst128++, xmm5);
-      _mm_stream_si128(dst128++, xmm2);
+      PIXCONV_PUT_STREAM(dst128, end, xmm5);
+      PIXCONV_PUT_STREAM(dst128, end, xmm2);
     }
     y += inLumaStride;
     u += inChromaStride;
@@ -397,10 +431,15 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv422_yuy2_uyvy_dither_le)
   ptrdiff_t line,i;
   __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
 
+  y += inLumaStride * sliceYStart;
+  u += inChromaStride * sliceYStart;
+  v += inChromaStride * sliceYStart;
+
   _mm_sfence();
 
-  for (line = 0;  line < height; ++line) {
+  for (line = sliceYStart;  line < sliceYEnd; ++line) {
     __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (chromaWidth << 2);
 
     // Load dithering coefficients for this line
     if (ditherMode == LAVDither_Random) {
@@ -439,8 +478,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv422_yuy2_uyvy_dither_le)
         xmm2 = _mm_unpackhi_epi8(xmm0, xmm2);
       }
 
-      _mm_stream_si128(dst128++, xmm3);
-      _mm_stream_si128(dst128++, xmm2);
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm2);
     }
     y += inLumaStride;
     u += inChromaStride;
@@ -472,19 +511,27 @@ DECLARE_CONV_FUNC_IMPL(convert_nv12_yv12)
   ptrdiff_t line, i;
   __m128i xmm0,xmm1,xmm2,xmm3,xmm7;
 
+  const ptrdiff_t chromaSliceStart = sliceYStart >> 1;
+  const ptrdiff_t chromaSliceEnd   = sliceYEnd >> 1;
+
   xmm7 = _mm_set1_epi16(0x00FF);
 
+  y  += inStride * sliceYStart;
+  uv += inStride * chromaSliceStart;
+
   _mm_sfence();
 
   // Copy the y
-  for (line = 0; line < height; line++) {
+  for (line = sliceYStart; line < sliceYEnd; line++) {
     PIXCONV_MEMCPY_ALIGNED(dstY + outLumaStride * line, y, width);
     y += inStride;
   }
 
-  for (line = 0; line < chromaHeight; line++) {
+  for (line = chromaSliceStart; line < chromaSliceEnd; line++) {
     __m128i *dstV128 = (__m128i *)(dstV + outChromaStride * line);
     __m128i *dstU128 = (__m128i *)(dstU + outChromaStride * line);
+    const uint8_t *endV = (const uint8_t *)dstV128 + ((width + 1) >> 1);
+    const uint8_t *endU = (const uint8_t *)dstU128 + ((width + 1) >> 1);
 
     for (i = 0; i < width; i+=32) {
       PIXCONV_LOAD_PIXEL8_ALIGNED(xmm0, uv+i+0);
@@ -502,8 +549,8 @@ DECLARE_CONV_FUNC_IMPL(convert_nv12_yv12)
       xmm0 = _mm_packus_epi16(xmm0, xmm1);
       xmm2 = _mm_packus_epi16(xmm2, xmm3);
 
-      _mm_stream_si128(dstU128++, xmm0);
-      _mm_stream_si128(dstV128++, xmm2);
+      PIXCONV_PUT_STREAM(dstU128, endU, xmm0);
+      PIXCONV_PUT_STREAM(dstV128, endV, xmm2);
     }
     uv += inStride;
   }
@@ -518,38 +565,30 @@ DECLARE_CONV_FUNC_IMPL(convert_nv12_nv12)
 
   const ptrdiff_t inStride = srcStride[0];
   const ptrdiff_t outStride = dstStride;
-  const ptrdiff_t chromaHeight = (height >> 1);
+  const ptrdiff_t chromaSliceStart = sliceYStart >> 1;
+  const ptrdiff_t chromaSliceEnd   = sliceYEnd >> 1;
 
   uint8_t *dstY = dst;
   uint8_t *dstUV = dstY + height * outStride;
 
   ptrdiff_t line;
 
-  _mm_sfence();
+  y  += inStride * sliceYStart;
+  uv += inStride * chromaSliceStart;
 
-  // Use SSE2 copy when the stride is aligned
-  if ((outStride % 16) == 0) {
-    // Copy the data
-    for (line = 0; line < height; line++) {
-      PIXCONV_MEMCPY_ALIGNED(dstY + outStride * line, y, width);
-      y += inStride;
-    }
+  _mm_sfence();
 
-    for (line = 0; line < chromaHeight; line++) {
-      PIXCONV_MEMCPY_ALIGNED(dstUV + outStride * line, uv, width);
-      uv += inStride;
-    }
-  } else {
-    // Copy the data
-    for (line = 0; line < height; line++) {
-      memcpy(dstY + outStride * line, y, width);
-      y += inStride;
-    }
+  // Copy the data
+  for (line = sliceYStart; line < sliceYEnd; line++) {
+    PIXCONV_MEMCPY_ALIGNED(dstY + outStride * line, y, width);
+    y += inStride;
+  }
 
-    for (line = 0; line < chromaHeight; line++) {
-      memcpy(dstUV + outStride * line, uv, width);
-      uv += inStride;
-    }
+  // The chroma line of an odd width ends with a full U/V pair
+  const int chromaWidth = (width + 1) & ~1;
+  for (line = chromaSliceStart; line < chromaSliceEnd; line++) {
+    PIXCONV_MEMCPY_ALIGNED(dstUV + outStride * line, uv, chromaWidth);
+    uv += inStride;
   }
 
   return S_OK;
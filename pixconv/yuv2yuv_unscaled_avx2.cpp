@@ -0,0 +1,236 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <immintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+#include "pixconv_avx2_templates.h"
+
+// AVX2 versions of the high bit-depth YUV converters in yuv2yuv_unscaled.cpp
+// They use the exact same arithmetic (and dithering coefficients per pixel), and produce bit-identical output.
+// Stores are still done in 128-bit units, and like the SSE2 versions can write into any destination.
+
+template <int nv12>
+DECLARE_CONV_FUNC_IMPL(convert_yuv_yv_nv12_dither_le_avx2)
+{
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inYStride = srcStride[0] >> 1;
+  const ptrdiff_t inUVStride = srcStride[1] >> 1;
+
+  ptrdiff_t outLumaStride    = dstStride;
+  ptrdiff_t outChromaStride  = dstStride;
+  ptrdiff_t chromaWidth      = width;
+  ptrdiff_t chromaHeight     = height;
+
+  LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
+  const uint16_t *dithers = GetRandomDitherCoeffs(height, 4, 8, 0);
+  if (dithers == NULL)
+    ditherMode = LAVDither_Ordered;
+
+  if (inputFormat == LAVPixFmt_YUV420bX)
+    chromaHeight = chromaHeight >> 1;
+  if (inputFormat == LAVPixFmt_YUV420bX || inputFormat == LAVPixFmt_YUV422bX) {
+    chromaWidth = (chromaWidth + 1) >> 1;
+    outChromaStride = outChromaStride >> 1;
+  }
+
+  const ptrdiff_t chromaSliceStart = (chromaHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t chromaSliceEnd   = (chromaHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
+
+  ptrdiff_t line, i;
+
+  __m256i ymm0,ymm1,ymm4,ymm5;
+  __m128i xmm0,xmm1,xmm2;
+
+  uint8_t *dstY = dst;
+  uint8_t *dstV = dstY + outLumaStride * height;
+  uint8_t *dstU = dstV + outChromaStride * chromaHeight;
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * chromaSliceStart;
+  v += inUVStride * chromaSliceStart;
+
+  _mm_sfence();
+
+  // Process Y
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    // Load dithering coefficients for this line
+    // ymm4 covers pixel 0-15 and ymm5 pixel 16-31 of each block of 32
+    if (ditherMode == LAVDither_Random) {
+      ymm4 = _mm256_loadu_si256((const __m256i *)(dithers + (line << 5) + 0));
+      ymm5 = _mm256_loadu_si256((const __m256i *)(dithers + (line << 5) + 16));
+    } else {
+      PIXCONV_LOAD_DITHER_COEFFS_AVX2(ymm5,line,8,dithers);
+      ymm4 = ymm5;
+    }
+
+    __m128i *dst128Y = (__m128i *)(dstY + line * outLumaStride);
+    const uint8_t *endY = (const uint8_t *)dst128Y + width;
+
+    for (i = 0; i < width; i+=32) {
+      // Load pixels into registers, and apply dithering
+      PIXCONV_LOAD_PIXEL16_DITHER_AVX2(ymm0, ymm4, (y+i+ 0), bpp);  /* Y0Y0Y0Y0 */
+      PIXCONV_LOAD_PIXEL16_DITHER_AVX2(ymm1, ymm5, (y+i+16), bpp);  /* Y0Y0Y0Y0 */
+      PIXCONV_PACKUS_EPI16_AVX2(ymm0, ymm1);                        /* YYYYYYYY */
+
+      // Write data back
+      PIXCONV_PUT_STREAM_AVX2(dst128Y, endY, ymm0);
+    }
+
+    y += inYStride;
+  }
+
+  // Process U/V
+  // Chroma line n uses the same dithering coefficients as luma line n
+  for (line = chromaSliceStart; line < chromaSliceEnd; ++line) {
+    if (ditherMode == LAVDither_Random) {
+      ymm4 = _mm256_loadu_si256((const __m256i *)(dithers + (line << 5) + 0));
+      ymm5 = _mm256_loadu_si256((const __m256i *)(dithers + (line << 5) + 16));
+    } else {
+      PIXCONV_LOAD_DITHER_COEFFS_AVX2(ymm5,line,8,dithers);
+      ymm4 = ymm5;
+    }
+
+    __m128i *dst128UV = (__m128i *)(dstV + line * outLumaStride);
+    __m128i *dst128U = (__m128i *)(dstU + line * outChromaStride);
+    __m128i *dst128V = (__m128i *)(dstV + line * outChromaStride);
+    const uint8_t *endUV = (const uint8_t *)dst128UV + (chromaWidth << 1);
+    const uint8_t *endU = (const uint8_t *)dst128U + chromaWidth;
+    const uint8_t *endV = (const uint8_t *)dst128V + chromaWidth;
+
+    for (i = 0; i < chromaWidth; i+=16) {
+      PIXCONV_LOAD_PIXEL16_DITHER_AVX2(ymm0, ymm4, (u+i), bpp);  /* U0U0U0U0 */
+      PIXCONV_LOAD_PIXEL16_DITHER_AVX2(ymm1, ymm5, (v+i), bpp);  /* V0V0V0V0 */
+      PIXCONV_PACKUS_EPI16_AVX2(ymm0, ymm1);                     /* UUUUVVVV */
+
+      xmm0 = _mm256_castsi256_si128(ymm0);                       /* UUUUUUUU */
+      xmm2 = _mm256_extracti128_si256(ymm0, 1);                  /* VVVVVVVV */
+      if (nv12) {
+        xmm1 = xmm0;
+        xmm0 = _mm_unpacklo_epi8(xmm0, xmm2);
+        xmm1 = _mm_unpackhi_epi8(xmm1, xmm2);
+
+        PIXCONV_PUT_STREAM(dst128UV, endUV, xmm0);
+        PIXCONV_PUT_STREAM(dst128UV, endUV, xmm1);
+      } else {
+        PIXCONV_PUT_STREAM(dst128U, endU, xmm0);
+        PIXCONV_PUT_STREAM(dst128V, endV, xmm2);
+      }
+    }
+
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  _mm256_zeroupper();
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv_yv_nv12_dither_le_avx2<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv_yv_nv12_dither_le_avx2<1>CONV_FUNC_PARAMS;
+
+DECLARE_CONV_FUNC_IMPL(convert_yuv420_px1x_le_avx2)
+{
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inYStride = srcStride[0] >> 1;
+  const ptrdiff_t inUVStride = srcStride[1] >> 1;
+  const ptrdiff_t outStride = dstStride << 1;
+  const ptrdiff_t uvHeight = (outputFormat == LAVOutPixFmt_P010 || outputFormat == LAVOutPixFmt_P016) ? (height >> 1) : height;
+  const ptrdiff_t uvWidth = (width + 1) >> 1;
+  const ptrdiff_t uvSliceStart = (uvHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t uvSliceEnd   = (uvHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
+
+  ptrdiff_t line, i;
+  __m256i ymm0,ymm1,ymm2;
+  __m128i xmm0,xmm1,xmm2;
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * uvSliceStart;
+  v += inUVStride * uvSliceStart;
+
+  _mm_sfence();
+
+  // Process Y
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128Y = (__m128i *)(dst + line * outStride);
+    const uint8_t *endY = (const uint8_t *)dst128Y + (width << 1);
+
+    for (i = 0; i < width; i+=16) {
+      // Load 16 pixels into register
+      PIXCONV_LOAD_PIXEL16_AVX2(ymm0, (y+i), bpp); /* YYYY */
+      // and write them out
+      PIXCONV_PUT_STREAM_AVX2(dst128Y, endY, ymm0);
+    }
+
+    y += inYStride;
+  }
+
+  BYTE *dstUV = dst + (height * outStride);
+
+  // Process UV
+  for (line = uvSliceStart; line < uvSliceEnd; ++line) {
+    __m128i *dst128UV = (__m128i *)(dstUV + line * outStride);
+    const uint8_t *endUV = (const uint8_t *)dst128UV + (uvWidth << 2);
+
+    // 16 pixels at a time, as long as they fit into the line
+    for (i = 0; (i + 16) <= uvWidth; i+=16) {
+      PIXCONV_LOAD_PIXEL16_AVX2(ymm0, (v+i), bpp); /* VVVV */
+      PIXCONV_LOAD_PIXEL16_AVX2(ymm1, (u+i), bpp); /* UUUU */
+
+      ymm2 = _mm256_unpacklo_epi16(ymm1, ymm0);    /* UVUV (0-3, 8-11) */
+      ymm0 = _mm256_unpackhi_epi16(ymm1, ymm0);    /* UVUV (4-7, 12-15) */
+
+      PIXCONV_PUT_STREAM(dst128UV, endUV, _mm256_castsi256_si128(ymm2));
+      PIXCONV_PUT_STREAM(dst128UV, endUV, _mm256_castsi256_si128(ymm0));
+      PIXCONV_PUT_STREAM(dst128UV, endUV, _mm256_extracti128_si256(ymm2, 1));
+      PIXCONV_PUT_STREAM(dst128UV, endUV, _mm256_extracti128_si256(ymm0, 1));
+    }
+
+    // Remaining pixels, 8 at a time like the SSE2 version
+    for (; i < uvWidth; i+=8) {
+      PIXCONV_LOAD_PIXEL16(xmm0, (v+i), bpp); /* VVVV */
+      PIXCONV_LOAD_PIXEL16(xmm1, (u+i), bpp); /* UUUU */
+
+      xmm2 = xmm0;
+      xmm0 = _mm_unpacklo_epi16(xmm1, xmm0);    /* UVUV */
+      xmm2 = _mm_unpackhi_epi16(xmm1, xmm2);    /* UVUV */
+
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm0);
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm2);
+    }
+
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  _mm256_zeroupper();
+
+  return S_OK;
+}
@@ -0,0 +1,441 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <emmintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+
+// Conversion of 8-bit input into the high bit-depth output formats
+// The samples are scaled by a plain shift, like the high bit-depth converters do for input with less bits than the output.
+// The formats with 16-bit samples (P010, P016, P210, P216, Y416) are MSB-aligned, so the 10-bit and 16-bit variants
+// of a format are identical for 8-bit input.
+// Conversions which change the chroma subsampling resample the chroma of a line into a temporary line first,
+// and then run the converter for the matching subsampling on it (see convert_yuv_hbd_resample).
+
+template <int nv12>
+DECLARE_CONV_FUNC_IMPL(convert_yuv_px1x)
+{
+  const uint8_t *y = src[0];
+  const uint8_t *u = src[1];
+  const uint8_t *v = src[2];
+
+  const ptrdiff_t inYStride = srcStride[0];
+  const ptrdiff_t inUVStride = srcStride[1];
+  const ptrdiff_t outStride = dstStride << 1;
+  const ptrdiff_t uvHeight = (outputFormat == LAVOutPixFmt_P010 || outputFormat == LAVOutPixFmt_P016) ? (height >> 1) : height;
+  const ptrdiff_t uvWidth = (width + 1) >> 1;
+  const ptrdiff_t uvSliceStart = (uvHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t uvSliceEnd   = (uvHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
+
+  ptrdiff_t line, i;
+  __m128i xmm0,xmm1,xmm2,xmm7;
+
+  xmm7 = _mm_setzero_si128();
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * uvSliceStart;
+  v += inUVStride * uvSliceStart;
+
+  _mm_sfence();
+
+  // Process Y
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128Y = (__m128i *)(dst + line * outStride);
+    const uint8_t *endY = (const uint8_t *)dst128Y + (width << 1);
+
+    for (i = 0; i < width; i+=16) {
+      // Load 16 pixels into register
+      PIXCONV_LOAD_PIXEL8(xmm0, (y+i));         /* YYYY */
+      // Move them into the high byte of the 16-bit samples
+      xmm1 = _mm_unpacklo_epi8(xmm7, xmm0);     /* Y0Y0 */
+      xmm2 = _mm_unpackhi_epi8(xmm7, xmm0);     /* Y0Y0 */
+      // and write them out
+      PIXCONV_PUT_STREAM(dst128Y, endY, xmm1);
+      PIXCONV_PUT_STREAM(dst128Y, endY, xmm2);
+    }
+
+    y += inYStride;
+  }
+
+  BYTE *dstUV = dst + (height * outStride);
+
+  // Process UV
+  for (line = uvSliceStart; line < uvSliceEnd; ++line) {
+    __m128i *dst128UV = (__m128i *)(dstUV + line * outStride);
+    const uint8_t *endUV = (const uint8_t *)dst128UV + (uvWidth << 2);
+
+    for (i = 0; i < uvWidth; i+=8) {
+      // Load 8 pixels of each chroma plane into register
+      if (nv12) {
+        PIXCONV_LOAD_PIXEL8(xmm0, (u+i*2));     /* UVUV */
+      } else {
+        xmm0 = _mm_loadl_epi64((const __m128i *)(u+i)); /* UUUU */
+        xmm1 = _mm_loadl_epi64((const __m128i *)(v+i)); /* VVVV */
+        xmm0 = _mm_unpacklo_epi8(xmm0, xmm1);   /* UVUV */
+      }
+
+      xmm1 = _mm_unpacklo_epi8(xmm7, xmm0);     /* U0V0 */
+      xmm2 = _mm_unpackhi_epi8(xmm7, xmm0);     /* U0V0 */
+
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm1);
+      PIXCONV_PUT_STREAM(dst128UV, endUV, xmm2);
+    }
+
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv_px1x<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv_px1x<1>CONV_FUNC_PARAMS;
+
+// Y410 and v410 only differ in the position of the components, and the alpha bits of Y410
+// Y410: A << 30 | V << 20 | Y << 10 | U
+// v410: V << 22 | Y << 12 | U << 2
+template <int v410>
+DECLARE_CONV_FUNC_IMPL(convert_yuv444_x410)
+{
+  const uint8_t *y = src[0];
+  const uint8_t *u = src[1];
+  const uint8_t *v = src[2];
+
+  const ptrdiff_t inYStride = srcStride[0];
+  const ptrdiff_t inUVStride = srcStride[1];
+  const ptrdiff_t outStride = dstStride << 2;
+  // 8-bit to 10-bit is another shift by 2
+  const int shiftU = (v410 ?  2 :  0) + 2;
+  const int shiftY = (v410 ? 12 : 10) + 2;
+  const int shiftV = (v410 ? 22 : 20) + 2;
+
+  ptrdiff_t line, i;
+
+  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm6,xmm7;
+
+  xmm6 = v410 ? _mm_setzero_si128() : _mm_set1_epi32(0xC0000000);
+  xmm7 = _mm_setzero_si128();
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * sliceYStart;
+  v += inUVStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 2);
+
+    for (i = 0; i < width; i+=8) {
+      // Load 8 pixels, extended to 16-bit
+      xmm0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y+i)), xmm7); /* Y0Y0 */
+      xmm1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u+i)), xmm7); /* U0U0 */
+      xmm2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v+i)), xmm7); /* V0V0 */
+
+      xmm3 = _mm_or_si128(xmm6, _mm_slli_epi32(_mm_unpacklo_epi16(xmm1, xmm7), shiftU));
+      xmm3 = _mm_or_si128(xmm3, _mm_slli_epi32(_mm_unpacklo_epi16(xmm0, xmm7), shiftY));
+      xmm3 = _mm_or_si128(xmm3, _mm_slli_epi32(_mm_unpacklo_epi16(xmm2, xmm7), shiftV));
+
+      xmm4 = _mm_or_si128(xmm6, _mm_slli_epi32(_mm_unpackhi_epi16(xmm1, xmm7), shiftU));
+      xmm4 = _mm_or_si128(xmm4, _mm_slli_epi32(_mm_unpackhi_epi16(xmm0, xmm7), shiftY));
+      xmm4 = _mm_or_si128(xmm4, _mm_slli_epi32(_mm_unpackhi_epi16(xmm2, xmm7), shiftV));
+
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm4);
+    }
+
+    y += inYStride;
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv444_x410<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv444_x410<1>CONV_FUNC_PARAMS;
+
+DECLARE_CONV_FUNC_IMPL(convert_yuv444_y416)
+{
+  const uint8_t *y = src[0];
+  const uint8_t *u = src[1];
+  const uint8_t *v = src[2];
+
+  const ptrdiff_t inYStride = srcStride[0];
+  const ptrdiff_t inUVStride = srcStride[1];
+  const ptrdiff_t outStride = dstStride << 3;
+
+  ptrdiff_t line, i;
+
+  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm6,xmm7;
+
+  xmm6 = _mm_set1_epi16(-1);
+  xmm7 = _mm_setzero_si128();
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * sliceYStart;
+  v += inUVStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 3);
+
+    for (i = 0; i < width; i+=8) {
+      // Load 8 pixels, into the high byte of 16-bit samples
+      xmm0 = _mm_unpacklo_epi8(xmm7, _mm_loadl_epi64((const __m128i *)(y+i))); /* 0Y0Y */
+      xmm1 = _mm_unpacklo_epi8(xmm7, _mm_loadl_epi64((const __m128i *)(u+i))); /* 0U0U */
+      xmm2 = _mm_unpacklo_epi8(xmm7, _mm_loadl_epi64((const __m128i *)(v+i))); /* 0V0V */
+
+      // Interleave into A V Y U
+      xmm3 = _mm_unpacklo_epi16(xmm6, xmm2);    /* AVAV */
+      xmm4 = _mm_unpacklo_epi16(xmm0, xmm1);    /* YUYU */
+      PIXCONV_PUT_STREAM(dst128, end, _mm_unpacklo_epi32(xmm3, xmm4));
+      PIXCONV_PUT_STREAM(dst128, end, _mm_unpackhi_epi32(xmm3, xmm4));
+
+      xmm3 = _mm_unpackhi_epi16(xmm6, xmm2);    /* AVAV */
+      xmm4 = _mm_unpackhi_epi16(xmm0, xmm1);    /* YUYU */
+      PIXCONV_PUT_STREAM(dst128, end, _mm_unpacklo_epi32(xmm3, xmm4));
+      PIXCONV_PUT_STREAM(dst128, end, _mm_unpackhi_epi32(xmm3, xmm4));
+    }
+
+    y += inYStride;
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  return S_OK;
+}
+
+// Vertical interpolation of a 4:2:0 chroma line, weighted 3:1 between the closest and the second closest line
+static void resample_chroma_v_interp(uint8_t *dst, const uint8_t *nearSrc, const uint8_t *farSrc, ptrdiff_t bytes)
+{
+  const __m128i xmm7 = _mm_setzero_si128();
+  const __m128i xmm6 = _mm_set1_epi16(2);
+  __m128i xmm0,xmm1,xmm2,xmm3;
+
+  for (ptrdiff_t i = 0; i < bytes; i+=16) {
+    PIXCONV_LOAD_PIXEL8(xmm0, (nearSrc+i));
+    PIXCONV_LOAD_PIXEL8(xmm1, (farSrc+i));
+
+    // (3 * near + far + 2) >> 2
+    xmm2 = _mm_unpacklo_epi8(xmm0, xmm7);
+    xmm3 = _mm_add_epi16(_mm_add_epi16(xmm2, _mm_slli_epi16(xmm2, 1)), _mm_unpacklo_epi8(xmm1, xmm7));
+    xmm2 = _mm_srli_epi16(_mm_add_epi16(xmm3, xmm6), 2);
+
+    xmm0 = _mm_unpackhi_epi8(xmm0, xmm7);
+    xmm3 = _mm_add_epi16(_mm_add_epi16(xmm0, _mm_slli_epi16(xmm0, 1)), _mm_unpackhi_epi8(xmm1, xmm7));
+    xmm0 = _mm_srli_epi16(_mm_add_epi16(xmm3, xmm6), 2);
+
+    _mm_store_si128((__m128i *)(dst+i), _mm_packus_epi16(xmm2, xmm0));
+  }
+}
+
+// Vertical average of the chroma of a line pair
+static void resample_chroma_v_avg(uint8_t *dst, const uint8_t *src0, const uint8_t *src1, ptrdiff_t bytes)
+{
+  __m128i xmm0,xmm1;
+
+  for (ptrdiff_t i = 0; i < bytes; i+=16) {
+    PIXCONV_LOAD_PIXEL8(xmm0, (src0+i));
+    PIXCONV_LOAD_PIXEL8(xmm1, (src1+i));
+    _mm_store_si128((__m128i *)(dst+i), _mm_avg_epu8(xmm0, xmm1));
+  }
+}
+
+// Split an interleaved NV12 chroma line into its planes
+static void resample_chroma_deinterleave(uint8_t *dstU, uint8_t *dstV, const uint8_t *src, ptrdiff_t samples)
+{
+  const __m128i xmm7 = _mm_setzero_si128();
+  const __m128i xmm6 = _mm_set1_epi16(0x00FF);
+  __m128i xmm0;
+
+  for (ptrdiff_t i = 0; i < samples; i+=8) {
+    xmm0 = _mm_load_si128((const __m128i *)(src+i*2));     /* UVUV */
+    _mm_storel_epi64((__m128i *)(dstU+i), _mm_packus_epi16(_mm_and_si128(xmm0, xmm6), xmm7));
+    _mm_storel_epi64((__m128i *)(dstV+i), _mm_packus_epi16(_mm_srli_epi16(xmm0, 8), xmm7));
+  }
+}
+
+// Horizontal upsampling of a 4:2:2 chroma line to 4:4:4
+// The co-sited samples are kept, the samples in between are the average of their neighbours.
+// src[samples] has to repeat the last sample.
+static void resample_chroma_h_up(uint8_t *dst, const uint8_t *src, ptrdiff_t samples)
+{
+  __m128i xmm0,xmm1;
+
+  for (ptrdiff_t i = 0; i < samples; i+=16) {
+    xmm0 = _mm_load_si128((const __m128i *)(src+i));
+    xmm1 = _mm_avg_epu8(xmm0, _mm_loadu_si128((const __m128i *)(src+i+1)));
+    _mm_store_si128((__m128i *)(dst+i*2), _mm_unpacklo_epi8(xmm0, xmm1));
+    _mm_store_si128((__m128i *)(dst+i*2+16), _mm_unpackhi_epi8(xmm0, xmm1));
+  }
+}
+
+// Horizontal downsampling of a 4:4:4 chroma line to 4:2:2, with a [1 2 1] filter centered on the co-sited samples
+// src[-1] has to repeat the first sample, and src[width] the last sample.
+static void resample_chroma_h_down(uint8_t *dst, const uint8_t *src, ptrdiff_t samples)
+{
+  const __m128i xmm7 = _mm_setzero_si128();
+  const __m128i xmm6 = _mm_set1_epi16(0x00FF);
+  const __m128i xmm5 = _mm_set1_epi16(2);
+  __m128i xmm0,xmm1,xmm2;
+
+  for (ptrdiff_t i = 0; i < samples; i+=8) {
+    xmm0 = _mm_load_si128((const __m128i *)(src+i*2));
+    xmm1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src+i*2-1)), xmm6); /* left neighbours */
+    xmm2 = _mm_srli_epi16(xmm0, 8);                                             /* right neighbours */
+    xmm0 = _mm_slli_epi16(_mm_and_si128(xmm0, xmm6), 1);                        /* co-sited samples, doubled */
+
+    xmm0 = _mm_add_epi16(_mm_add_epi16(xmm0, xmm1), _mm_add_epi16(xmm2, xmm5));
+    xmm0 = _mm_srli_epi16(xmm0, 2);
+    _mm_storel_epi64((__m128i *)(dst+i), _mm_packus_epi16(xmm0, xmm7));
+  }
+}
+
+// 8-bit YUV into the high bit-depth formats with a different chroma subsampling
+// The chroma of every output line (or line pair, for 4:2:0 output) is resampled into temporary lines, which are
+// then passed to the converter for the output subsampling with a chroma stride of zero.
+DECLARE_CONV_FUNC_IMPL(convert_yuv_hbd_resample)
+{
+  const int nv12 = (inputFormat == LAVPixFmt_NV12);
+  const int inShiftH = (inputFormat == LAVPixFmt_YUV444) ? 0 : 1;
+  const int inShiftV = (inputFormat == LAVPixFmt_YUV420 || nv12) ? 1 : 0;
+
+  int outShiftH, outShiftV;
+  LAVPixelFormat kernelFormat;
+  ConverterFn kernel;
+  switch (outputFormat) {
+  case LAVOutPixFmt_P010:
+  case LAVOutPixFmt_P016:
+    outShiftH = 1; outShiftV = 1; kernelFormat = LAVPixFmt_YUV420;
+    kernel = &CLAVPixFmtConverter::convert_yuv_px1x<0>;
+    break;
+  case LAVOutPixFmt_P210:
+  case LAVOutPixFmt_P216:
+    outShiftH = 1; outShiftV = 0; kernelFormat = LAVPixFmt_YUV422;
+    kernel = &CLAVPixFmtConverter::convert_yuv_px1x<0>;
+    break;
+  case LAVOutPixFmt_v210:
+    outShiftH = 1; outShiftV = 0; kernelFormat = LAVPixFmt_YUV422;
+    kernel = &CLAVPixFmtConverter::convert_yuv422_v210_ssse3<0>;
+    break;
+  case LAVOutPixFmt_Y410:
+    outShiftH = 0; outShiftV = 0; kernelFormat = LAVPixFmt_YUV444;
+    kernel = &CLAVPixFmtConverter::convert_yuv444_x410<0>;
+    break;
+  case LAVOutPixFmt_v410:
+    outShiftH = 0; outShiftV = 0; kernelFormat = LAVPixFmt_YUV444;
+    kernel = &CLAVPixFmtConverter::convert_yuv444_x410<1>;
+    break;
+  case LAVOutPixFmt_Y416:
+    outShiftH = 0; outShiftV = 0; kernelFormat = LAVPixFmt_YUV444;
+    kernel = &CLAVPixFmtConverter::convert_yuv444_y416;
+    break;
+  default:
+    ASSERT(0);
+    return E_FAIL;
+  }
+
+  const ptrdiff_t inUVStride = srcStride[1];
+  const ptrdiff_t inChromaWidth = (width + inShiftH) >> inShiftH;
+  const ptrdiff_t outChromaWidth = (width + outShiftH) >> outShiftH;
+  const ptrdiff_t inChromaBytes = nv12 ? (inChromaWidth << 1) : inChromaWidth;
+  const ptrdiff_t lastChromaLine = max((ptrdiff_t)(height >> inShiftV) - 1, (ptrdiff_t)0);
+  const ptrdiff_t lineStep = (ptrdiff_t)1 << outShiftV;
+
+  // Five temporary lines (interleaved NV12 chroma, the planes after the vertical and after the horizontal step),
+  // each with room for the repeated edge samples and the overread of the 16-byte blocks
+  const ptrdiff_t bufStride = FFALIGN(width + 1, 32) + 64;
+  const size_t bufSize = bufStride * 5;
+  uint8_t *buffer = AcquireScratchBuffer(bufSize);
+  if (!buffer)
+    return E_OUTOFMEMORY;
+
+  uint8_t *tmpUV = buffer + 16;
+  uint8_t *tmpU  = tmpUV + bufStride;
+  uint8_t *tmpV  = tmpU  + bufStride;
+  uint8_t *outU  = tmpV  + bufStride;
+  uint8_t *outV  = outU  + bufStride;
+
+  const int kernelStride[4] = { srcStride[0], 0, 0, 0 };
+  HRESULT hr = S_OK;
+
+  for (ptrdiff_t line = sliceYStart; line < sliceYEnd && SUCCEEDED(hr); line += lineStep) {
+    // The two input chroma lines which make up the chroma of this line
+    ptrdiff_t line0, line1;
+    if (inShiftV > outShiftV) {
+      line0 = min(line >> 1, lastChromaLine);
+      line1 = (line & 1) ? min(line0 + 1, lastChromaLine) : max(line0 - 1, (ptrdiff_t)0);
+    } else if (inShiftV < outShiftV) {
+      line0 = line;
+      line1 = min(line + 1, (ptrdiff_t)height - 1);
+    } else {
+      line0 = line1 = line;
+    }
+
+    uint8_t *u = nv12 ? tmpUV : tmpU;
+    if (line0 == line1) {
+      memcpy(u, src[1] + line0 * inUVStride, inChromaBytes);
+      if (!nv12)
+        memcpy(tmpV, src[2] + line0 * inUVStride, inChromaBytes);
+    } else if (inShiftV > outShiftV) {
+      resample_chroma_v_interp(u, src[1] + line0 * inUVStride, src[1] + line1 * inUVStride, inChromaBytes);
+      if (!nv12)
+        resample_chroma_v_interp(tmpV, src[2] + line0 * inUVStride, src[2] + line1 * inUVStride, inChromaBytes);
+    } else {
+      resample_chroma_v_avg(u, src[1] + line0 * inUVStride, src[1] + line1 * inUVStride, inChromaBytes);
+      if (!nv12)
+        resample_chroma_v_avg(tmpV, src[2] + line0 * inUVStride, src[2] + line1 * inUVStride, inChromaBytes);
+    }
+    if (nv12)
+      resample_chroma_deinterleave(tmpU, tmpV, tmpUV, inChromaWidth);
+
+    const uint8_t *kernelU = tmpU, *kernelV = tmpV;
+    if (inShiftH != outShiftH) {
+      // Repeat the edge samples for the horizontal filters
+      tmpU[-1] = tmpU[0];
+      tmpV[-1] = tmpV[0];
+      tmpU[inChromaWidth] = tmpU[inChromaWidth - 1];
+      tmpV[inChromaWidth] = tmpV[inChromaWidth - 1];
+      if (inShiftH > outShiftH) {
+        resample_chroma_h_up(outU, tmpU, inChromaWidth);
+        resample_chroma_h_up(outV, tmpV, inChromaWidth);
+      } else {
+        resample_chroma_h_down(outU, tmpU, outChromaWidth);
+        resample_chroma_h_down(outV, tmpV, outChromaWidth);
+      }
+      kernelU = outU;
+      kernelV = outV;
+    }
+
+    const uint8_t* const kernelSrc[4] = { src[0], kernelU, kernelV, NULL };
+    hr = (this->*kernel)(kernelSrc, kernelStride, dst, dstStride, width, height, (int)line, (int)min(line + lineStep, (ptrdiff_t)sliceYEnd), kernelFormat, 8, outputFormat);
+  }
+
+  ReleaseScratchBuffer(buffer, bufSize);
+
+  return hr;
+}
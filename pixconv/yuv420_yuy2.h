@@ -0,0 +1,319 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <emmintrin.h>
+
+// Templates of the 4:2:0 to YUY2/UYVY conversion, shared by the SSE2 converters in yuv420_yuy2.cpp and the AVX2 converters in yuv420_yuy2_avx2.cpp
+// Everything in here is either static or templated on avx2, so code compiled for AVX2 never ends up in the SSE2 converters
+
+#define DITHER_STEPS 2
+
+// Width of the vertical strips in bytes of luma, a multiple of the 8 pixels processed at once
+// A line pair of a strip touches about 8 times this in source and destination memory, which fits into the L1 cache
+#define YUY2_STRIP_WIDTH 2048
+
+// This function converts 8x2 pixels from the source into 8x2 YUY2 pixels in the destination
+// dstEnd is the end of the first destination line, nothing at or beyond it will be written
+template <LAVPixelFormat inputFormat, int shift, int uyvy, int dithertype> __forceinline
+static int yuv420yuy2_convert_pixels(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, const uint16_t* &dithers, ptrdiff_t pos, BOOL bStream)
+{
+  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
+  xmm7 = _mm_setzero_si128 ();
+
+  // Shift > 0 is for 9/10 bit formats
+  if (shift > 0) {
+    // Load 4 U/V values from line 0/1 into registers
+    PIXCONV_LOAD_4PIXEL16(xmm1, srcU);
+    PIXCONV_LOAD_4PIXEL16(xmm3, srcU+srcStrideUV);
+    PIXCONV_LOAD_4PIXEL16(xmm0, srcV);
+    PIXCONV_LOAD_4PIXEL16(xmm2, srcV+srcStrideUV);
+
+    // Interleave U and V
+    xmm0 = _mm_unpacklo_epi16(xmm1, xmm0);                       /* 0V0U0V0U */
+    xmm2 = _mm_unpacklo_epi16(xmm3, xmm2);                       /* 0V0U0V0U */
+  } else if (inputFormat == LAVPixFmt_NV12) {
+    // Load 4 16-bit macro pixels, which contain 4 UV samples
+    PIXCONV_LOAD_4PIXEL16(xmm0, srcU);
+    PIXCONV_LOAD_4PIXEL16(xmm2, srcU+srcStrideUV);
+
+    // Expand to 16-bit
+    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* 0V0U0V0U */
+    xmm2 = _mm_unpacklo_epi8(xmm2, xmm7);                       /* 0V0U0V0U */
+  } else {
+    PIXCONV_LOAD_4PIXEL8(xmm1, srcU);
+    PIXCONV_LOAD_4PIXEL8(xmm3, srcU+srcStrideUV);
+    PIXCONV_LOAD_4PIXEL8(xmm0, srcV);
+    PIXCONV_LOAD_4PIXEL8(xmm2, srcV+srcStrideUV);
+
+    // Interleave U and V
+    xmm0 = _mm_unpacklo_epi8(xmm1, xmm0);                       /* VUVU0000 */
+    xmm2 = _mm_unpacklo_epi8(xmm3, xmm2);                       /* VUVU0000 */
+
+    // Expand to 16-bit
+    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                       /* 0V0U0V0U */
+    xmm2 = _mm_unpacklo_epi8(xmm2, xmm7);                       /* 0V0U0V0U */
+  }
+
+  // xmm0/xmm2 contain 4 interleaved U/V samples from two lines each in the 16bit parts, still in their native bitdepth
+
+  // Chroma upsampling
+  if (shift > 0 || inputFormat == LAVPixFmt_NV12) {
+    srcU += 8;
+    srcV += 8;
+  } else {
+    srcU += 4;
+    srcV += 4;
+  }
+
+  xmm1 = xmm0;
+  xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 2x line 0 */
+  xmm1 = _mm_add_epi16(xmm1, xmm0);                         /* 3x line 0 */
+  xmm1 = _mm_add_epi16(xmm1, xmm2);                         /* 3x line 0 + line 1 (10bit) */
+
+  xmm3 = xmm2;
+  xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 2x line 1 */
+  xmm3 = _mm_add_epi16(xmm3, xmm2);                         /* 3x line 1 */
+  xmm3 = _mm_add_epi16(xmm3, xmm0);                         /* 3x line 1 + line 0 (10bit) */
+  
+  // After this step, xmm1 and xmm3 contain 8 16-bit values, V and U interleaved. For 4:2:0, filling input+2 bits (10, 11, 12).
+  // Load Y
+  if (shift > 0) {
+    // Load 8 Y values from line 0/1 into registers
+    PIXCONV_LOAD_PIXEL8_ALIGNED(xmm0, srcY);
+    PIXCONV_LOAD_PIXEL8_ALIGNED(xmm5, srcY+srcStrideY);
+
+    srcY += 16;
+  } else {
+    PIXCONV_LOAD_4PIXEL16(xmm0, srcY);
+    PIXCONV_LOAD_4PIXEL16(xmm5, srcY+srcStrideY);
+    srcY += 8;
+
+    xmm0 = _mm_unpacklo_epi8(xmm0, xmm7);                     /* YYYYYYYY (16-bit fields)*/
+    xmm5 = _mm_unpacklo_epi8(xmm5, xmm7);                     /* YYYYYYYY (16-bit fields) */
+  }
+
+  // Dither everything to 8-bit
+
+  // Dithering
+  if (dithertype == LAVDither_Random) {
+    /* Load random dithering coeffs from the dithers buffer */
+    int offset = (pos % (DITHER_STEPS * 8 * 2)) * 2;
+    xmm6 = _mm_load_si128((const __m128i *)(dithers +  0 + offset));
+    xmm7 = _mm_load_si128((const __m128i *)(dithers +  8 + offset));
+  } else {
+    PIXCONV_LOAD_DITHER_COEFFS(xmm6, line+0, shift+2, odithers);
+    PIXCONV_LOAD_DITHER_COEFFS(xmm7, line+1, shift+2, odithers2);
+  }
+
+  // Dither UV
+  xmm1 = _mm_adds_epu16(xmm1, xmm6);
+  xmm3 = _mm_adds_epu16(xmm3, xmm7);
+  xmm1 = _mm_srai_epi16(xmm1, shift+2);
+  xmm3 = _mm_srai_epi16(xmm3, shift+2);
+
+  if (shift) {                                                /* Y only needs to be dithered if it was > 8 bit */
+    xmm6 = _mm_srli_epi16(xmm6, 2);                           /* Shift dithering coeffs to proper strength */
+    xmm7 = _mm_srli_epi16(xmm6, 2);
+
+    xmm0 = _mm_adds_epu16(xmm0, xmm6);                        /* Apply dithering coeffs */
+    xmm0 = _mm_srai_epi16(xmm0, shift);                       /* Shift to 8 bit */
+
+    xmm5 = _mm_adds_epu16(xmm5, xmm7);                        /* Apply dithering coeffs */
+    xmm5 = _mm_srai_epi16(xmm5, shift);                       /* Shift to 8 bit */
+  }
+
+  // Pack into 8-bit containers
+  xmm0 = _mm_packus_epi16(xmm0, xmm5);
+  xmm1 = _mm_packus_epi16(xmm1, xmm3);
+
+  // Interleave U/V with Y
+  if (uyvy) {
+    xmm3 = xmm1;
+    xmm3 = _mm_unpacklo_epi8(xmm3, xmm0);
+    xmm4 = _mm_unpackhi_epi8(xmm1, xmm0);
+  } else {
+    xmm3 = xmm0;
+    xmm3 = _mm_unpacklo_epi8(xmm3, xmm1);
+    xmm4 = _mm_unpackhi_epi8(xmm0, xmm1);
+  }
+
+  // Write back into the target memory
+  pixconv_put_stream((__m128i *)(dst), dstEnd, xmm3, bStream);
+  pixconv_put_stream((__m128i *)(dst + dstStride), dstEnd + dstStride, xmm4, bStream);
+
+  dst += 16;
+
+  return 0;
+}
+
+// Convert the blocks of a line two at a time, starting at position i, and return the position of the first block left to convert
+// Only the AVX2 converters do this, their specialization for avx2 = 1 is in yuv420_yuy2_avx2.cpp
+template <LAVPixelFormat inputFormat, int shift, int uyvy, int dithertype, int avx2>
+struct yuv420yuy2_convert_blocks_x2 {
+  static __forceinline ptrdiff_t convert(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, const uint16_t* &dithers, ptrdiff_t i, ptrdiff_t endx, BOOL bStream)
+  {
+    return i;
+  }
+};
+
+// avx2 - convert the blocks two at a time with yuv420yuy2_convert_blocks_x2
+template <LAVPixelFormat inputFormat, int shift, int uyvy, int dithertype, int avx2>
+static int __stdcall yuv420yuy2_process_lines(const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, uint8_t *dst, int width, int height, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, const uint16_t *dithers, BOOL bStream)
+{
+  const uint8_t *y = srcY;
+  const uint8_t *u = srcU;
+  const uint8_t *v = srcV;
+  uint8_t *yuy2 = dst;
+
+  dstStride *= 2;
+  // Bytes of an output line, the last pixel of an odd width still has a full macropixel
+  const ptrdiff_t lineBytes = ((width + 1) >> 1) << 2;
+
+  // Bytes per pixel of the luma plane, and per two pixels of the chroma plane(s)
+  const ptrdiff_t lumaBytes   = (shift > 0) ? 2 : 1;
+  const ptrdiff_t chromaBytes = (shift > 0 || inputFormat == LAVPixFmt_NV12) ? 2 : 1;
+
+  // Every chroma line is used by two line pairs. Wide images are processed in vertical strips, which keeps the chroma
+  // line in the L1 cache until the next line pair needs it, instead of loading it from memory again.
+  const ptrdiff_t stripWidth = YUY2_STRIP_WIDTH / lumaBytes;
+
+  for (ptrdiff_t stripX = 0; stripX < width; stripX += stripWidth) {
+    const ptrdiff_t stripEnd = min(stripX + stripWidth, (ptrdiff_t)width);
+
+    const uint8_t *stripY = srcY + stripX * lumaBytes;
+    const uint8_t *stripU = srcU + (stripX >> 1) * chromaBytes;
+    const uint8_t *stripV = srcV + (stripX >> 1) * chromaBytes;
+    uint8_t *stripDst = dst + stripX * 2;
+
+    // Lines are processed in pairs starting at line 1, the first and last line have special handling
+    // Slices other then the first start on an odd line, and slices other then the last end one line into the next slice
+    ptrdiff_t line = sliceYStart;
+    ptrdiff_t lastLine = sliceYEnd;
+
+    const uint16_t *lineDither = dithers;
+
+    _mm_sfence();
+
+    // Process first line
+    // This needs special handling because of the chroma offset of YUV420
+    if (line == 0) {
+      y = stripY;
+      u = stripU;
+      v = stripV;
+      yuy2 = stripDst;
+      const uint8_t *end = dst + lineBytes;
+      ptrdiff_t i = yuv420yuy2_convert_blocks_x2<inputFormat, shift, uyvy, dithertype, avx2>::convert(y, u, v, yuy2, end, 0, 0, 0, 0, lineDither, stripX, stripEnd, bStream);
+      for (; i < stripEnd; i += 8) {
+        yuv420yuy2_convert_pixels<inputFormat, shift, uyvy, dithertype>(y, u, v, yuy2, end, 0, 0, 0, 0, lineDither, i, bStream);
+      }
+      line = 1;
+    }
+    if (lastLine == height)
+      lastLine--;
+
+    for (; line < lastLine; line += 2) {
+      if (dithertype == LAVDither_Random)
+        lineDither = dithers + (line * 16 * DITHER_STEPS);
+
+      y = stripY + line * srcStrideY;
+
+      u = stripU + (line >> 1) * srcStrideUV;
+      v = stripV + (line >> 1) * srcStrideUV;
+
+      yuy2 = stripDst + line * dstStride;
+      const uint8_t *end = dst + line * dstStride + lineBytes;
+
+      ptrdiff_t i = yuv420yuy2_convert_blocks_x2<inputFormat, shift, uyvy, dithertype, avx2>::convert(y, u, v, yuy2, end, srcStrideY, srcStrideUV, dstStride, line, lineDither, stripX, stripEnd, bStream);
+      for (; i < stripEnd; i += 8) {
+        yuv420yuy2_convert_pixels<inputFormat, shift, uyvy, dithertype>(y, u, v, yuy2, end, srcStrideY, srcStrideUV, dstStride, line, lineDither, i, bStream);
+      }
+    }
+
+    // Process last line
+    // This needs special handling because of the chroma offset of YUV420
+    if (sliceYEnd == height) {
+      if (dithertype == LAVDither_Random)
+        lineDither = dithers + ((height - 2) * 16 * DITHER_STEPS);
+
+      y = stripY + (height - 1) * srcStrideY;
+      u = stripU + ((height >> 1) - 1)  * srcStrideUV;
+      v = stripV + ((height >> 1) - 1)  * srcStrideUV;
+      yuy2 = stripDst + (height - 1) * dstStride;
+      const uint8_t *end = dst + (height - 1) * dstStride + lineBytes;
+
+      ptrdiff_t i = yuv420yuy2_convert_blocks_x2<inputFormat, shift, uyvy, dithertype, avx2>::convert(y, u, v, yuy2, end, 0, 0, 0, line, lineDither, stripX, stripEnd, bStream);
+      for (; i < stripEnd; i += 8) {
+        yuv420yuy2_convert_pixels<inputFormat, shift, uyvy, dithertype>(y, u, v, yuy2, end, 0, 0, 0, line, lineDither, i, bStream);
+      }
+    }
+  }
+  return 0;
+}
+
+template<int uyvy, int dithertype, int avx2>
+static int __stdcall yuv420yuy2_dispatch(LAVPixelFormat inputFormat, int bpp, const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV, uint8_t *dst, int width, int height, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t sliceYStart, ptrdiff_t sliceYEnd, const uint16_t *dithers, BOOL bStream)
+{
+    // Wrap the input format into template args
+  switch (inputFormat) {
+  case LAVPixFmt_YUV420:
+    return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 0, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);
+  case LAVPixFmt_NV12:
+    return yuv420yuy2_process_lines<LAVPixFmt_NV12, 0, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);
+  case LAVPixFmt_YUV420bX:
+    if (bpp == 9)
+      return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 1, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);
+    else if (bpp == 10)
+      return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 2, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);
+    /*else if (bpp == 11)
+      return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 3, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);*/
+    else if (bpp == 12)
+      return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 4, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);
+    /*else if (bpp == 13)
+      return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 5, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);*/
+    else if (bpp == 14)
+      return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 6, uyvy, dithertype, avx2>(srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, sliceYStart, sliceYEnd, dithers, bStream);
+    else
+      ASSERT(0);
+    break;
+  default:
+    ASSERT(0);
+  }
+  return 0;
+}
+
+template <int uyvy, int avx2>
+DECLARE_CONV_FUNC_IMPL(convert_yuv420_yuy2_impl)
+{
+  LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
+  const uint16_t *dithers = (ditherMode == LAVDither_Random) ? GetRandomDitherCoeffs(height, DITHER_STEPS * 2, bpp - 8 + 2, 0) : NULL;
+
+  // Line pairs start on odd lines, so every slice but the first starts one line later, and every slice but the last ends one line later
+  const int startY = sliceYStart ? sliceYStart + 1 : 0;
+  const int endY   = (sliceYEnd == height) ? height : sliceYEnd + 1;
+
+  if (ditherMode == LAVDither_Random && dithers != NULL) {
+    yuv420yuy2_dispatch<uyvy, 1, avx2>(inputFormat, bpp, src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, startY, endY, dithers, m_bStreamingStores);
+  } else {
+    yuv420yuy2_dispatch<uyvy, 0, avx2>(inputFormat, bpp, src[0], src[1], src[2], dst, width, height, srcStride[0], srcStride[1], dstStride, startY, endY, NULL, m_bStreamingStores);
+  }
+
+  return S_OK;
+}
@@ -0,0 +1,168 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <immintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+#include "pixconv_avx2_templates.h"
+#include "yuv420_yuy2.h"
+
+// AVX2 versions of the 4:2:0 to YUY2/UYVY converters in yuv420_yuy2.cpp
+// This file is compiled with AVX2 code generation, it must only be called after checking for AVX2 support.
+
+// AVX2 version of yuv420yuy2_convert_pixels, which converts two blocks of 8x2 pixels at once, one in each 128-bit lane
+// The instructions operate on the lanes independently, so every step is the same as in the SSE2 version, and the
+// output is bit-identical. Both blocks have to be inside of the line, the last block of a line uses the SSE2 version.
+template <LAVPixelFormat inputFormat, int shift, int uyvy, int dithertype> __forceinline
+static int yuv420yuy2_convert_pixels_avx2(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, const uint16_t* &dithers, ptrdiff_t pos, BOOL bStream)
+{
+  __m256i ymm0,ymm1,ymm2,ymm3,ymm4,ymm5,ymm6,ymm7;
+  ymm7 = _mm256_setzero_si256();
+
+  // Bytes of chroma of one line of a block
+  const ptrdiff_t chromaStep = (shift > 0 || inputFormat == LAVPixFmt_NV12) ? 8 : 4;
+
+  if (shift > 0) {
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm1, srcU, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm3, srcU+srcStrideUV, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm0, srcV, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm2, srcV+srcStrideUV, chromaStep);
+
+    ymm0 = _mm256_unpacklo_epi16(ymm1, ymm0);                   /* 0V0U0V0U */
+    ymm2 = _mm256_unpacklo_epi16(ymm3, ymm2);                   /* 0V0U0V0U */
+  } else if (inputFormat == LAVPixFmt_NV12) {
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm0, srcU, chromaStep);
+    PIXCONV_LOAD_4PIXEL16_X2_AVX2(ymm2, srcU+srcStrideUV, chromaStep);
+
+    ymm0 = _mm256_unpacklo_epi8(ymm0, ymm7);                    /* 0V0U0V0U */
+    ymm2 = _mm256_unpacklo_epi8(ymm2, ymm7);                    /* 0V0U0V0U */
+  } else {
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm1, srcU, chromaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm3, srcU+srcStrideUV, chromaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm0, srcV, chromaStep);
+    PIXCONV_LOAD_4PIXEL8_X2_AVX2(ymm2, srcV+srcStrideUV, chromaStep);
+
+    ymm0 = _mm256_unpacklo_epi8(ymm1, ymm0);                    /* VUVU0000 */
+    ymm2 = _mm256_unpacklo_epi8(ymm3, ymm2);                    /* VUVU0000 */
+
+    ymm0 = _mm256_unpacklo_epi8(ymm0, ymm7);                    /* 0V0U0V0U */
+    ymm2 = _mm256_unpacklo_epi8(ymm2, ymm7);                    /* 0V0U0V0U */
+  }
+
+  srcU += 2 * chromaStep;
+  srcV += 2 * chromaStep;
+
+  // Chroma upsampling
+  ymm1 = _mm256_add_epi16(ymm0, ymm0);                          /* 2x line 0 */
+  ymm1 = _mm256_add_epi16(ymm1, ymm0);                          /* 3x line 0 */
+  ymm1 = _mm256_add_epi16(ymm1, ymm2);                          /* 3x line 0 + line 1 */
+
+  ymm3 = _mm256_add_epi16(ymm2, ymm2);                          /* 2x line 1 */
+  ymm3 = _mm256_add_epi16(ymm3, ymm2);                          /* 3x line 1 */
+  ymm3 = _mm256_add_epi16(ymm3, ymm0);                          /* 3x line 1 + line 0 */
+
+  // Load Y, the first 8 pixels go into the low lane, the next 8 into the high lane
+  if (shift > 0) {
+    ymm0 = _mm256_loadu_si256((const __m256i *)(srcY));
+    ymm5 = _mm256_loadu_si256((const __m256i *)(srcY+srcStrideY));
+    srcY += 32;
+  } else {
+    ymm0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(srcY)));             /* YYYYYYYY (16-bit fields) */
+    ymm5 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(srcY+srcStrideY)));  /* YYYYYYYY (16-bit fields) */
+    srcY += 16;
+  }
+
+  // Dithering
+  if (dithertype == LAVDither_Random) {
+    // Every block uses the coefficients of its own position
+    const int offset  = (pos % (DITHER_STEPS * 8 * 2)) * 2;
+    const int offset2 = ((pos + 8) % (DITHER_STEPS * 8 * 2)) * 2;
+    ymm6 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *)(dithers + 0 + offset))), _mm_load_si128((const __m128i *)(dithers + 0 + offset2)), 1);
+    ymm7 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *)(dithers + 8 + offset))), _mm_load_si128((const __m128i *)(dithers + 8 + offset2)), 1);
+  } else {
+    PIXCONV_LOAD_DITHER_COEFFS_AVX2(ymm6, line+0, shift+2, odithers);
+    PIXCONV_LOAD_DITHER_COEFFS_AVX2(ymm7, line+1, shift+2, odithers2);
+  }
+
+  // Dither UV
+  ymm1 = _mm256_adds_epu16(ymm1, ymm6);
+  ymm3 = _mm256_adds_epu16(ymm3, ymm7);
+  ymm1 = _mm256_srai_epi16(ymm1, shift+2);
+  ymm3 = _mm256_srai_epi16(ymm3, shift+2);
+
+  if (shift) {                                                  /* Y only needs to be dithered if it was > 8 bit */
+    ymm6 = _mm256_srli_epi16(ymm6, 2);                          /* Shift dithering coeffs to proper strength */
+    ymm7 = _mm256_srli_epi16(ymm6, 2);
+
+    ymm0 = _mm256_adds_epu16(ymm0, ymm6);                       /* Apply dithering coeffs */
+    ymm0 = _mm256_srai_epi16(ymm0, shift);                      /* Shift to 8 bit */
+
+    ymm5 = _mm256_adds_epu16(ymm5, ymm7);                       /* Apply dithering coeffs */
+    ymm5 = _mm256_srai_epi16(ymm5, shift);                      /* Shift to 8 bit */
+  }
+
+  // Pack into 8-bit containers
+  ymm0 = _mm256_packus_epi16(ymm0, ymm5);
+  ymm1 = _mm256_packus_epi16(ymm1, ymm3);
+
+  // Interleave U/V with Y
+  if (uyvy) {
+    ymm3 = _mm256_unpacklo_epi8(ymm1, ymm0);
+    ymm4 = _mm256_unpackhi_epi8(ymm1, ymm0);
+  } else {
+    ymm3 = _mm256_unpacklo_epi8(ymm0, ymm1);
+    ymm4 = _mm256_unpackhi_epi8(ymm0, ymm1);
+  }
+
+  // ymm3 holds the 32 bytes of the first line in order, ymm4 the ones of the second line
+  pixconv_put_stream((__m128i *)(dst), dstEnd, _mm256_castsi256_si128(ymm3), bStream);
+  pixconv_put_stream((__m128i *)(dst + 16), dstEnd, _mm256_extracti128_si256(ymm3, 1), bStream);
+  pixconv_put_stream((__m128i *)(dst + dstStride), dstEnd + dstStride, _mm256_castsi256_si128(ymm4), bStream);
+  pixconv_put_stream((__m128i *)(dst + dstStride + 16), dstEnd + dstStride, _mm256_extracti128_si256(ymm4, 1), bStream);
+
+  dst += 32;
+
+  return 0;
+}
+
+template <LAVPixelFormat inputFormat, int shift, int uyvy, int dithertype>
+struct yuv420yuy2_convert_blocks_x2<inputFormat, shift, uyvy, dithertype, 1> {
+  static __forceinline ptrdiff_t convert(const uint8_t* &srcY, const uint8_t* &srcU, const uint8_t* &srcV, uint8_t* &dst, const uint8_t *dstEnd, ptrdiff_t srcStrideY, ptrdiff_t srcStrideUV, ptrdiff_t dstStride, ptrdiff_t line, const uint16_t* &dithers, ptrdiff_t i, ptrdiff_t endx, BOOL bStream)
+  {
+    for (; (i + 16) <= endx; i += 16) {
+      yuv420yuy2_convert_pixels_avx2<inputFormat, shift, uyvy, dithertype>(srcY, srcU, srcV, dst, dstEnd, srcStrideY, srcStrideUV, dstStride, line, dithers, i, bStream);
+    }
+    return i;
+  }
+};
+
+template <int uyvy>
+DECLARE_CONV_FUNC_IMPL(convert_yuv420_yuy2_avx2)
+{
+  HRESULT hr = convert_yuv420_yuy2_impl<uyvy, 1>(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
+  _mm256_zeroupper();
+  return hr;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv420_yuy2_avx2<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv420_yuy2_avx2<1>CONV_FUNC_PARAMS;
@@ -47,10 +47,15 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_ayuv)
 
   xmm6 = _mm_set1_epi32(-1);
 
+  y += inStride * sliceYStart;
+  u += inStride * sliceYStart;
+  v += inStride * sliceYStart;
+
   _mm_sfence();
 
-  for (line = 0; line < height; ++line) {
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
     __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 2);
 
     for (i = 0; i < width; i+=16) {
       // Load pixels into registers
@@ -74,10 +79,10 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_ayuv)
       xmm3 = _mm_unpackhi_epi16(xmm5, xmm4);    /* VUYAVUYA */
 
       // Write data back
-      _mm_stream_si128(dst128++, xmm1);
-      _mm_stream_si128(dst128++, xmm2);
-      _mm_stream_si128(dst128++, xmm0);
-      _mm_stream_si128(dst128++, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm1);
+      PIXCONV_PUT_STREAM(dst128, end, xmm2);
+      PIXCONV_PUT_STREAM(dst128, end, xmm0);
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
     }
 
     y += inStride;
@@ -108,9 +113,13 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_ayuv_dither_le)
 
   xmm7 = _mm_set1_epi16(-256); /* 0xFF00 - 0A0A0A0A */
 
+  y += inStride * sliceYStart;
+  u += inStride * sliceYStart;
+  v += inStride * sliceYStart;
+
   _mm_sfence();
 
-  for (line = 0; line < height; ++line) {
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
     // Load dithering coefficients for this line
     if (ditherMode == LAVDither_Random) {
       xmm4 = _mm_load_si128((const __m128i *)(dithers + (line * 24) +  0));
@@ -122,6 +131,7 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_ayuv_dither_le)
     }
 
     __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + (width << 2);
 
     for (i = 0; i < width; i+=8) {
       // Load pixels into registers, and apply dithering
@@ -139,8 +149,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv444_ayuv_dither_le)
       xmm3 = _mm_unpackhi_epi16(xmm3, xmm0);    /* VUYAVUYA */
 
       // Write data back
-      _mm_stream_si128(dst128++, xmm2);
-      _mm_stream_si128(dst128++, xmm3);
+      PIXCONV_PUT_STREAM(dst128, end, xmm2);
+      PIXCONV_PUT_STREAM(dst128, end, xmm3);
     }
 
     y += inStride;
@@ -0,0 +1,249 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include "pixconv_internal.h"
+
+// Table-driven versions of the high bit-depth to 8-bit converters with ordered dithering
+// The table holds the final 8-bit value for every input value and dither phase (row and column in the 8x8 dither matrix),
+// so the per-pixel work is a single lookup. The output is identical to the arithmetic versions in yuv2yuv_unscaled.cpp
+// and yuv444_ayuv.cpp. The table could just as well hold any other mapping, like a tone curve.
+// With random dithering the coefficients change for every pixel, and the arithmetic version is used instead.
+
+// Convert one line of 16-bit samples to 8-bit with the dithering LUT
+// dst   - first destination byte, will be advanced by step for every pixel
+// width - number of pixels
+// lut   - table for the current line, 8 sub-tables (one per column phase) of (1 << bpp) entries
+template <int step>
+static __forceinline void dither_lut_line(const uint16_t *src, uint8_t *dst, ptrdiff_t width, const uint8_t *lut, int bpp)
+{
+  const ptrdiff_t size = (ptrdiff_t)1 << bpp;
+  const unsigned mask = (unsigned)size - 1;
+
+#define LUT_PIXEL(n) dst[(n) * step] = lut[(n) * size + (src[i + (n)] & mask)]
+
+  ptrdiff_t i = 0;
+  for (; (i + 8) <= width; i += 8) {
+    LUT_PIXEL(0); LUT_PIXEL(1); LUT_PIXEL(2); LUT_PIXEL(3);
+    LUT_PIXEL(4); LUT_PIXEL(5); LUT_PIXEL(6); LUT_PIXEL(7);
+    dst += 8 * step;
+  }
+  for (ptrdiff_t n = 0; (i + n) < width; n++) {
+    LUT_PIXEL(n);
+  }
+
+#undef LUT_PIXEL
+}
+
+const uint8_t* CLAVPixFmtConverter::GetDitherLUT(int bpp)
+{
+  if (m_pSettings->GetDitherMode() == LAVDither_Random || bpp <= 8 || bpp > 12)
+    return NULL;
+
+  CAutoLock lock(&m_csTables);
+
+  if (!m_pDitherLUT || m_DitherLUTBpp != bpp) {
+    const int size = 1 << bpp;
+    _aligned_free(m_pDitherLUT);
+    m_pDitherLUT = (uint8_t *)_aligned_malloc(8 * 8 * size, 64);
+    m_DitherLUTBpp = bpp;
+
+    // Same arithmetic as PIXCONV_LOAD_PIXEL16_DITHER: scale to 16-bit, saturated add of the coefficient, and keep the high byte
+    for (int row = 0; row < 8; row++) {
+      for (int col = 0; col < 8; col++) {
+        uint8_t *lut = m_pDitherLUT + (row * 8 + col) * size;
+        for (int v = 0; v < size; v++) {
+          lut[v] = (uint8_t)(min((v << (16 - bpp)) + dither_8x8_256[row][col], 0xFFFF) >> 8);
+        }
+      }
+    }
+  }
+
+  return m_pDitherLUT;
+}
+
+template <int nv12>
+DECLARE_CONV_FUNC_IMPL(convert_yuv_yv_nv12_dither_lut)
+{
+  const uint8_t *lut = GetDitherLUT(bpp);
+  if (lut == NULL)
+    return (this->*m_DitherLUTFallback)(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
+
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inYStride = srcStride[0] >> 1;
+  const ptrdiff_t inUVStride = srcStride[1] >> 1;
+  const ptrdiff_t lutRowSize = (ptrdiff_t)8 << bpp;
+
+  ptrdiff_t outLumaStride    = dstStride;
+  ptrdiff_t outChromaStride  = dstStride;
+  ptrdiff_t chromaWidth      = width;
+  ptrdiff_t chromaHeight     = height;
+
+  if (inputFormat == LAVPixFmt_YUV420bX)
+    chromaHeight = chromaHeight >> 1;
+  if (inputFormat == LAVPixFmt_YUV420bX || inputFormat == LAVPixFmt_YUV422bX) {
+    chromaWidth = (chromaWidth + 1) >> 1;
+    outChromaStride = outChromaStride >> 1;
+  }
+
+  const ptrdiff_t chromaSliceStart = (chromaHeight == height) ? sliceYStart : (sliceYStart >> 1);
+  const ptrdiff_t chromaSliceEnd   = (chromaHeight == height) ? sliceYEnd   : (sliceYEnd >> 1);
+
+  ptrdiff_t line;
+
+  uint8_t *dstY = dst;
+  uint8_t *dstV = dstY + outLumaStride * height;
+  uint8_t *dstU = dstV + outChromaStride * chromaHeight;
+
+  y += inYStride * sliceYStart;
+  u += inUVStride * chromaSliceStart;
+  v += inUVStride * chromaSliceStart;
+
+  // Process Y
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    dither_lut_line<1>(y, dstY + line * outLumaStride, width, lut + (line % 8) * lutRowSize, bpp);
+    y += inYStride;
+  }
+
+  // Process U/V
+  // Chroma line n uses the same dithering coefficients as luma line n
+  for (line = chromaSliceStart; line < chromaSliceEnd; ++line) {
+    const uint8_t *lineLut = lut + (line % 8) * lutRowSize;
+    if (nv12) {
+      uint8_t *uv = dstV + line * outLumaStride;
+      dither_lut_line<2>(u, uv + 0, chromaWidth, lineLut, bpp);
+      dither_lut_line<2>(v, uv + 1, chromaWidth, lineLut, bpp);
+    } else {
+      dither_lut_line<1>(u, dstU + line * outChromaStride, chromaWidth, lineLut, bpp);
+      dither_lut_line<1>(v, dstV + line * outChromaStride, chromaWidth, lineLut, bpp);
+    }
+
+    u += inUVStride;
+    v += inUVStride;
+  }
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv_yv_nv12_dither_lut<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv_yv_nv12_dither_lut<1>CONV_FUNC_PARAMS;
+
+template <int uyvy>
+DECLARE_CONV_FUNC_IMPL(convert_yuv422_yuy2_uyvy_dither_lut)
+{
+  const uint8_t *lut = GetDitherLUT(bpp);
+  if (lut == NULL)
+    return (this->*m_DitherLUTFallback)(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
+
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inLumaStride    = srcStride[0] >> 1;
+  const ptrdiff_t inChromaStride  = srcStride[1] >> 1;
+  const ptrdiff_t outStride       = dstStride << 1;
+  const ptrdiff_t lutRowSize      = (ptrdiff_t)8 << bpp;
+
+  // Only full macro-pixels are written through the LUT, an odd last pixel is handled separately
+  const ptrdiff_t pairs = width >> 1;
+
+  ptrdiff_t line;
+
+  y += inLumaStride * sliceYStart;
+  u += inChromaStride * sliceYStart;
+  v += inChromaStride * sliceYStart;
+
+  for (line = sliceYStart;  line < sliceYEnd; ++line) {
+    const uint8_t *lineLut = lut + (line % 8) * lutRowSize;
+    uint8_t *out = dst + line * outStride;
+
+    // YUY2: Y0 U0 Y1 V0, UYVY: U0 Y0 V0 Y1
+    dither_lut_line<2>(y, out + (uyvy ? 1 : 0), pairs << 1, lineLut, bpp);
+    dither_lut_line<4>(u, out + (uyvy ? 0 : 1), pairs, lineLut, bpp);
+    dither_lut_line<4>(v, out + (uyvy ? 2 : 3), pairs, lineLut, bpp);
+
+    if (width & 1) {
+      // The last macro-pixel only has one visible pixel, which is repeated into the padding pixel
+      const ptrdiff_t size = (ptrdiff_t)1 << bpp;
+      const unsigned mask = (unsigned)size - 1;
+      const ptrdiff_t i = width - 1;
+      const uint8_t yval = lineLut[(i % 8) * size + (y[i] & mask)];
+      const uint8_t uval = lineLut[(pairs % 8) * size + (u[pairs] & mask)];
+      const uint8_t vval = lineLut[(pairs % 8) * size + (v[pairs] & mask)];
+      out[i * 2 + 0] = uyvy ? uval : yval;
+      out[i * 2 + 1] = uyvy ? yval : uval;
+      out[i * 2 + 2] = uyvy ? vval : yval;
+      out[i * 2 + 3] = uyvy ? yval : vval;
+    }
+
+    y += inLumaStride;
+    u += inChromaStride;
+    v += inChromaStride;
+  }
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuv422_yuy2_uyvy_dither_lut<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuv422_yuy2_uyvy_dither_lut<1>CONV_FUNC_PARAMS;
+
+DECLARE_CONV_FUNC_IMPL(convert_yuv444_ayuv_dither_lut)
+{
+  const uint8_t *lut = GetDitherLUT(bpp);
+  if (lut == NULL)
+    return (this->*m_DitherLUTFallback)(src, srcStride, dst, dstStride, width, height, sliceYStart, sliceYEnd, inputFormat, bpp, outputFormat);
+
+  const uint16_t *y = (const uint16_t *)src[0];
+  const uint16_t *u = (const uint16_t *)src[1];
+  const uint16_t *v = (const uint16_t *)src[2];
+
+  const ptrdiff_t inStride = srcStride[0] >> 1;
+  const ptrdiff_t outStride = dstStride << 2;
+  const ptrdiff_t lutRowSize = (ptrdiff_t)8 << bpp;
+
+  ptrdiff_t line, i;
+
+  y += inStride * sliceYStart;
+  u += inStride * sliceYStart;
+  v += inStride * sliceYStart;
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    const uint8_t *lineLut = lut + (line % 8) * lutRowSize;
+    uint8_t *out = dst + line * outStride;
+
+    // VUYA
+    dither_lut_line<4>(v, out + 0, width, lineLut, bpp);
+    dither_lut_line<4>(u, out + 1, width, lineLut, bpp);
+    dither_lut_line<4>(y, out + 2, width, lineLut, bpp);
+    for (i = 0; i < width; i++)
+      out[i * 4 + 3] = 0xFF;
+
+    y += inStride;
+    u += inStride;
+    v += inStride;
+  }
+
+  return S_OK;
+}
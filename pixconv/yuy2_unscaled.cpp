@@ -0,0 +1,227 @@
+/*
+ *      Copyright (C) 2010-2013 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <emmintrin.h>
+
+#include "pixconv_internal.h"
+#include "pixconv_sse2_templates.h"
+
+// Conversion of packed YUY2 input into the 8-bit planar, semi-planar and packed 4:2:2 formats, and into P210/P216
+// YUY2: Y0 U0 Y1 V0 | Y2 U1 Y3 V1 ...
+
+// YV16 keeps the chroma resolution, YV12 and NV12 average the chroma of every line pair
+// If the height is odd, the last line has no chroma line, just like when converting from YUV420
+template <int nv12>
+DECLARE_CONV_FUNC_IMPL(convert_yuy2_yv_nv12)
+{
+  const uint8_t *yuy2 = src[0];
+
+  const ptrdiff_t inStride = srcStride[0];
+  const int is420 = (outputFormat != LAVOutPixFmt_YV16);
+
+  const ptrdiff_t outLumaStride = dstStride;
+  const ptrdiff_t outChromaStride = nv12 ? dstStride : (dstStride >> 1);
+  const ptrdiff_t chromaHeight = is420 ? (height >> 1) : height;
+  const ptrdiff_t chromaWidth = (width + 1) >> 1;
+  const ptrdiff_t chromaBytes = nv12 ? (chromaWidth << 1) : chromaWidth;
+  const ptrdiff_t lineStep = is420 ? 2 : 1;
+  // Bytes of an input line, the last pixel of an odd width still has a full chroma pair
+  const ptrdiff_t inBytes = chromaWidth << 2;
+
+  // NV12 only uses dstV, for the interleaved chroma plane
+  uint8_t *dstY = dst;
+  uint8_t *dstV = dstY + height * outLumaStride;
+  uint8_t *dstU = dstV + chromaHeight * outChromaStride;
+
+  ptrdiff_t line, i;
+  __m128i xmm0,xmm1,xmm2,xmm3,xmm4,xmm5,xmm6,xmm7;
+  // The last pixels of a line pair are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint8_t, tail)[64 * 2];
+
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+
+  yuy2 += inStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; line += lineStep) {
+    const int pair = is420 && (line + 1) < sliceYEnd;
+    const ptrdiff_t chromaLine = is420 ? (line >> 1) : line;
+
+    __m128i *dst128Y0 = (__m128i *)(dstY + line * outLumaStride);
+    __m128i *dst128Y1 = (__m128i *)(dstY + (line + 1) * outLumaStride);
+    __m128i *dst128U  = (__m128i *)(dstU + chromaLine * outChromaStride);
+    __m128i *dst128V  = (__m128i *)(dstV + chromaLine * outChromaStride);
+    const uint8_t *endY0 = (const uint8_t *)dst128Y0 + width;
+    const uint8_t *endY1 = (const uint8_t *)dst128Y1 + width;
+    // The unpaired last line of an odd height has no chroma to write
+    const uint8_t *endU  = (chromaLine < chromaHeight) ? (const uint8_t *)dst128U + chromaBytes : (const uint8_t *)dst128U;
+    const uint8_t *endV  = (chromaLine < chromaHeight) ? (const uint8_t *)dst128V + chromaBytes : (const uint8_t *)dst128V;
+
+    for (i = 0; i < width; i += 32) {
+      const uint8_t *in0 = yuy2 + i * 2;
+      const uint8_t *in1 = in0 + inStride;
+      if (inBytes - i * 2 < 64) {
+        memcpy(tail, in0, inBytes - i * 2);
+        if (pair)
+          memcpy(tail + 64, in1, inBytes - i * 2);
+        in0 = tail;
+        in1 = tail + 64;
+      }
+
+      // Split 32 pixels of the first line
+      PIXCONV_LOAD_YUY2_SPLIT(xmm0, xmm2, mask, in0);               /* YYYY / UVUV */
+      PIXCONV_LOAD_YUY2_SPLIT(xmm1, xmm3, mask, (in0+32));          /* YYYY / UVUV */
+      PIXCONV_PUT_STREAM(dst128Y0, endY0, xmm0);
+      PIXCONV_PUT_STREAM(dst128Y0, endY0, xmm1);
+
+      // Second line of the pair, its chroma is averaged with the first line
+      if (pair) {
+        PIXCONV_LOAD_YUY2_SPLIT(xmm4, xmm6, mask, in1);
+        PIXCONV_LOAD_YUY2_SPLIT(xmm5, xmm7, mask, (in1+32));
+        PIXCONV_PUT_STREAM(dst128Y1, endY1, xmm4);
+        PIXCONV_PUT_STREAM(dst128Y1, endY1, xmm5);
+
+        xmm2 = _mm_avg_epu8(xmm2, xmm6);
+        xmm3 = _mm_avg_epu8(xmm3, xmm7);
+      }
+
+      if (nv12) {
+        PIXCONV_PUT_STREAM(dst128V, endV, xmm2);
+        PIXCONV_PUT_STREAM(dst128V, endV, xmm3);
+      } else {
+        // Split U and V
+        xmm4 = _mm_packus_epi16(_mm_and_si128(xmm2, mask), _mm_and_si128(xmm3, mask));  /* UUUU */
+        xmm5 = _mm_packus_epi16(_mm_srli_epi16(xmm2, 8), _mm_srli_epi16(xmm3, 8));      /* VVVV */
+        PIXCONV_PUT_STREAM(dst128U, endU, xmm4);
+        PIXCONV_PUT_STREAM(dst128V, endV, xmm5);
+      }
+    }
+
+    yuy2 += inStride * lineStep;
+  }
+
+  return S_OK;
+}
+
+// Force creation of these two variants
+template HRESULT CLAVPixFmtConverter::convert_yuy2_yv_nv12<0>CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_yuy2_yv_nv12<1>CONV_FUNC_PARAMS;
+
+DECLARE_CONV_FUNC_IMPL(convert_yuy2_uyvy)
+{
+  const uint8_t *yuy2 = src[0];
+
+  const ptrdiff_t inStride = srcStride[0];
+  const ptrdiff_t outStride = dstStride << 1;
+  // Bytes of a line, the last pixel of an odd width still has a full macropixel
+  const ptrdiff_t lineBytes = ((width + 1) >> 1) << 2;
+
+  ptrdiff_t line, i;
+  __m128i xmm0,xmm1;
+  // The last pixels of a line are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint8_t, tail)[32];
+
+  yuy2 += inStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128 = (__m128i *)(dst + line * outStride);
+    const uint8_t *end = (const uint8_t *)dst128 + lineBytes;
+
+    for (i = 0; i < lineBytes; i += 32) {
+      const uint8_t *in = yuy2 + i;
+      if (lineBytes - i < 32) {
+        memcpy(tail, in, lineBytes - i);
+        in = tail;
+      }
+
+      PIXCONV_LOAD_PIXEL8(xmm0, in);
+      PIXCONV_LOAD_PIXEL8(xmm1, (in+16));
+
+      // Swap the bytes of every 16-bit word
+      xmm0 = _mm_or_si128(_mm_slli_epi16(xmm0, 8), _mm_srli_epi16(xmm0, 8));   /* UYVY */
+      xmm1 = _mm_or_si128(_mm_slli_epi16(xmm1, 8), _mm_srli_epi16(xmm1, 8));   /* UYVY */
+
+      PIXCONV_PUT_STREAM(dst128, end, xmm0);
+      PIXCONV_PUT_STREAM(dst128, end, xmm1);
+    }
+
+    yuy2 += inStride;
+  }
+
+  return S_OK;
+}
+
+// P210 and P216 are MSB-aligned, so moving every sample into the high byte of a 16-bit word is all that is needed
+// The chroma pairs of YUY2 already are in the U V order of the interleaved chroma plane
+DECLARE_CONV_FUNC_IMPL(convert_yuy2_px1x)
+{
+  const uint8_t *yuy2 = src[0];
+
+  const ptrdiff_t inStride = srcStride[0];
+  const ptrdiff_t outStride = dstStride << 1;
+  const ptrdiff_t lineBytes = width << 1;
+  const ptrdiff_t uvBytes = ((width + 1) >> 1) << 2;
+  // Bytes of an input line, the last pixel of an odd width still has a full chroma pair
+  const ptrdiff_t inBytes = uvBytes;
+
+  ptrdiff_t line, i;
+  __m128i xmm0,xmm1;
+  // The last pixels of a line are read from a copy, so that the loads never reach past the end of the input
+  DECLARE_ALIGNED(16, uint8_t, tail)[32];
+
+  const __m128i mask = _mm_set1_epi16((short)0xFF00);
+
+  uint8_t *dstUV = dst + height * outStride;
+
+  yuy2 += inStride * sliceYStart;
+
+  _mm_sfence();
+
+  for (line = sliceYStart; line < sliceYEnd; ++line) {
+    __m128i *dst128Y  = (__m128i *)(dst + line * outStride);
+    __m128i *dst128UV = (__m128i *)(dstUV + line * outStride);
+    const uint8_t *endY  = (const uint8_t *)dst128Y + lineBytes;
+    const uint8_t *endUV = (const uint8_t *)dst128UV + uvBytes;
+
+    for (i = 0; i < lineBytes; i += 32) {
+      const uint8_t *in = yuy2 + i;
+      if (inBytes - i < 32) {
+        memcpy(tail, in, inBytes - i);
+        in = tail;
+      }
+
+      PIXCONV_LOAD_PIXEL8(xmm0, in);             /* YUYV */
+      PIXCONV_LOAD_PIXEL8(xmm1, (in+16));        /* YUYV */
+
+      PIXCONV_PUT_STREAM(dst128Y, endY, _mm_slli_epi16(xmm0, 8));      /* 0Y0Y */
+      PIXCONV_PUT_STREAM(dst128Y, endY, _mm_slli_epi16(xmm1, 8));      /* 0Y0Y */
+      PIXCONV_PUT_STREAM(dst128UV, endUV, _mm_and_si128(xmm0, mask));  /* 0U0V */
+      PIXCONV_PUT_STREAM(dst128UV, endUV, _mm_and_si128(xmm1, mask));  /* 0U0V */
+    }
+
+    yuy2 += inStride;
+  }
+
+  return S_OK;
+}
@@ -20,6 +20,7 @@
 #include "stdafx.h"
 #include "LAVSubtitleConsumer.h"
 #include "LAVVideo.h"
+#include "LAVThreadPool.h"
 
 #define OFFSET(x) offsetof(LAVSubtitleConsumerContext, x)
 static const SubRenderOption options[] = {
@@ -40,15 +41,16 @@ CLAVSubtitleConsumer::CLAVSubtitleConsumer(CLAVVideo *pLAVVideo)
   , m_pProvider(NULL)
   , m_SubtitleFrame(NULL)
   , m_evFrame(FALSE)
-  , m_pSwsContext(NULL)
   , m_PixFmt(LAVPixFmt_None)
   , m_pLAVVideo(pLAVVideo)
+  , m_pThreadPool(CLAVThreadPool::GetShared())
   , blend(NULL)
 {
   ZeroMemory(&context, sizeof(context));
   context.name = TEXT(LAV_VIDEO);
   context.version = TEXT(LAV_VERSION_STR);
   m_evFrame.Reset();
+  CLAVSwsCache::AcquireShared();
 }
 
 CLAVSubtitleConsumer::~CLAVSubtitleConsumer(void)
@@ -57,6 +59,8 @@ CLAVSubtitleConsumer::~CLAVSubtitleConsumer(void)
     m_pProvider->Disconnect();
   }
   Disconnect();
+  CLAVThreadPool::ReleaseShared();
+  CLAVSwsCache::ReleaseShared();
 }
 
 STDMETHODIMP CLAVSubtitleConsumer::Connect(ISubRenderProvider *subtitleRenderer)
@@ -69,10 +73,7 @@ STDMETHODIMP CLAVSubtitleConsumer::Connect(ISubRenderProvider *subtitleRenderer)
 STDMETHODIMP CLAVSubtitleConsumer::Disconnect(void)
 {
   SafeRelease(&m_pProvider);
-  if (m_pSwsContext) {
-    sws_freeContext(m_pSwsContext);
-    m_pSwsContext = NULL;
-  }
+  m_SwsContext.Release();
   return S_OK;
 }
 
@@ -346,7 +347,7 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessSubtitleBitmap(LAVPixelFormat pixFmt,
     subPosition.x = (LONG)av_rescale(subPosition.x, newSize.cx, subSize.cx);
     subPosition.y = (LONG)av_rescale(subPosition.y, newSize.cy, subSize.cy);
 
-    m_pSwsContext = sws_getCachedContext(m_pSwsContext, subSize.cx, subSize.cy, AV_PIX_FMT_BGRA, newSize.cx, newSize.cy, avPixFmt, SWS_BILINEAR|SWS_FULL_CHR_H_INP, NULL, NULL, NULL);
+    SwsContext *ctx = m_SwsContext.Get(LAVSwsKey(subSize.cx, subSize.cy, AV_PIX_FMT_BGRA, newSize.cx, newSize.cy, avPixFmt, SWS_BILINEAR|SWS_FULL_CHR_H_INP));
 
     const uint8_t *src[4] = { (const uint8_t *)rgbData, NULL, NULL, NULL };
     const int srcStride[4] = { pitch * 4, 0, 0, 0 };
@@ -379,7 +380,7 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessSubtitleBitmap(LAVPixelFormat pixFmt,
       src[0] = tmpBuf;
     }
 
-    int ret = sws_scale(m_pSwsContext, src, srcStride, 0, subSize.cy, subData, subStride);
+    int ret = sws_scale(ctx, src, srcStride, 0, subSize.cy, subData, subStride);
     subSize = newSize;
 
     if (tmpBuf)
@@ -392,8 +393,20 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessSubtitleBitmap(LAVPixelFormat pixFmt,
   ASSERT((subPosition.x + subSize.cx) <= videoRect.right);
   ASSERT((subPosition.y + subSize.cy) <= videoRect.bottom);
 
-  if (blend)
-    (this->*blend)(videoData, videoStride, videoRect, subData, subStride, subPosition, subSize, pixFmt, bpp);
+  if (blend) {
+    // Blend big subtitles in slices, which start on even lines so that the chroma subsampling is not split
+    const int slices = min(m_pThreadPool->GetNumThreads(), (int)subSize.cy / 64);
+    if (slices <= 1) {
+      (this->*blend)(videoData, videoStride, videoRect, subData, subStride, subPosition, subSize, pixFmt, bpp, 0, subSize.cy);
+    } else {
+      const int linesPerSlice = (subSize.cy / slices) & ~1;
+      m_pThreadPool->Execute(slices, [&](int slice) {
+        const int sliceYStart = slice * linesPerSlice;
+        const int sliceYEnd   = (slice == slices - 1) ? subSize.cy : sliceYStart + linesPerSlice;
+        (this->*blend)(videoData, videoStride, videoRect, subData, subStride, subPosition, subSize, pixFmt, bpp, sliceYStart, sliceYEnd);
+      });
+    }
+  }
 
   if (bNeedScaling) {
     for (int i = 0; i < 4; i++) {
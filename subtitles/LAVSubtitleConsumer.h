@@ -23,8 +23,9 @@
 #include "LAVSubtitleFrame.h"
 
 #include "../decoders/ILAVDecoder.h"
+#include "../LAVSwsCache.h"
 
-#define BLEND_FUNC_PARAMS (BYTE* video[4], int videoStride[4], RECT vidRect, BYTE* subData[4], int subStride[4], POINT position, SIZE size, LAVPixelFormat pixFmt, int bpp)
+#define BLEND_FUNC_PARAMS (BYTE* video[4], int videoStride[4], RECT vidRect, BYTE* subData[4], int subStride[4], POINT position, SIZE size, LAVPixelFormat pixFmt, int bpp, int sliceYStart, int sliceYEnd)
 
 #define DECLARE_BLEND_FUNC(name) \
   HRESULT name BLEND_FUNC_PARAMS
@@ -42,6 +43,7 @@ typedef struct LAVSubtitleConsumerContext {
 } LAVSubtitleConsumerContext;
 
 class CLAVVideo;
+class CLAVThreadPool;
 
 class CLAVSubtitleConsumer : public ISubRenderConsumer, public CSubRenderOptionsImpl, public CUnknown
 {
@@ -82,10 +84,11 @@ private:
   ISubRenderFrame    *m_SubtitleFrame;
   CAMEvent           m_evFrame;
 
-  SwsContext         *m_pSwsContext;
+  CLAVSwsContext     m_SwsContext;
   LAVPixelFormat     m_PixFmt;
 
   LAVSubtitleConsumerContext context;
 
   CLAVVideo          *m_pLAVVideo;
+  CLAVThreadPool     *m_pThreadPool;
 };
@@ -34,7 +34,7 @@ DECLARE_BLEND_FUNC_IMPL(blend_rgb_c)
 
   const int dstep = (pixFmt == LAVPixFmt_RGB24) ? 3 : 4;
 
-  for (int y = 0; y < size.cy; y++) {
+  for (int y = sliceYStart; y < sliceYEnd; y++) {
     BYTE *dstLine = rgbOut + ((y + position.y) * outStride) + (position.x * dstep);
     const BYTE *srcLine = subIn + (y * inStride);
     for (int x = 0; x < size.cx; x++) {
@@ -89,7 +89,7 @@ DECLARE_BLEND_FUNC_IMPL(blend_yuv_c)
   const int vsub = nv12 || (pixFmt != LAVPixFmt_YUV444 && pixFmt != LAVPixFmt_YUV444bX);
   const int shift = sizeof(pixT) > 1 ? bpp - 8 : 0;
 
-  for (line = 0; line < h; line++) {
+  for (line = sliceYStart; line < sliceYEnd; line++) {
     pixT *dstY = (pixT *)(y + ((line + yPos) * outStride)) + xPos;
     const BYTE *srcY = subY + (line * inStride);
     const BYTE *srcA = subA + (line * inStride);
@@ -116,7 +116,11 @@ DECLARE_BLEND_FUNC_IMPL(blend_yuv_c)
     yPos >>= 1;
   }
 
-  for (line = 0; line < h; line++) {
+  // Slices start on even lines, and the last one ends with the image
+  const int uvSliceStart = sliceYStart >> vsub;
+  const int uvSliceEnd   = (sliceYEnd == size.cy) ? h : (sliceYEnd >> vsub);
+
+  for (line = uvSliceStart; line < uvSliceEnd; line++) {
     pixT *dstUV = (pixT *)(u + (line + yPos) * outStrideUV) + (xPos << 1);
 
     pixT *dstU = (pixT *)(u + (line + yPos) * outStrideUV) + xPos;